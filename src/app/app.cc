@@ -140,6 +140,7 @@ public:
         gboolean geometry_hints{true};
         gboolean hyperlink{true};
         gboolean icon_title{false};
+        gboolean image_files{false};
         gboolean keep{false};
         gboolean kinetic_scrolling{true};
         gboolean legacy_osc777{false};
@@ -1310,6 +1311,10 @@ public:
                                 0, &hyperlink,
                                 "Enable hyperlinks",
                                 "Disable hyperlinks");
+                add_bool_option("image-files", 0, "no-image-files", 0,
+                                0, &image_files,
+                                "Enable image transfer by file",
+                                "Disable image transfer by file");
                 add_bool_option("kinetic-scrolling", 0, "no-kinetic-scrolling", 0,
                                 0, &kinetic_scrolling,
                                 "Enable kinetic scrolling",
@@ -3716,6 +3721,11 @@ window_child_exited_cb(VteTerminal* term,
                 }
         }
 
+        if (options.verbosity >= VL1) {
+                auto const stats = vte::glib::take_string(vte_terminal_dup_statistics(window->terminal));
+                verbose_printerrln("Statistics:\n{}", stats.get());
+        }
+
         window->child_pid = -1;
 
         if (options.keep)
@@ -4316,6 +4326,7 @@ vteapp_window_constructed(GObject *object)
         vte_terminal_set_enable_bidi(window->terminal, options.bidi);
         vte_terminal_set_enable_shaping(window->terminal, options.shaping);
         vte_terminal_set_enable_sixel(window->terminal, options.sixel);
+        vte_terminal_set_enable_image_files(window->terminal, options.image_files);
         vte_terminal_set_enable_fallback_scrolling(window->terminal, options.fallback_scrolling);
         vte_terminal_set_enable_legacy_osc777(window->terminal, options.legacy_osc777);
         vte_terminal_set_mouse_autohide(window->terminal, true);
@@ -42,6 +42,8 @@
 
 #include "config.h"
 
+#include <algorithm>
+
 #include "bidi.hh"
 #include "debug.hh"
 #include "vtedefines.hh"
@@ -96,6 +98,77 @@ BidiRow::set_width(vte::grid::column_t width)
         m_width = width;
 }
 
+void
+BidiCache::validate(uint64_t generation,
+                    uint64_t frozen_generation) noexcept
+{
+        if (G_LIKELY (generation == m_generation &&
+                      frozen_generation == m_frozen_generation))
+                return;
+
+        m_entries.clear();
+        m_generation = generation;
+        m_frozen_generation = frozen_generation;
+}
+
+BidiCache::Entry*
+BidiCache::lookup(Key const& key,
+                  std::vector<uint64_t> const& row_ids) noexcept
+{
+        for (auto& entry : m_entries) {
+                if (entry.key == key && entry.row_ids == row_ids) {
+                        entry.last_used = ++m_clock;
+                        return &entry;
+                }
+        }
+
+        return nullptr;
+}
+
+BidiCache::Entry&
+BidiCache::insert(Key const& key,
+                  std::vector<uint64_t> const& row_ids)
+{
+        if (auto entry = lookup(key, row_ids))
+                return *entry;
+
+        /* Reuse the entry for the same rows with outdated contents if there is one,
+         * otherwise the least recently used one once the cache is full. */
+        auto it = std::find_if(m_entries.begin(), m_entries.end(),
+                               [&](Entry const& entry) { return entry.key == key; });
+        if (it == m_entries.end()) {
+                if (m_entries.size() < max_entries()) {
+                        m_entries.emplace_back();
+                        it = m_entries.end() - 1;
+                } else {
+                        it = std::min_element(m_entries.begin(), m_entries.end(),
+                                              [](Entry const& a, Entry const& b) { return a.last_used < b.last_used; });
+                }
+        }
+
+        it->key = key;
+        it->row_ids = row_ids;
+        it->rows.clear();
+        it->rows.resize(row_ids.size());
+        it->last_used = ++m_clock;
+        return *it;
+}
+
+/* Makes this row hold the same mapping as @other. */
+void
+BidiRow::copy_from(BidiRow const& other)
+{
+        set_width(other.m_width);
+        if (m_width > 0) {
+                std::copy_n(other.m_log2vis, m_width, m_log2vis);
+                std::copy_n(other.m_vis2log, m_width, m_vis2log);
+                std::copy_n(other.m_vis_rtl, m_width, m_vis_rtl);
+                std::copy_n(other.m_vis_shaped_base_char, m_width, m_vis_shaped_base_char);
+        }
+        m_base_rtl = other.m_base_rtl;
+        m_has_foreign = other.m_has_foreign;
+}
+
 /* Whether the cell at the given visual position has RTL directionality.
  * For offscreen columns the line's base direction is returned. */
 bool
@@ -335,13 +408,73 @@ BidiRunner::paragraph(vte::grid::row_t start, vte::grid::row_t end,
 {
         const VteRowData *row_data = m_ringview->get_row(start);
 
-        if (G_UNLIKELY (m_ringview->get_width() > G_MAXUSHORT)) {
+        auto width = m_ringview->get_width();
+
+        if (G_UNLIKELY (width > G_MAXUSHORT)) {
                 /* log2vis and vis2log mappings have 2 bytes per cell.
                  * Don't do BiDi for extremely wide terminals. */
                 explicit_paragraph(start, end, false, false);
                 return;
         }
 
+        /* The vast majority of paragraphs are LTR and don't contain any character
+         * that could change that or need shaping. Give them the trivial mapping
+         * without running FriBidi on them. */
+        if (!(row_data->attr.bidi_flags & VTE_BIDI_FLAG_RTL) &&
+            !paragraph_maybe_rtl(start, end)) {
+                explicit_paragraph(start, end, false, false);
+                return;
+        }
+
+        /* Reuse the mapping if another RingView on the same Ring computed it. */
+        auto& cache = m_ringview->m_ring->bidi_cache();
+        auto const key = BidiCache::Key{start, end, width, do_bidi, do_shaping};
+
+        m_row_ids.clear();
+        for (auto row = start; row < end; row++)
+                m_row_ids.push_back(m_ringview->row_id(row));
+
+        auto entry = cache.lookup(key, m_row_ids);
+        if (entry != nullptr) {
+                auto complete = true;
+                for (auto row = start; row < end && complete; row++) {
+                        complete = m_ringview->get_bidirow_writable(row) == nullptr ||
+                                entry->rows[row - start] != nullptr;
+                }
+
+                if (complete) {
+                        for (auto row = start; row < end; row++) {
+                                if (auto bidirow = m_ringview->get_bidirow_writable(row))
+                                        bidirow->copy_from(*entry->rows[row - start]);
+                        }
+                        return;
+                }
+        }
+
+        compute_paragraph(start, end, do_bidi, do_shaping);
+
+        /* Store the mapping of the rows that aren't context rows here */
+        entry = &cache.insert(key, m_row_ids);
+        for (auto row = start; row < end; row++) {
+                auto const bidirow = m_ringview->get_bidirow_writable(row);
+                if (bidirow == nullptr)
+                        continue;
+
+                auto& cached = entry->rows[row - start];
+                if (!cached)
+                        cached = std::make_unique<BidiRow>();
+                cached->copy_from(*bidirow);
+        }
+}
+
+/* Figure out the mapping for the paragraph between the given rows,
+ * which is not trivially LTR. */
+void
+BidiRunner::compute_paragraph(vte::grid::row_t start, vte::grid::row_t end,
+                              bool do_bidi, bool do_shaping)
+{
+        const VteRowData *row_data = m_ringview->get_row(start);
+
         if (!do_bidi) {
                 explicit_paragraph(start, end, false, do_shaping);
                 return;
@@ -361,6 +494,19 @@ BidiRunner::paragraph(vte::grid::row_t start, vte::grid::row_t end,
         explicit_paragraph(start, end, row_data->attr.bidi_flags & VTE_BIDI_FLAG_RTL, do_shaping);
 }
 
+/* Whether any of the lines of the paragraph between the given lines
+ * may contain a character that needs BiDi treatment or shaping. */
+bool
+BidiRunner::paragraph_maybe_rtl(vte::grid::row_t start, vte::grid::row_t end) const
+{
+        for (; start < end; start++) {
+                if (m_ringview->get_row(start)->attr.maybe_rtl)
+                        return true;
+        }
+
+        return false;
+}
+
 /* Set up the mapping according to explicit mode, for all the lines
  * of a paragraph between the given lines. */
 void
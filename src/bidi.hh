@@ -19,6 +19,10 @@
 
 #include <glib.h>
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "ring.hh"
 #include "ringview.hh"
 #include "vterowdata.hh"
@@ -116,6 +120,7 @@ public:
 
 private:
         void set_width(vte::grid::column_t width);
+        void copy_from(BidiRow const& other);
 
         /* The value of m_width == 0 is a valid representation of the trivial LTR mapping. */
         uint16_t m_width{0};
@@ -131,6 +136,65 @@ private:
         bool m_has_foreign{false};
 };
 
+/*
+ * BidiCache keeps the BiDi mappings of the recently computed paragraphs of
+ * a Ring, so that the RingViews on it (the onscreen one, and the short-lived
+ * ones e.g. for copying a block selection) don't all redo the same work.
+ *
+ * An entry is identified by the paragraph's rows, its width and the flags
+ * it was computed with, and is only valid for the row identities recorded
+ * with it (see RingView::row_id()). It only holds the mappings of the rows
+ * that were not context rows for some RingView.
+ */
+class BidiCache {
+public:
+        struct Key {
+                vte::grid::row_t start;
+                vte::grid::row_t end;
+                vte::grid::column_t width;
+                bool do_bidi;
+                bool do_shaping;
+
+                constexpr bool operator==(Key const& other) const noexcept = default;
+        };
+
+        struct Entry {
+                Key key;
+                std::vector<uint64_t> row_ids;
+                std::vector<std::unique_ptr<BidiRow>> rows; /* nullptr where not computed */
+                uint64_t last_used;
+        };
+
+        static inline constexpr size_t max_entries() noexcept { return 32; }
+
+        BidiCache() = default;
+        ~BidiCache() = default;
+
+        BidiCache(BidiCache const&) = delete;
+        BidiCache(BidiCache&&) = delete;
+        BidiCache& operator=(BidiCache const&) = delete;
+        BidiCache& operator=(BidiCache&&) = delete;
+
+        /* Drops all entries if the Ring's row identities changed meaning */
+        void validate(uint64_t generation,
+                      uint64_t frozen_generation) noexcept;
+
+        /* Returns the entry for @key with contents @row_ids, or nullptr */
+        Entry* lookup(Key const& key,
+                      std::vector<uint64_t> const& row_ids) noexcept;
+
+        /* Returns the entry for @key with contents @row_ids, evicting
+         * the least recently used one if needed. */
+        Entry& insert(Key const& key,
+                      std::vector<uint64_t> const& row_ids);
+
+private:
+        std::vector<Entry> m_entries{};
+        uint64_t m_generation{0};
+        uint64_t m_frozen_generation{0};
+        uint64_t m_clock{0};
+};
+
 
 /* BidiRunner is not a "real" class, rather the collection of methods that run the BiDi algorithm. */
 class BidiRunner {
@@ -164,6 +228,11 @@ public:
 private:
         RingView *m_ringview;
 
+        std::vector<uint64_t> m_row_ids{};
+
+        void compute_paragraph(vte::grid::row_t start, vte::grid::row_t end,
+                               bool do_bidi, bool do_shaping);
+        bool paragraph_maybe_rtl(vte::grid::row_t start, vte::grid::row_t end) const;
         void explicit_line(vte::grid::row_t row, bool rtl, bool do_shaping);
         void explicit_paragraph(vte::grid::row_t start, vte::grid::row_t end, bool rtl, bool do_shaping);
 
@@ -0,0 +1,211 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <initializer_list>
+
+#include <glib.h>
+
+#include "damage.hh"
+
+using namespace vte::terminal;
+
+static void
+assert_ranges(Damage const& d,
+              std::initializer_list<Damage::Range> l)
+{
+        auto const& ranges = d.ranges();
+        g_assert_cmpuint(ranges.size(), ==, l.size());
+
+        auto it = ranges.begin();
+        for (auto const& r : l) {
+                g_assert_cmpint(it->start, ==, r.start);
+                g_assert_cmpint(it->end, ==, r.end);
+                ++it;
+        }
+}
+
+static void
+test_damage_empty(void)
+{
+        Damage d;
+        g_assert_true(d.empty());
+        g_assert_false(d.all());
+        g_assert_cmpint(d.scroll(), ==, 0);
+        g_assert_false(d.cursor_moved());
+
+        d.add_rows(5, 5);
+        d.add_rows(7, 3);
+        g_assert_true(d.empty());
+}
+
+static void
+test_damage_merge(void)
+{
+        Damage d;
+        d.add_rows(10, 12);
+        assert_ranges(d, {{10, 12}});
+
+        /* Disjoint, before and after */
+        d.add_rows(20, 25);
+        d.add_rows(0, 2);
+        assert_ranges(d, {{0, 2}, {10, 12}, {20, 25}});
+
+        /* Adjacent ranges merge */
+        d.add_rows(12, 14);
+        d.add_rows(2, 3);
+        assert_ranges(d, {{0, 3}, {10, 14}, {20, 25}});
+
+        /* Contained range is a no-op */
+        d.add_rows(21, 23);
+        assert_ranges(d, {{0, 3}, {10, 14}, {20, 25}});
+
+        /* Spanning range swallows several */
+        d.add_rows(5, 21);
+        assert_ranges(d, {{0, 3}, {5, 25}});
+
+        d.add_rows(-10, 100);
+        assert_ranges(d, {{-10, 100}});
+
+        d.clear();
+        g_assert_true(d.empty());
+        assert_ranges(d, {});
+}
+
+static void
+test_damage_coalesce(void)
+{
+        Damage d;
+        for (auto i = Damage::row_t(0); i < Damage::row_t(Damage::max_ranges()); ++i)
+                d.add_rows(i * 10, i * 10 + 1);
+
+        g_assert_cmpuint(d.ranges().size(), ==, Damage::max_ranges());
+
+        /* Adding one more range coalesces the two closest ones */
+        d.add_rows(1000, 1001);
+        d.add_rows(1003, 1004);
+        g_assert_cmpuint(d.ranges().size(), ==, Damage::max_ranges());
+        g_assert_cmpint(d.ranges().back().start, ==, 1000);
+        g_assert_cmpint(d.ranges().back().end, ==, 1004);
+
+        /* The result still covers all the rows */
+        for (auto i = Damage::row_t(0); i < Damage::row_t(Damage::max_ranges()); ++i) {
+                auto covered = false;
+                for (auto const& r : d.ranges())
+                        covered |= r.start <= i * 10 && i * 10 < r.end;
+                g_assert_true(covered);
+        }
+}
+
+static void
+test_damage_all(void)
+{
+        Damage d;
+        d.add_rows(1, 2);
+        d.add_all();
+        g_assert_true(d.all());
+        g_assert_false(d.empty());
+        assert_ranges(d, {});
+
+        d.add_rows(3, 4);
+        assert_ranges(d, {});
+
+        d.clear();
+        g_assert_false(d.all());
+        g_assert_true(d.empty());
+}
+
+static void
+test_damage_scroll(void)
+{
+        Damage d;
+        d.add_scroll(3);
+        d.add_scroll(4);
+        g_assert_cmpint(d.scroll(), ==, 7);
+        g_assert_false(d.empty());
+
+        d.clear();
+        g_assert_cmpint(d.scroll(), ==, 0);
+}
+
+static void
+test_damage_scroll_output(void)
+{
+        /* A 24 row screen at the bottom of 100 rows of scrollback: a line
+         * is written on the last row, and the output scrolls by one row.
+         * Scrolling the view along with it only redraws, so it isn't
+         * recorded, and only the written and the new row are reported.
+         */
+        Damage d;
+        d.set_recording(true);
+        d.record_rows(123, 124);
+        d.set_recording(false);
+
+        /* Invalidations outside of processing only concern the rendering */
+        d.record_all();
+        d.record_rows(0, 124);
+
+        d.add_scrolled(100, 101, 24);
+        g_assert_false(d.all());
+        g_assert_cmpint(d.scroll(), ==, 1);
+        assert_ranges(d, {{123, 125}});
+
+        /* No scrolling, no new rows */
+        d.clear();
+        d.add_scrolled(101, 101, 24);
+        g_assert_true(d.empty());
+
+        /* Scrolling by more than a screen */
+        d.add_scrolled(101, 131, 24);
+        g_assert_cmpint(d.scroll(), ==, 30);
+        assert_ranges(d, {{125, 155}});
+}
+
+static void
+test_damage_cursor(void)
+{
+        Damage d;
+        d.move_cursor(1, 2, 3, 4);
+        g_assert_true(d.cursor_moved());
+        d.move_cursor(3, 4, 5, 6);
+        g_assert_true(d.cursor_moved());
+        g_assert_cmpint(d.old_cursor_row(), ==, 1);
+        g_assert_cmpint(d.old_cursor_column(), ==, 2);
+        g_assert_cmpint(d.cursor_row(), ==, 5);
+        g_assert_cmpint(d.cursor_column(), ==, 6);
+
+        /* Moving back to the start is no move at all */
+        d.move_cursor(5, 6, 1, 2);
+        g_assert_false(d.cursor_moved());
+        g_assert_true(d.empty());
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/damage/empty", test_damage_empty);
+        g_test_add_func("/vte/damage/merge", test_damage_merge);
+        g_test_add_func("/vte/damage/coalesce", test_damage_coalesce);
+        g_test_add_func("/vte/damage/all", test_damage_all);
+        g_test_add_func("/vte/damage/scroll", test_damage_scroll);
+        g_test_add_func("/vte/damage/scroll/output", test_damage_scroll_output);
+        g_test_add_func("/vte/damage/cursor", test_damage_cursor);
+
+        return g_test_run();
+}
@@ -0,0 +1,215 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace vte {
+
+namespace terminal {
+
+/*
+ * Damage:
+ *
+ * Accumulates a structured description of how the buffer contents
+ * changed between two emissions of the contents-changed signal:
+ * the changed row ranges (in absolute buffer coordinates), by how
+ * many rows the screen scrolled, and where the cursor moved from and to.
+ *
+ * The row ranges are kept sorted and disjoint; adjacent and overlapping
+ * ranges are merged. When more than max_ranges() ranges would be needed,
+ * the two ranges with the smallest gap between them are coalesced, so
+ * the description always stays a (conservative) superset of the changes.
+ */
+class Damage {
+public:
+        using row_t = long;
+        using column_t = long;
+
+        struct Range {
+                row_t start; /* inclusive */
+                row_t end; /* exclusive */
+
+                constexpr bool operator==(Range const& other) const noexcept
+                {
+                        return start == other.start && end == other.end;
+                }
+        };
+
+        static inline constexpr size_t max_ranges() noexcept { return 16; }
+
+        Damage() noexcept = default;
+        ~Damage() = default;
+
+        Damage(Damage const&) = default;
+        Damage(Damage&&) = default;
+
+        Damage& operator=(Damage const&) = default;
+        Damage& operator=(Damage&&) = default;
+
+        /* Whether nothing at all was recorded since the last clear() */
+        inline constexpr bool empty() const noexcept
+        {
+                return !m_all && m_ranges.empty() && m_scroll == 0 && !m_cursor_moved;
+        }
+
+        /* Whether the whole buffer needs to be considered as changed */
+        inline constexpr bool all() const noexcept { return m_all; }
+
+        inline constexpr auto const& ranges() const noexcept { return m_ranges; }
+
+        inline constexpr auto scroll() const noexcept { return m_scroll; }
+
+        inline constexpr auto cursor_moved() const noexcept { return m_cursor_moved; }
+        inline constexpr auto old_cursor_row() const noexcept { return m_old_cursor_row; }
+        inline constexpr auto old_cursor_column() const noexcept { return m_old_cursor_column; }
+        inline constexpr auto cursor_row() const noexcept { return m_cursor_row; }
+        inline constexpr auto cursor_column() const noexcept { return m_cursor_column; }
+
+        /* Whether invalidations should currently be recorded as content damage */
+        inline constexpr bool recording() const noexcept { return m_recording; }
+        inline void set_recording(bool recording) noexcept { m_recording = recording; }
+
+        void clear() noexcept
+        {
+                m_ranges.clear();
+                m_all = false;
+                m_scroll = 0;
+                m_cursor_moved = false;
+        }
+
+        void add_all() noexcept
+        {
+                m_ranges.clear();
+                m_all = true;
+        }
+
+        void add_rows(row_t start,
+                      row_t end /* exclusive */)
+        {
+                if (m_all || end <= start)
+                        return;
+
+                /* Find the first range that ends at or after @start, i.e. the first
+                 * one that is either adjacent to, overlaps, or lies after the new range.
+                 */
+                auto it = std::lower_bound(m_ranges.begin(), m_ranges.end(), start,
+                                           [](Range const& r, row_t row) { return r.end < row; });
+
+                /* Merge with all ranges it touches */
+                auto last = it;
+                while (last != m_ranges.end() && last->start <= end) {
+                        start = std::min(start, last->start);
+                        end = std::max(end, last->end);
+                        ++last;
+                }
+
+                if (it != last) {
+                        *it = Range{start, end};
+                        m_ranges.erase(it + 1, last);
+                } else {
+                        m_ranges.insert(it, Range{start, end});
+                }
+
+                if (m_ranges.size() > max_ranges())
+                        coalesce();
+        }
+
+        void add_scroll(row_t amount) noexcept
+        {
+                m_scroll += amount;
+        }
+
+        /* Records that the screen of @rows rows scrolled from @old_top to
+         * @top by output; the rows scrolled in at the bottom are new.
+         */
+        void add_scrolled(row_t old_top,
+                          row_t top,
+                          row_t rows)
+        {
+                if (top == old_top)
+                        return;
+
+                add_scroll(top - old_top);
+                add_rows(old_top + rows, top + rows);
+        }
+
+        /* Like add_rows() and add_all(), but only while recording */
+        void record_rows(row_t start,
+                         row_t end /* exclusive */)
+        {
+                if (m_recording)
+                        add_rows(start, end);
+        }
+
+        void record_all() noexcept
+        {
+                if (m_recording)
+                        add_all();
+        }
+
+        void move_cursor(row_t old_row,
+                         column_t old_column,
+                         row_t row,
+                         column_t column) noexcept
+        {
+                /* Keep the position from before the first move */
+                if (!m_cursor_moved) {
+                        m_old_cursor_row = old_row;
+                        m_old_cursor_column = old_column;
+                }
+
+                m_cursor_row = row;
+                m_cursor_column = column;
+                m_cursor_moved = m_cursor_row != m_old_cursor_row ||
+                        m_cursor_column != m_old_cursor_column;
+        }
+
+private:
+        std::vector<Range> m_ranges{};
+        row_t m_scroll{0};
+        row_t m_old_cursor_row{0};
+        column_t m_old_cursor_column{0};
+        row_t m_cursor_row{0};
+        column_t m_cursor_column{0};
+        bool m_all{false};
+        bool m_cursor_moved{false};
+        bool m_recording{false};
+
+        /* Merges the two neighbouring ranges with the smallest gap */
+        void coalesce() noexcept
+        {
+                auto best = m_ranges.begin();
+                auto best_gap = (best + 1)->start - best->end;
+                for (auto it = best + 1; it + 1 != m_ranges.end(); ++it) {
+                        auto const gap = (it + 1)->start - it->end;
+                        if (gap < best_gap) {
+                                best = it;
+                                best_gap = gap;
+                        }
+                }
+
+                best->end = (best + 1)->end;
+                m_ranges.erase(best + 1);
+        }
+
+}; // class Damage
+
+} // namespace terminal
+
+} // namespace vte
@@ -153,6 +153,11 @@ DrawingCairo::draw_text(TextRequest* requests,
 
         g_assert(m_cr);
 
+        /* No UnistrInfo pointers are held at this point */
+        font->trim();
+
+        update_minifont_atlas();
+
         _vte_set_source_color(m_cr, color);
         cairo_set_operator(m_cr, CAIRO_OPERATOR_OVER);
 
@@ -164,6 +169,23 @@ DrawingCairo::draw_text(TextRequest* requests,
                 }
 
                 if (Minifont::unistr_is_local_graphic(c)) {
+                        auto atlas_x = 0, atlas_y = 0;
+                        if (requests[i].columns == 1 &&
+                            m_minifont_atlas.lookup(c, atlas_x, atlas_y)) [[likely]] {
+                                /* Blit the glyph from the atlas */
+                                cairo_save(m_cr);
+                                cairo_rectangle(m_cr,
+                                                requests[i].x, requests[i].y,
+                                                cell_width(), cell_height());
+                                cairo_clip(m_cr);
+                                cairo_mask_surface(m_cr,
+                                                   m_minifont_atlas.surface(),
+                                                   requests[i].x - atlas_x,
+                                                   requests[i].y - atlas_y);
+                                cairo_restore(m_cr);
+                                continue;
+                        }
+
                         m_minifont.draw_graphic(cairo(),
                                                 c,
                                                 color,
@@ -122,6 +122,19 @@ DrawingContext::set_text_font(GtkWidget* widget,
         m_char_spacing.bottom = (m_cell_height - m_fonts[VTE_DRAW_NORMAL]->height()) / 2;
 
         m_undercurl_surface.reset();
+
+        update_minifont_atlas();
+}
+
+void
+DrawingContext::update_minifont_atlas()
+{
+        /* This is a no-op unless the font or the scale factor changed */
+        m_minifont_atlas.update(m_cell_width,
+                                m_cell_height,
+                                m_fonts[VTE_DRAW_NORMAL]->width(),
+                                m_fonts[VTE_DRAW_NORMAL]->height(),
+                                m_scale_factor);
 }
 
 void
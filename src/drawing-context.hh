@@ -278,6 +278,11 @@ protected:
         /* Cache the undercurl's rendered look. */
         vte::Freeable<cairo_surface_t> m_undercurl_surface{};
         int m_undercurl_surface_scale{0};
+
+        /* The local graphics pre-rendered for the current cell size. */
+        MinifontAtlas m_minifont_atlas{};
+
+        void update_minifont_atlas();
 }; // class DrawingContext
 
 } // namespace view
@@ -17,6 +17,9 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "bidi.hh"
 #include "debug.hh"
 #include "drawing-gsk.hh"
@@ -54,6 +57,42 @@ DrawingGsk::set_snapshot(GtkSnapshot *snapshot) noexcept
         m_snapshot = snapshot;
 }
 
+void
+DrawingGsk::begin_node() noexcept
+{
+        g_assert(m_snapshot);
+        g_assert(!m_saved_snapshot);
+
+        m_saved_snapshot = std::exchange(m_snapshot, gtk_snapshot_new());
+}
+
+vte::Freeable<GskRenderNode>
+DrawingGsk::end_node() noexcept
+{
+        g_assert(m_saved_snapshot);
+
+        auto node = vte::take_freeable(gtk_snapshot_free_to_node(m_snapshot));
+        m_snapshot = std::exchange(m_saved_snapshot, nullptr);
+        return node;
+}
+
+void
+DrawingGsk::append_node(GskRenderNode* node,
+                        int x,
+                        int y) const noexcept
+{
+        g_assert(m_snapshot);
+
+        if (!node)
+                return;
+
+        auto const point = GRAPHENE_POINT_INIT(float(x), float(y));
+        gtk_snapshot_save(m_snapshot);
+        gtk_snapshot_translate(m_snapshot, &point);
+        gtk_snapshot_append_node(m_snapshot, node);
+        gtk_snapshot_restore(m_snapshot);
+}
+
 void
 DrawingGsk::clear(int x,
                   int y,
@@ -159,6 +198,11 @@ DrawingGsk::draw_text(TextRequest* requests,
         if (n_requests == 0)
                 return;
 
+        /* No UnistrInfo pointers are held at this point */
+        font->trim();
+
+        update_minifont_atlas();
+
         auto const rgba = color->rgba(1.0);
         PangoFont *node_font = nullptr;
 
@@ -172,6 +216,14 @@ DrawingGsk::draw_text(TextRequest* requests,
                 }
 
                 if (Minifont::unistr_is_local_graphic(c)) {
+                        auto atlas_x = 0, atlas_y = 0;
+                        if (requests[i].columns == 1 &&
+                            m_minifont_atlas.lookup(c, atlas_x, atlas_y)) [[likely]] {
+                                m_atlas_glyphs.emplace_back(requests[i].x, requests[i].y,
+                                                            atlas_x, atlas_y);
+                                continue;
+                        }
+
                         m_minifont.draw_graphic(*this,
                                                 c,
                                                 color,
@@ -223,6 +275,48 @@ DrawingGsk::draw_text(TextRequest* requests,
         }
 
         flush_glyph_string (node_font, &rgba);
+        flush_minifont_atlas(&rgba);
+}
+
+/* Draws all the collected local graphics as one mask node over the
+ * atlas texture, clipped to each glyph's cell.
+ */
+void
+DrawingGsk::flush_minifont_atlas(GdkRGBA const* rgba)
+{
+        if (m_atlas_glyphs.empty())
+                return;
+
+        auto const texture = m_minifont_atlas.texture();
+        auto const atlas_width = m_minifont_atlas.width();
+        auto const atlas_height = m_minifont_atlas.height();
+
+        auto bounds = graphene_rect_t{};
+        auto first = true;
+
+        gtk_snapshot_push_mask(m_snapshot, GSK_MASK_MODE_ALPHA);
+        for (auto const& glyph : m_atlas_glyphs) {
+                auto const cell = vte::graphene::make_rect(glyph.x, glyph.y,
+                                                           cell_width(), cell_height());
+                auto const texture_bounds = vte::graphene::make_rect(glyph.x - glyph.atlas_x,
+                                                                     glyph.y - glyph.atlas_y,
+                                                                     atlas_width,
+                                                                     atlas_height);
+                gtk_snapshot_push_clip(m_snapshot, &cell);
+                gtk_snapshot_append_texture(m_snapshot, texture, &texture_bounds);
+                gtk_snapshot_pop(m_snapshot);
+
+                if (first)
+                        bounds = cell;
+                else
+                        graphene_rect_union(&bounds, &cell, &bounds);
+                first = false;
+        }
+        gtk_snapshot_pop(m_snapshot);
+        gtk_snapshot_append_color(m_snapshot, rgba, &bounds);
+        gtk_snapshot_pop(m_snapshot);
+
+        m_atlas_glyphs.clear();
 }
 
 void
@@ -289,18 +383,44 @@ DrawingGsk::begin_background(Rectangle const& rect,
 {
         m_background_cols = columns;
         m_background_rows = rows;
-        m_background_len = columns * rows;
-        m_background_set = false;
-        m_background_data = vte::glib::take_free_ptr(g_new0(r8g8b8a8, m_background_len));
+        m_background_single_runs = true;
+        m_background_runs.clear();
 }
 
 void
 DrawingGsk::flush_background(Rectangle const& rect)
 {
-        if (m_background_set) {
+        auto const bounds = rect.graphene();
+
+        if (m_background_runs.empty()) {
+                /* Nothing to draw */
+        } else if (m_background_single_runs) {
+                auto const column_width = bounds->size.width / m_background_cols;
+                auto const row_height = bounds->size.height / m_background_rows;
+
+                for (auto const& run : m_background_runs) {
+                        auto const rgba = GdkRGBA{run.color.red / 255.f,
+                                                  run.color.green / 255.f,
+                                                  run.color.blue / 255.f,
+                                                  1.f};
+                        auto const run_bounds = GRAPHENE_RECT_INIT(bounds->origin.x + run.column * column_width,
+                                                                   bounds->origin.y + run.row * row_height,
+                                                                   run.n_columns * column_width,
+                                                                   row_height);
+                        gtk_snapshot_append_color(m_snapshot, &rgba, &run_bounds);
+                }
+        } else {
+                auto const len = m_background_cols * m_background_rows;
+                m_background_data.assign(len, r8g8b8a8{0, 0, 0, 0});
+
+                for (auto const& run : m_background_runs)
+                        std::fill_n(m_background_data.data() + (run.row * m_background_cols + run.column),
+                                    run.n_columns,
+                                    run.color);
+
                 auto bytes = vte::take_freeable
-                        (g_bytes_new_take(m_background_data.release(),
-                                          m_background_len * sizeof(r8g8b8a8)));
+                        (g_bytes_new(m_background_data.data(),
+                                     len * sizeof(r8g8b8a8)));
                 auto texture = vte::glib::take_ref
                         (gdk_memory_texture_new(m_background_cols,
                                                 m_background_rows,
@@ -310,15 +430,13 @@ DrawingGsk::flush_background(Rectangle const& rect)
                 gtk_snapshot_append_scaled_texture(m_snapshot,
                                                    texture.get(),
                                                    GSK_SCALING_FILTER_NEAREST,
-                                                   rect.graphene());
-        } else {
-                m_background_data.reset();
+                                                   bounds);
         }
 
+        m_background_runs.clear();
         m_background_cols = 0;
         m_background_rows = 0;
-        m_background_len = 0;
-        m_background_set = false;
+        m_background_single_runs = true;
 }
 
 } // namespace view
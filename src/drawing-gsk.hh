@@ -17,10 +17,13 @@
 
 #pragma once
 
+#include <vector>
+
 #include <gtk/gtk.h>
 
 #include "drawing-context.hh"
 #include "glib-glue.hh"
+#include "gtk-glue.hh"
 #include "minifont.hh"
 
 #define GDK_ARRAY_NAME vte_glyphs
@@ -56,6 +59,17 @@ public:
 
         void set_snapshot(GtkSnapshot *snapshot) noexcept;
 
+        /* Redirects all drawing into a new snapshot until end_node(),
+         * which returns what was drawn as a render node (or nullptr
+         * if nothing was drawn) to be added later with append_node().
+         * Calls may not be nested.
+         */
+        void begin_node() noexcept;
+        vte::Freeable<GskRenderNode> end_node() noexcept;
+        void append_node(GskRenderNode* node,
+                         int x,
+                         int y) const noexcept;
+
         cairo_t* begin_cairo(int x,
                              int y,
                              int width,
@@ -125,21 +139,25 @@ public:
                        uint32_t attr,
                        vte::color::rgb const* color) override;
 
+        /* The runs must be added in row order. */
         inline void fill_cell_background(size_t column,
                                          size_t row,
                                          size_t n_columns,
                                          vte::color::rgb const* color) override {
                 assert(column + n_columns <= m_background_cols);
-
-                auto const fill = r8g8b8a8{uint8_t(color->red >> 8),
-                                           uint8_t(color->green >> 8),
-                                           uint8_t(color->blue >> 8),
-                                           uint8_t(0xffu)};
-                std::fill_n(m_background_data.get() + (row * m_background_cols + column),
-                            n_columns,
-                            fill);
-
-                m_background_set = true;
+                assert(row < m_background_rows);
+
+                if (!m_background_runs.empty() &&
+                    m_background_runs.back().row == row)
+                        m_background_single_runs = false;
+
+                m_background_runs.emplace_back(uint32_t(column),
+                                               uint32_t(row),
+                                               uint32_t(n_columns),
+                                               r8g8b8a8{uint8_t(color->red >> 8),
+                                                        uint8_t(color->green >> 8),
+                                                        uint8_t(color->blue >> 8),
+                                                        uint8_t(0xffu)});
         }
 
         void begin_background(Rectangle const& rect,
@@ -149,17 +167,38 @@ public:
 
 private:
         GtkSnapshot *m_snapshot{nullptr}; // unowned
+        GtkSnapshot *m_saved_snapshot{nullptr}; // unowned
         VteGlyphs m_glyphs;
         MinifontGsk m_minifont{};
 
-        vte::glib::FreePtr<r8g8b8a8> m_background_data;
-        size_t m_background_len{0};
+        /* The local graphics to blit from the minifont atlas */
+        struct AtlasGlyph {
+                int x, y;
+                int atlas_x, atlas_y;
+        };
+        std::vector<AtlasGlyph> m_atlas_glyphs{};
+
+        /* The background is collected as runs of cells with the same
+         * colour. If no row has more than one run, each run becomes a
+         * colour node; otherwise, the runs are rasterised into
+         * m_background_data (which is kept around to be reused) and
+         * drawn as a scaled texture with one pixel per cell.
+         */
+        struct BackgroundRun {
+                uint32_t column;
+                uint32_t row;
+                uint32_t n_columns;
+                r8g8b8a8 color;
+        };
+        std::vector<BackgroundRun> m_background_runs{};
+        std::vector<r8g8b8a8> m_background_data{};
         size_t m_background_cols{0};
         size_t m_background_rows{0};
-        bool m_background_set{false};
+        bool m_background_single_runs{true};
 
         void flush_glyph_string(PangoFont* font,
                                 const GdkRGBA* rgba);
+        void flush_minifont_atlas(GdkRGBA const* rgba);
 
 };
 
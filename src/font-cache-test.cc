@@ -0,0 +1,137 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <cstring>
+
+#include <glib.h>
+
+#include "font-cache.hh"
+
+using namespace std::literals;
+using namespace vte::view;
+
+static constexpr auto const key = "vte 0.85 gtk4 pango 1.56 64-bit\nfont Monospace 12\n"sv;
+
+static FontCache
+make_cache()
+{
+        auto cache = FontCache{};
+        cache.width = 9;
+        cache.height = 19;
+        cache.ascent = 15;
+        cache.font = "DejaVu Sans Mono 16px"s;
+        cache.glyphs.push_back({'A', 36, 9 * 1024, 9});
+        cache.glyphs.push_back({'z', 93, 9 * 1024, 9});
+        return cache;
+}
+
+static void
+test_font_cache_roundtrip(void)
+{
+        auto const cache = make_cache();
+        auto const data = serialize_font_cache(key, cache);
+        auto const parsed = parse_font_cache(data, key, 128);
+        g_assert_true(parsed.has_value());
+        g_assert_cmpint(parsed->width, ==, cache.width);
+        g_assert_cmpint(parsed->height, ==, cache.height);
+        g_assert_cmpint(parsed->ascent, ==, cache.ascent);
+        g_assert_cmpstr(parsed->font.c_str(), ==, cache.font.c_str());
+        g_assert_cmpuint(parsed->glyphs.size(), ==, cache.glyphs.size());
+        for (auto i = size_t{0}; i < cache.glyphs.size(); ++i) {
+                g_assert_cmpuint(parsed->glyphs[i].c, ==, cache.glyphs[i].c);
+                g_assert_cmpuint(parsed->glyphs[i].glyph, ==, cache.glyphs[i].glyph);
+                g_assert_cmpint(parsed->glyphs[i].width, ==, cache.glyphs[i].width);
+                g_assert_cmpuint(parsed->glyphs[i].pixel_width, ==, cache.glyphs[i].pixel_width);
+        }
+
+        /* Metrics without glyphs */
+        auto empty = make_cache();
+        empty.glyphs.clear();
+        auto const parsed_empty = parse_font_cache(serialize_font_cache(key, empty), key, 128);
+        g_assert_true(parsed_empty.has_value());
+        g_assert_cmpuint(parsed_empty->glyphs.size(), ==, 0);
+}
+
+static void
+test_font_cache_truncated(void)
+{
+        auto const data = serialize_font_cache(key, make_cache());
+        for (auto size = size_t{0}; size < data.size(); ++size)
+                g_assert_false(parse_font_cache(std::string_view{data}.substr(0, size), key, 128).has_value());
+
+        /* Trailing garbage */
+        g_assert_false(parse_font_cache(data + "x"s, key, 128).has_value());
+}
+
+static void
+test_font_cache_version(void)
+{
+        auto data = serialize_font_cache(key, make_cache());
+
+        /* The version follows the 8 byte magic */
+        auto version = uint32_t{};
+        memcpy(&version, data.data() + 8, sizeof(version));
+        ++version;
+        memcpy(data.data() + 8, &version, sizeof(version));
+        g_assert_false(parse_font_cache(data, key, 128).has_value());
+
+        auto bad_magic = serialize_font_cache(key, make_cache());
+        bad_magic[0] = 'X';
+        g_assert_false(parse_font_cache(bad_magic, key, 128).has_value());
+}
+
+static void
+test_font_cache_key(void)
+{
+        auto const data = serialize_font_cache(key, make_cache());
+
+        /* Same size, different contents */
+        auto other_key = std::string{key};
+        other_key.back() = '\t';
+        g_assert_false(parse_font_cache(data, other_key, 128).has_value());
+
+        /* Different size */
+        g_assert_false(parse_font_cache(data, key.substr(1), 128).has_value());
+        g_assert_false(parse_font_cache(data, ""sv, 128).has_value());
+}
+
+static void
+test_font_cache_limits(void)
+{
+        auto const data = serialize_font_cache(key, make_cache());
+        g_assert_true(parse_font_cache(data, key, 2).has_value());
+        g_assert_false(parse_font_cache(data, key, 1).has_value());
+
+        auto cache = make_cache();
+        cache.height = 0;
+        g_assert_false(parse_font_cache(serialize_font_cache(key, cache), key, 128).has_value());
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/font-cache/roundtrip", test_font_cache_roundtrip);
+        g_test_add_func("/vte/font-cache/truncated", test_font_cache_truncated);
+        g_test_add_func("/vte/font-cache/version", test_font_cache_version);
+        g_test_add_func("/vte/font-cache/key", test_font_cache_key);
+        g_test_add_func("/vte/font-cache/limits", test_font_cache_limits);
+
+        return g_test_run();
+}
@@ -0,0 +1,212 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include "font-cache.hh"
+
+#include <cstring>
+
+#ifdef VTE_COMPILATION
+#include <cerrno>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "debug.hh"
+#include "refptr.hh"
+#endif
+
+namespace vte::view {
+
+/* The file starts with the header. All integers are in host byte order;
+ * the key includes the architecture via the vte build, so that's fine.
+ *
+ * The header is followed by the n_glyphs glyph records, the key, and
+ * the description of the font the glyphs belong to.
+ */
+namespace {
+
+struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t n_glyphs;
+        uint32_t key_size;
+        uint32_t font_size;
+        int32_t width;
+        int32_t height;
+        int32_t ascent;
+        uint32_t padding;
+};
+
+static_assert(sizeof(Header) % alignof(FontCache::Glyph) == 0, "Misaligned glyphs");
+static_assert(sizeof(FontCache::Glyph) == 16, "Unexpected glyph record size");
+
+} // anon namespace
+
+static constexpr char const font_cache_magic[8] = {'V', 'T', 'E', 'F', 'O', 'N', 'T', '\0'};
+static constexpr uint32_t const font_cache_version = 1;
+
+std::string
+serialize_font_cache(std::string_view key,
+                     FontCache const& cache)
+{
+        auto header = Header{};
+        memcpy(header.magic, font_cache_magic, sizeof(font_cache_magic));
+        header.version = font_cache_version;
+        header.n_glyphs = uint32_t(cache.glyphs.size());
+        header.key_size = uint32_t(key.size());
+        header.font_size = uint32_t(cache.font.size());
+        header.width = cache.width;
+        header.height = cache.height;
+        header.ascent = cache.ascent;
+
+        auto data = std::string{};
+        data.reserve(sizeof(header) +
+                     cache.glyphs.size() * sizeof(FontCache::Glyph) +
+                     key.size() +
+                     cache.font.size());
+        data.append(reinterpret_cast<char const*>(&header), sizeof(header));
+        data.append(reinterpret_cast<char const*>(cache.glyphs.data()),
+                    cache.glyphs.size() * sizeof(FontCache::Glyph));
+        data.append(key);
+        data.append(cache.font);
+
+        return data;
+}
+
+/*
+ * parse_font_cache:
+ * @data: the file contents
+ * @key: the key the file must be for
+ * @max_glyphs: the maximum number of glyphs the file may contain
+ *
+ * Returns: the cache stored in @data, or %std::nullopt if @data is not
+ *   a valid cache file of the current version for @key
+ */
+std::optional<FontCache>
+parse_font_cache(std::string_view data,
+                 std::string_view key,
+                 size_t max_glyphs)
+{
+        auto header = Header{};
+        if (data.size() < sizeof(header))
+                return std::nullopt;
+
+        memcpy(&header, data.data(), sizeof(header));
+        if (memcmp(header.magic, font_cache_magic, sizeof(font_cache_magic)) != 0 ||
+            header.version != font_cache_version ||
+            header.n_glyphs > max_glyphs ||
+            data.size() != sizeof(header) + size_t(header.n_glyphs) * sizeof(FontCache::Glyph) + header.key_size + header.font_size ||
+            header.width < 1 || header.height < 1)
+                return std::nullopt;
+
+        auto const glyphs = data.substr(sizeof(header), header.n_glyphs * sizeof(FontCache::Glyph));
+        auto const stored_key = data.substr(sizeof(header) + glyphs.size(), header.key_size);
+        if (stored_key != key)
+                return std::nullopt;
+
+        auto cache = FontCache{};
+        cache.width = header.width;
+        cache.height = header.height;
+        cache.ascent = header.ascent;
+        cache.font = data.substr(sizeof(header) + glyphs.size() + stored_key.size());
+        cache.glyphs.resize(header.n_glyphs);
+        memcpy(cache.glyphs.data(), glyphs.data(), glyphs.size());
+
+        return cache;
+}
+
+#ifdef VTE_COMPILATION
+
+vte::glib::StringPtr
+font_cache_path(std::string_view key)
+{
+        auto const checksum = vte::glib::take_string
+                (g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                                             reinterpret_cast<guchar const*>(key.data()),
+                                             key.size()));
+        auto const basename = fmt::format("{}.bin", checksum.get());
+        return vte::glib::take_string(g_build_filename(g_get_user_cache_dir(),
+                                                       "vte",
+                                                       "fonts",
+                                                       basename.c_str(),
+                                                       nullptr));
+}
+
+namespace {
+
+struct SaveData {
+        vte::glib::StringPtr path;
+        std::string contents;
+};
+
+} // anon namespace
+
+static void
+save_font_cache_thread(GTask* task,
+                       gpointer source_object,
+                       gpointer task_data,
+                       GCancellable* cancellable)
+{
+        auto const data = reinterpret_cast<SaveData const*>(task_data);
+        auto const path = data->path.get();
+
+        auto const dir = vte::glib::take_string(g_path_get_dirname(path));
+        auto error = vte::glib::Error{};
+        if (g_mkdir_with_parents(dir.get(), 0700) != 0 ||
+            !g_file_set_contents_full(path,
+                                      data->contents.data(),
+                                      data->contents.size(),
+                                      G_FILE_SET_CONTENTS_CONSISTENT,
+                                      0600,
+                                      error)) {
+                _vte_debug_print(vte::debug::category::PANGOCAIRO,
+                                 "vtepangocairo: failed to write font cache {}: {}",
+                                 path,
+                                 error.message() ? error.message() : g_strerror(errno));
+                g_task_return_boolean(task, false);
+                return;
+        }
+
+        _vte_debug_print(vte::debug::category::PANGOCAIRO,
+                         "vtepangocairo: wrote font cache {}",
+                         path);
+        g_task_return_boolean(task, true);
+}
+
+/*
+ * save_font_cache_async:
+ * @key: the key
+ * @contents: the serialized cache
+ *
+ * Writes @contents to the cache file for @key in a worker thread, so that
+ * the disk I/O doesn't block the main loop. Failure to write the file
+ * is not an error.
+ */
+void
+save_font_cache_async(std::string_view key,
+                      std::string contents)
+{
+        auto task = vte::glib::take_ref(g_task_new(nullptr, nullptr, nullptr, nullptr));
+        g_task_set_task_data(task.get(),
+                             new SaveData{font_cache_path(key), std::move(contents)},
+                             [](void* data) { delete reinterpret_cast<SaveData*>(data); });
+        g_task_run_in_thread(task.get(), save_font_cache_thread);
+}
+
+#endif /* VTE_COMPILATION */
+
+} // namespace vte::view
@@ -0,0 +1,74 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef VTE_COMPILATION
+#include "glib-glue.hh"
+#endif
+
+namespace vte::view {
+
+/*
+ * FontCache:
+ *
+ * The contents of the on-disk cache of a font's metrics and its cached
+ * ASCII glyphs, shared between the processes using the same font; see
+ * fonts-pangocairo.hh.
+ *
+ * The file is keyed by a string describing the font and its rendering
+ * options, which is stored in the file too, and also contains the
+ * description of the font the glyphs belong to, so that the reader can
+ * check that the font still resolves to the same one.
+ */
+struct FontCache {
+        struct Glyph {
+                uint32_t c;
+                uint32_t glyph;
+                int32_t width; /* in pango units */
+                uint32_t pixel_width;
+        };
+
+        int32_t width{1};
+        int32_t height{1};
+        int32_t ascent{0};
+        std::vector<Glyph> glyphs{};
+        std::string font{};
+};
+
+std::string serialize_font_cache(std::string_view key,
+                                 FontCache const& cache);
+
+std::optional<FontCache> parse_font_cache(std::string_view data,
+                                          std::string_view key,
+                                          size_t max_glyphs);
+
+#ifdef VTE_COMPILATION
+
+vte::glib::StringPtr font_cache_path(std::string_view key);
+
+void save_font_cache_async(std::string_view key,
+                           std::string contents);
+
+#endif /* VTE_COMPILATION */
+
+} // namespace vte::view
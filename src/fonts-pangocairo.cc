@@ -18,10 +18,15 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "fonts-pangocairo.hh"
 
 #include "cairo-glue.hh"
 #include "debug.hh"
+#include "font-cache.hh"
+#include "minifont.hh"
 #include "vtedefines.hh"
 
 /* Have a space between letters to make sure ligatures aren't used when caching the glyphs: bug 793391. */
@@ -47,27 +52,201 @@ _vte_double_equal(double a,
 
 #define FONT_CACHE_TIMEOUT (30) /* seconds */
 
+/* How many characters to shape per run of the warm-up idle handler */
+#define WARM_UP_BATCH_SIZE (32)
+
 namespace vte {
 namespace view {
 
 static GHashTable* s_font_info_for_context{nullptr};
 
+/* The blocks of commonly used characters that are shaped ahead of their
+ * first use. Characters that the minifont draws are skipped. */
+static constexpr struct {
+        vteunistr first;
+        vteunistr last;
+} const warm_up_ranges[] = {
+        { 0x00a0, 0x017f }, /* Latin-1 Supplement, Latin Extended-A */
+        { 0x2010, 0x2027 }, /* General Punctuation */
+        { 0x2190, 0x21ff }, /* Arrows */
+        { 0x2300, 0x23ff }, /* Miscellaneous Technical */
+        { 0x25a0, 0x25ff }, /* Geometric Shapes */
+        { 0x2600, 0x26ff }, /* Miscellaneous Symbols */
+        { 0x2700, 0x27bf }, /* Dingbats */
+        { 0x3000, 0x30ff }, /* CJK Symbols and Punctuation, Hiragana, Katakana */
+        { 0xe0a0, 0xe0d7 }, /* Powerline */
+        { 0xff01, 0xff5e }, /* Fullwidth ASCII variants */
+        { 0x1f300, 0x1f64f }, /* Miscellaneous Symbols and Pictographs, Emoticons */
+        { 0x1f680, 0x1f6ff }, /* Transport and Map Symbols */
+        { 0x1f900, 0x1f9ff }, /* Supplemental Symbols and Pictographs */
+};
+
+FontInfo::UnistrInfo*
+FontInfo::UnistrInfoMap::lookup(vteunistr c) noexcept
+{
+        if (m_entries.empty())
+                return nullptr;
+
+        auto const mask = m_entries.size() - 1;
+        for (auto i = bucket(c); ; i = (i + 1) & mask) {
+                auto& entry = m_entries[i];
+                if (!entry.info)
+                        return nullptr;
+                if (entry.c == c) {
+                        entry.referenced = true;
+                        return entry.info.get();
+                }
+        }
+}
+
+FontInfo::UnistrInfo*
+FontInfo::UnistrInfoMap::insert(vteunistr c)
+{
+        /* Keep the load factor at or below 1/2 */
+        if ((m_size + 1) * 2 > m_entries.size())
+                resize(std::max(m_entries.size() * 2, size_t{256}));
+
+        auto const mask = m_entries.size() - 1;
+        auto i = bucket(c);
+        while (m_entries[i].info)
+                i = (i + 1) & mask;
+
+        auto& entry = m_entries[i];
+        entry.c = c;
+        entry.referenced = true;
+        entry.info = std::make_unique<UnistrInfo>();
+
+        ++m_size;
+        if (c >= VTE_UNISTR_START)
+                ++m_n_clusters;
+
+        return entry.info.get();
+}
+
+void
+FontInfo::UnistrInfoMap::resize(size_t capacity)
+{
+        auto entries = std::exchange(m_entries, std::vector<Entry>(capacity));
+        m_shift = 32 - g_bit_nth_msf(capacity, -1);
+        m_size = 0;
+        m_n_clusters = 0;
+
+        auto const mask = capacity - 1;
+        for (auto& old_entry : entries) {
+                if (!old_entry.info)
+                        continue;
+
+                auto i = bucket(old_entry.c);
+                while (m_entries[i].info)
+                        i = (i + 1) & mask;
+
+                m_entries[i] = std::move(old_entry);
+                ++m_size;
+                if (m_entries[i].c >= VTE_UNISTR_START)
+                        ++m_n_clusters;
+        }
+}
+
+/* Evicts up to @n clusters, using the clock algorithm: the hand sweeps
+ * over the table, giving the clusters used since it last passed them
+ * a second chance, and evicting the others.
+ */
+void
+FontInfo::UnistrInfoMap::evict_clusters(size_t n)
+{
+        n = std::min(n, m_n_clusters);
+        if (n == 0)
+                return;
+
+        /* Two sweeps are enough, since the first one clears all the bits */
+        auto const capacity = m_entries.size();
+        auto evicted = size_t{0};
+        for (auto steps = size_t{0}; evicted < n && steps < 2 * capacity; ++steps) {
+                auto& entry = m_entries[m_clock_hand];
+                m_clock_hand = (m_clock_hand + 1) & (capacity - 1);
+
+                if (!entry.info || entry.c < VTE_UNISTR_START)
+                        continue;
+
+                if (entry.referenced) {
+                        entry.referenced = false;
+                        continue;
+                }
+
+                entry = {};
+                ++evicted;
+        }
+
+        /* Linear probing doesn't allow simply clearing entries, so re-insert
+         * the remaining ones.
+         */
+        resize(capacity);
+}
+
 FontInfo::UnistrInfo*
 FontInfo::find_unistr_info(vteunistr c)
 {
 	if (G_LIKELY (c < G_N_ELEMENTS(m_ascii_unistr_info)))
 		return &m_ascii_unistr_info[c];
 
-	if (G_UNLIKELY (m_other_unistr_info == nullptr))
-		m_other_unistr_info = g_hash_table_new_full(nullptr, nullptr, nullptr, (GDestroyNotify)unistr_info_destroy);
-
-	auto uinfo = reinterpret_cast<UnistrInfo*>(g_hash_table_lookup(m_other_unistr_info, GINT_TO_POINTER(c)));
-	if (G_LIKELY (uinfo))
+	if (auto uinfo = m_other_unistr_info.lookup(c); G_LIKELY (uinfo))
 		return uinfo;
 
-	uinfo = new UnistrInfo{};
-	g_hash_table_insert(m_other_unistr_info, GINT_TO_POINTER (c), uinfo);
-	return uinfo;
+	return m_other_unistr_info.insert(c);
+}
+
+void
+FontInfo::trim()
+{
+        auto const n_clusters = m_other_unistr_info.n_clusters();
+        if (G_LIKELY (n_clusters <= max_cached_clusters()))
+                return;
+
+        /* Evict a batch at once, so that this doesn't happen again for
+         * every new cluster.
+         */
+        auto const n = n_clusters - max_cached_clusters() * 3 / 4;
+
+	_vte_debug_print(vte::debug::category::PANGOCAIRO,
+                         "vtepangocairo: {} evicting {} of {} cached clusters",
+                         (void*)this, n, n_clusters);
+
+        m_other_unistr_info.evict_clusters(n);
+}
+
+/* Shapes the next few characters of the warm-up ranges. Returns
+ * whether there are more to do.
+ */
+bool
+FontInfo::warm_up()
+{
+        auto n = 0;
+        while (m_warm_up_range < G_N_ELEMENTS(warm_up_ranges)) {
+                auto const& range = warm_up_ranges[m_warm_up_range];
+                auto c = std::max(m_warm_up_next, range.first);
+                for ( ; c <= range.last && n < WARM_UP_BATCH_SIZE; ++c) {
+                        if (Minifont::unistr_is_local_graphic(c) ||
+                            g_unichar_type(c) == G_UNICODE_UNASSIGNED)
+                                continue;
+
+                        get_unistr_info(c);
+                        ++n;
+                }
+
+                if (c <= range.last) {
+                        m_warm_up_next = c;
+                        return true;
+                }
+
+                ++m_warm_up_range;
+                m_warm_up_next = 0;
+        }
+
+	_vte_debug_print(vte::debug::category::PANGOCAIRO,
+                         "vtepangocairo: {} warm-up done, {} characters cached",
+                         (void*)this, m_other_unistr_info.size());
+
+        return false;
 }
 
 void
@@ -114,6 +293,8 @@ FontInfo::cache_ascii()
 	if (!scaled_font)
 		return;
 
+	m_ascii_font = vte::glib::make_ref(pango_font);
+
 	for (more = pango_glyph_item_iter_init_start (&iter, glyph_item, text);
 	     more;
 	     more = pango_glyph_item_iter_next_cluster (&iter))
@@ -217,27 +398,13 @@ FontInfo::measure_font()
 	cache_ascii();
 }
 
-FontInfo::FontInfo(vte::glib::RefPtr<PangoContext> context)
+void
+FontInfo::apply_font_metrics(PangoContext* context)
 {
-	_vte_debug_print(vte::debug::category::PANGOCAIRO,
-                         "vtepangocairo: {} allocating FontInfo",
-                         (void*)this);
-
-	m_layout = vte::glib::take_ref(pango_layout_new(context.get()));
-
-	auto tabs = pango_tab_array_new_with_positions(1, FALSE, PANGO_TAB_LEFT, 1);
-	pango_layout_set_tabs(m_layout.get(), tabs);
-	pango_tab_array_free(tabs);
-
-        // FIXME!!!
-	m_string = g_string_sized_new(VTE_UTF8_BPC+1);
-
-        measure_font();
-
 #if PANGO_VERSION_CHECK(1, 44, 0)
         /* Try using the font's metrics; see issue#163. */
         if (auto metrics = vte::take_freeable
-            (pango_context_get_metrics(context.get(),
+            (pango_context_get_metrics(context,
                                        nullptr /* use font from context */,
                                        nullptr /* use language from context */))) {
 		/* Use provided metrics if possible */
@@ -277,6 +444,34 @@ FontInfo::FontInfo(vte::glib::RefPtr<PangoContext> context)
                 }
 	}
 #endif /* pango >= 1.44 */
+}
+
+FontInfo::FontInfo(vte::glib::RefPtr<PangoContext> context)
+{
+	_vte_debug_print(vte::debug::category::PANGOCAIRO,
+                         "vtepangocairo: {} allocating FontInfo",
+                         (void*)this);
+
+	m_layout = vte::glib::take_ref(pango_layout_new(context.get()));
+
+	auto tabs = pango_tab_array_new_with_positions(1, FALSE, PANGO_TAB_LEFT, 1);
+	pango_layout_set_tabs(m_layout.get(), tabs);
+	pango_tab_array_free(tabs);
+
+        // FIXME!!!
+	m_string = g_string_sized_new(VTE_UTF8_BPC+1);
+
+        m_disk_cache_key = disk_cache_key(context.get());
+        if (!load_disk_cache(m_disk_cache_key)) {
+                measure_font();
+                apply_font_metrics(context.get());
+
+                /* Don't delay the first frame by writing the cache file */
+                m_save_disk_cache_source = g_idle_add_full(G_PRIORITY_LOW,
+                                                           (GSourceFunc)save_disk_cache_cb,
+                                                           this,
+                                                           nullptr);
+        }
 
 	_vte_debug_print(vte::debug::category::PANGOCAIRO | vte::debug::category::MISC,
                          "vtepangocairo: {} font metrics = {}x{} ({})",
@@ -289,6 +484,10 @@ FontInfo::FontInfo(vte::glib::RefPtr<PangoContext> context)
                             pango_layout_get_context(m_layout.get()),
                             this);
 
+        m_warm_up_source = g_idle_add_full(G_PRIORITY_LOW,
+                                           (GSourceFunc)warm_up_cb,
+                                           this,
+                                           nullptr);
 }
 
 FontInfo::~FontInfo()
@@ -308,9 +507,10 @@ FontInfo::~FontInfo()
 
 	g_string_free(m_string, true);
 
-	if (m_other_unistr_info) {
-		g_hash_table_destroy(m_other_unistr_info);
-	}
+        if (m_warm_up_source != 0)
+                g_source_remove(m_warm_up_source);
+        if (m_save_disk_cache_source != 0)
+                g_source_remove(m_save_disk_cache_source);
 }
 
 static GQuark
@@ -361,6 +561,173 @@ context_equal (PangoContext *a,
 	    && vte_pango_context_get_fontconfig_timestamp (a) == vte_pango_context_get_fontconfig_timestamp (b);
 }
 
+static vte::glib::StringPtr
+describe_font(PangoFont* font)
+{
+        auto const desc = vte::take_freeable(pango_font_describe_with_absolute_size(font));
+        return vte::glib::take_string(pango_font_description_to_string(desc.get()));
+}
+
+std::string
+FontInfo::disk_cache_key(PangoContext* context)
+{
+        auto const desc = vte::glib::take_string
+                (pango_font_description_to_string(pango_context_get_font_description(context)));
+        auto const language = pango_context_get_language(context);
+
+        return fmt::format("vte {} gtk{} pango {} {}-bit\n"
+                           "font {}\n"
+                           "language {}\n"
+                           "resolution {}\n"
+                           "font-options {}\n"
+                           "fontconfig-timestamp {}\n",
+                           VERSION, VTE_GTK, pango_version_string(), sizeof(void*) * 8,
+                           desc.get(),
+                           language ? pango_language_to_string(language) : "",
+                           pango_cairo_context_get_resolution(context),
+                           cairo_font_options_hash(pango_cairo_context_get_font_options(context)),
+                           vte_pango_context_get_fontconfig_timestamp(context));
+}
+
+bool
+FontInfo::load_disk_cache(std::string const& key)
+{
+        auto const path = font_cache_path(key);
+        auto file = vte::take_freeable(g_mapped_file_new(path.get(), false, nullptr));
+        if (!file)
+                return false;
+
+        auto const cache = parse_font_cache({g_mapped_file_get_contents(file.get()),
+                                             g_mapped_file_get_length(file.get())},
+                                            key,
+                                            G_N_ELEMENTS(m_ascii_unistr_info));
+        if (!cache)
+                return false;
+
+        /* Make sure the font resolves to the same one as when the cache was
+         * written; the fontconfig timestamp in the key may not be reliable.
+         */
+        auto const context = pango_layout_get_context(m_layout.get());
+        auto const font = vte::glib::take_ref
+                (pango_context_load_font(context, pango_context_get_font_description(context)));
+        if (!font)
+                return false;
+
+        if (cache->font != describe_font(font.get()).get())
+                return false;
+
+#if VTE_GTK == 3
+        auto const scaled_font = pango_cairo_font_get_scaled_font((PangoCairoFont*)font.get());
+        if (!cache->glyphs.empty() && !scaled_font)
+                return false;
+#endif
+
+        m_width = cache->width;
+        m_height = cache->height;
+        m_ascent = cache->ascent;
+
+        for (auto const& glyph : cache->glyphs) {
+                if (glyph.c >= G_N_ELEMENTS(m_ascii_unistr_info))
+                        continue;
+
+                auto uinfo = &m_ascii_unistr_info[glyph.c];
+                if (uinfo->coverage() != UnistrInfo::Coverage::UNKNOWN)
+                        continue;
+
+                auto ufi = &uinfo->m_ufi;
+                uinfo->width = glyph.pixel_width;
+                uinfo->has_unknown_chars = false;
+
+#if VTE_GTK == 3
+                uinfo->set_coverage(UnistrInfo::Coverage::USE_CAIRO_GLYPH);
+
+                ufi->using_cairo_glyph.scaled_font = cairo_scaled_font_reference(scaled_font);
+                ufi->using_cairo_glyph.glyph_index = glyph.glyph;
+#elif VTE_GTK == 4
+                uinfo->set_coverage(UnistrInfo::Coverage::USE_PANGO_GLYPH_STRING);
+
+                ufi->using_pango_glyph_string.font = (PangoFont*)g_object_ref(font.get());
+                ufi->using_pango_glyph_string.glyph_string = pango_glyph_string_new();
+                pango_glyph_string_set_size(ufi->using_pango_glyph_string.glyph_string, 1);
+                auto const glyph_info = &ufi->using_pango_glyph_string.glyph_string->glyphs[0];
+                *glyph_info = PangoGlyphInfo{};
+                glyph_info->glyph = glyph.glyph;
+                glyph_info->geometry.width = glyph.width;
+                glyph_info->attr.is_cluster_start = 1;
+                ufi->using_pango_glyph_string.glyph_string->log_clusters[0] = 0;
+#endif
+
+#if VTE_DEBUG
+                m_coverage_count[0]++;
+                m_coverage_count[(unsigned)uinfo->coverage()]++;
+#endif
+        }
+
+        if (!cache->glyphs.empty())
+                m_ascii_font = std::move(font);
+
+	_vte_debug_print(vte::debug::category::PANGOCAIRO,
+                         "vtepangocairo: {} loaded metrics and {} ASCII glyphs from {}",
+                         (void*)this, cache->glyphs.size(), path.get());
+
+        return true;
+}
+
+void
+FontInfo::save_disk_cache()
+{
+        auto const context = pango_layout_get_context(m_layout.get());
+        auto const font = vte::glib::take_ref
+                (pango_context_load_font(context, pango_context_get_font_description(context)));
+        if (!font)
+                return;
+
+        auto cache = FontCache{};
+        cache.width = m_width;
+        cache.height = m_height;
+        cache.ascent = m_ascent;
+        cache.font = describe_font(font.get()).get();
+
+        /* Only store the glyphs if they're from the font that load_disk_cache()
+         * will get, which is almost always the case.
+         */
+        if (m_ascii_font &&
+            cache.font == describe_font(m_ascii_font.get()).get()) {
+                for (auto c = 0u; c < G_N_ELEMENTS(m_ascii_unistr_info); ++c) {
+                        auto const uinfo = &m_ascii_unistr_info[c];
+                        auto const ufi = &uinfo->m_ufi;
+
+                        switch (uinfo->coverage()) {
+#if VTE_GTK == 3
+                        case UnistrInfo::Coverage::USE_CAIRO_GLYPH:
+                                cache.glyphs.emplace_back(c,
+                                                          ufi->using_cairo_glyph.glyph_index,
+                                                          int32_t(uinfo->width * PANGO_SCALE),
+                                                          uint32_t(uinfo->width));
+                                break;
+#elif VTE_GTK == 4
+                        case UnistrInfo::Coverage::USE_PANGO_GLYPH_STRING: {
+                                auto const glyph_info = &ufi->using_pango_glyph_string.glyph_string->glyphs[0];
+                                cache.glyphs.emplace_back(c,
+                                                          glyph_info->glyph,
+                                                          glyph_info->geometry.width,
+                                                          uint32_t(uinfo->width));
+                                break;
+                        }
+#endif
+                        default:
+                                break;
+                        }
+                }
+        }
+
+	_vte_debug_print(vte::debug::category::PANGOCAIRO,
+                         "vtepangocairo: {} saving metrics and {} ASCII glyphs",
+                         (void*)this, cache.glyphs.size());
+
+        save_font_cache_async(m_disk_cache_key, serialize_font_cache(m_disk_cache_key, cache));
+}
+
 // FIXMEchpe return vte::base::RefPtr<FontInfo>
 FontInfo*
 FontInfo::create_for_context(vte::glib::RefPtr<PangoContext> context,
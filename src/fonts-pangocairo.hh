@@ -19,6 +19,9 @@
 #pragma once
 
 #include <cassert>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <glib.h>
 #include <pango/pangocairo.h>
@@ -44,9 +47,11 @@
  *
  *   - A font_info keeps uses unistr_font_info structs that represent all
  *     information needed to quickly draw a single vteunistr.  The font_info
- *     creates those unistr_font_info structs on demand and caches them
- *     indefinitely.  It uses a direct array for the ASCII range and a hash
- *     table for the rest.
+ *     creates those unistr_font_info structs on demand and caches them.
+ *     It uses a direct array for the ASCII range and an open-addressing
+ *     hash table for the rest.  Single characters are cached indefinitely;
+ *     combined characters (grapheme clusters) only up to a limit, see
+ *     below.
  *
  *
  * Fast rendering of unistrs:
@@ -108,6 +113,35 @@
  * letters if we can do that easily using Coverage::USE_CAIRO_GLYPH.  This
  * means that we precache all ASCII letters without any extra pango shaping
  * involved.
+ *
+ *
+ * Sharing the measurements between processes:
+ *
+ * The font metrics and the cached ASCII glyphs are also written to a file
+ * in the user's cache directory, keyed by the font description, language,
+ * resolution, cairo font options and fontconfig timestamp.  Another process
+ * creating a font info struct for the same key maps that file instead of
+ * measuring the font and shaping the ASCII letters again.  The file is
+ * written in a worker thread, from an idle handler, so that it doesn't
+ * delay the first frame; its format is in font-cache.cc.
+ *
+ *
+ * Warming up the cache:
+ *
+ * After creating a font info struct, the characters of some commonly used
+ * blocks (Latin-1, punctuation, arrows, CJK symbols and kana, fullwidth
+ * forms, powerline symbols, emoji) are shaped in an idle handler, a few at
+ * a time, so that their first use doesn't need to shape them.
+ *
+ *
+ * Bounding the cluster cache:
+ *
+ * Combined characters can be created without limit, so once more than
+ * max_cached_clusters() of them are cached, a quarter of them are evicted
+ * again, approximating least recently used order with the clock algorithm.
+ * Since the drawing code keeps pointers to unistr info structs while
+ * drawing a string, this only happens in trim(), which the drawing code
+ * calls before it starts drawing.
  */
 
 namespace vte {
@@ -226,16 +260,14 @@ public:
 
         UnistrInfo *get_unistr_info(vteunistr c);
         inline constexpr int width() const { return m_width; }
+        /* Evicts some of the cached combined characters if there are too
+         * many of them. This invalidates all UnistrInfo pointers obtained before. */
+        void trim();
         inline constexpr int height() const { return m_height; }
         inline constexpr int ascent() const { return m_ascent; }
 
 private:
 
-        static void unistr_info_destroy(UnistrInfo* uinfo)
-        {
-                delete uinfo;
-        }
-
         static gboolean destroy_delayed_cb(void* that)
         {
                 auto info = reinterpret_cast<FontInfo*>(that);
@@ -244,21 +276,99 @@ private:
                 return false;
         }
 
+        static gboolean warm_up_cb(void* that)
+        {
+                auto info = reinterpret_cast<FontInfo*>(that);
+                if (info->warm_up())
+                        return true;
+
+                info->m_warm_up_source = 0;
+                return false;
+        }
+
+        static gboolean save_disk_cache_cb(void* that)
+        {
+                auto info = reinterpret_cast<FontInfo*>(that);
+                info->m_save_disk_cache_source = 0;
+                info->save_disk_cache();
+                return false;
+        }
+
+        static inline constexpr size_t max_cached_clusters() noexcept { return 4096; }
+
+        /* Open-addressing (linear probing) hash map from vteunistr to
+         * UnistrInfo. The UnistrInfo structs are allocated separately so
+         * that pointers to them stay valid when the table grows.
+         */
+        class UnistrInfoMap {
+        public:
+                UnistrInfoMap() noexcept = default;
+                ~UnistrInfoMap() = default;
+
+                UnistrInfoMap(UnistrInfoMap const&) = delete;
+                UnistrInfoMap(UnistrInfoMap&&) = delete;
+                UnistrInfoMap& operator=(UnistrInfoMap const&) = delete;
+                UnistrInfoMap& operator=(UnistrInfoMap&&) = delete;
+
+                /* Also marks @c as used for evict_clusters() */
+                UnistrInfo* lookup(vteunistr c) noexcept;
+                /* @c must not be in the map yet */
+                UnistrInfo* insert(vteunistr c);
+                void evict_clusters(size_t n);
+
+                inline constexpr auto size() const noexcept { return m_size; }
+                inline constexpr auto n_clusters() const noexcept { return m_n_clusters; }
+
+        private:
+                struct Entry {
+                        vteunistr c{0};
+                        bool referenced{false}; /* used since the clock hand last passed */
+                        std::unique_ptr<UnistrInfo> info{};
+                };
+
+                std::vector<Entry> m_entries{};
+                size_t m_size{0};
+                size_t m_n_clusters{0};
+                size_t m_clock_hand{0};
+                unsigned m_shift{32};
+
+                inline size_t bucket(vteunistr c) const noexcept
+                {
+                        /* Fibonacci hashing */
+                        return size_t((uint32_t(c) * 0x9e3779b9u) >> m_shift);
+                }
+
+                void resize(size_t capacity);
+
+        }; // class UnistrInfoMap
+
         mutable int m_ref_count{1};
 
         UnistrInfo* find_unistr_info(vteunistr c);
         void cache_ascii();
         void measure_font();
+        void apply_font_metrics(PangoContext* context);
+        bool load_disk_cache(std::string const& key);
+        void save_disk_cache();
+        static std::string disk_cache_key(PangoContext* context);
+        bool warm_up();
         guint m_destroy_timeout{0}; /* only used when ref_count == 0 */
+        guint m_warm_up_source{0};
+        guint m_save_disk_cache_source{0};
+        std::string m_disk_cache_key{};
+        unsigned m_warm_up_range{0};
+        vteunistr m_warm_up_next{0};
 
 	/* reusable layout set with font and everything set */
         vte::glib::RefPtr<PangoLayout> m_layout{};
 
+        /* the font used by the cached ASCII letters */
+        vte::glib::RefPtr<PangoFont> m_ascii_font{};
+
 	/* cache of character info */
         // FIXME: use std::array<UnistrInfo, 128>
 	UnistrInfo m_ascii_unistr_info[128];
-        // FIXME: use std::unordered_map<vteunistr, UnistrInfo>
-	GHashTable* m_other_unistr_info{nullptr};
+	UnistrInfoMap m_other_unistr_info{};
 
         /* cell metrics as taken from the font, not yet scaled by cell_{width,height}_scale */
 	int m_width{1};
@@ -280,6 +280,7 @@ VTE_DECLARE_FREEABLE(GArray, g_array_unref);
 VTE_DECLARE_FREEABLE(GBytes, g_bytes_unref);
 VTE_DECLARE_FREEABLE(GChecksum, g_checksum_free);
 VTE_DECLARE_FREEABLE(GKeyFile, g_key_file_unref);
+VTE_DECLARE_FREEABLE(GMappedFile, g_mapped_file_unref);
 VTE_DECLARE_FREEABLE(GOptionContext, g_option_context_free);
 VTE_DECLARE_FREEABLE(GString, g_autoptr_cleanup_gstring_free);
 VTE_DECLARE_FREEABLE(GUri, g_uri_unref);
@@ -0,0 +1,380 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "image-file.hh"
+#include "vtedefines.hh"
+
+using namespace std::literals;
+using namespace vte::image;
+
+/* The temporary directory the tests run in */
+static std::string s_tmp_dir{};
+
+static std::string
+encode(std::string_view str)
+{
+        auto encoded = g_base64_encode(reinterpret_cast<guchar const*>(str.data()), str.size());
+        auto rv = std::string{encoded};
+        g_free(encoded);
+        return rv;
+}
+
+static FileRequest
+make_request(std::string_view control,
+             std::string_view path)
+{
+        auto request = parse_file_request(control, encode(path));
+        g_assert_true(request);
+        return *request;
+}
+
+static std::string
+write_file(char const* name,
+           std::string_view data)
+{
+        auto const path = s_tmp_dir + "/" + name;
+        g_assert_true(g_file_set_contents(path.c_str(), data.data(), data.size(), nullptr));
+        return path;
+}
+
+static bool
+exists(std::string const& path)
+{
+        struct stat st;
+        return lstat(path.c_str(), &st) == 0;
+}
+
+static bool
+load(FileRequest const& request,
+     int width,
+     int height)
+{
+        auto const surface = load_file_image(request);
+        if (!surface)
+                return false;
+
+        g_assert_cmpint(cairo_image_surface_get_width(surface.get()), ==, width);
+        g_assert_cmpint(cairo_image_surface_get_height(surface.get()), ==, height);
+        return true;
+}
+
+/* One column of 2 RGBA pixels */
+static constexpr auto const pixels = "\xff\x00\x00\xff\x00\xff\x00\xff"sv;
+
+static void
+test_parse_request(void)
+{
+        auto request = parse_file_request("f=32,s=3,v=2"sv, encode("/tmp/image.rgba"sv));
+        g_assert_true(request);
+        g_assert_true(request->medium == FileRequest::Medium::FILE);
+        g_assert_true(request->format == FileRequest::Format::RGBA);
+        g_assert_cmpuint(request->width, ==, 3);
+        g_assert_cmpuint(request->height, ==, 2);
+        g_assert_cmpuint(request->offset, ==, 0);
+        g_assert_cmpuint(request->size, ==, 0);
+        g_assert_cmpstr(request->path.c_str(), ==, "/tmp/image.rgba");
+
+        request = parse_file_request("a=T,t=s,f=100,O=16,S=1024,q=2"sv, encode("/tty-graphics-protocol-image"sv));
+        g_assert_true(request);
+        g_assert_true(request->medium == FileRequest::Medium::SHARED_MEMORY);
+        g_assert_true(request->format == FileRequest::Format::PNG);
+        g_assert_cmpuint(request->offset, ==, 16);
+        g_assert_cmpuint(request->size, ==, 1024);
+        g_assert_cmpstr(request->path.c_str(), ==, "/tty-graphics-protocol-image");
+
+        request = parse_file_request("t=t,f=24,s=1,v=1"sv, encode("/tmp/tty-graphics-protocol-1"sv));
+        g_assert_true(request);
+        g_assert_true(request->medium == FileRequest::Medium::TEMP_FILE);
+        g_assert_true(request->format == FileRequest::Format::RGB);
+
+        /* Temporary files are checked, and then used, by their canonical path */
+        request = parse_file_request("t=t,f=100"sv, encode("/tmp//./tty-graphics-protocol-1"sv));
+        g_assert_true(request);
+        g_assert_cmpstr(request->path.c_str(), ==, "/tmp/tty-graphics-protocol-1");
+
+        /* The temporary directory is set with a trailing slash */
+        auto const path = s_tmp_dir + "/tty-graphics-protocol-1";
+        request = parse_file_request("t=t,f=100"sv, encode(path));
+        g_assert_true(request);
+        g_assert_cmpstr(request->path.c_str(), ==, path.c_str());
+}
+
+static void
+test_parse_request_invalid(void)
+{
+        auto const path = encode("/tmp/image"sv);
+
+        /* Missing or excessive dimensions */
+        g_assert_false(parse_file_request("f=32"sv, path));
+        g_assert_false(parse_file_request("f=32,s=1"sv, path));
+        g_assert_false(parse_file_request("f=32,s=0,v=1"sv, path));
+        g_assert_false(parse_file_request("f=32,s=1,v=100000"sv, path));
+        g_assert_false(parse_file_request("f=32,s=2048,v=2048"sv, path));
+        g_assert_false(parse_file_request("f=100,S=100000000"sv, path));
+
+        /* Unsupported values */
+        g_assert_false(parse_file_request("t=d,f=100"sv, path));
+        g_assert_false(parse_file_request("f=33,s=1,v=1"sv, path));
+        g_assert_false(parse_file_request("f=100,O=-1"sv, path));
+        g_assert_false(parse_file_request("f=100,S=1x"sv, path));
+        g_assert_false(parse_file_request("f=100,,s=1"sv, path));
+        g_assert_false(parse_file_request("f100"sv, path));
+
+        /* Invalid paths */
+        g_assert_false(parse_file_request("f=100"sv, ""sv));
+        g_assert_false(parse_file_request("f=100"sv, encode("tmp/image"sv)));
+        g_assert_false(parse_file_request("f=100"sv, encode("/tmp/image\0"sv)));
+        g_assert_false(parse_file_request("t=s,f=100"sv, encode("/"sv)));
+        g_assert_false(parse_file_request("t=s,f=100"sv, encode("/dev/shm/tty-graphics-protocol"sv)));
+
+        /* Only files and objects made for the purpose may be deleted */
+        g_assert_false(parse_file_request("t=t,f=100"sv, encode("/tmp/image"sv)));
+        g_assert_false(parse_file_request("t=t,f=100"sv, encode("/etc/tty-graphics-protocol"sv)));
+        g_assert_false(parse_file_request("t=t,f=100"sv, encode("/tmp/../etc/tty-graphics-protocol"sv)));
+        g_assert_false(parse_file_request("t=t,f=100"sv, encode("/tmp/tty-graphics-protocol/.."sv)));
+        g_assert_false(parse_file_request("t=t,f=100"sv, encode("/tmp/dir/tty-graphics-protocol"sv)));
+        g_assert_false(parse_file_request("t=s,f=100"sv, encode("/image"sv)));
+}
+
+static void
+test_convert_pixels(void)
+{
+        uint8_t const rgba[] = {
+                0xff, 0x00, 0x00, 0xff,   0x00, 0xff, 0x00, 0x80,
+                0x00, 0x00, 0xff, 0x00,   0x10, 0x20, 0x30, 0xff,
+        };
+        uint32_t dst[4];
+
+        g_assert_true(convert_pixels(FileRequest::Format::RGBA,
+                                     rgba, sizeof(rgba),
+                                     2, 2,
+                                     reinterpret_cast<uint8_t*>(dst), 2 * sizeof(uint32_t)));
+        g_assert_cmphex(dst[0], ==, 0xffff0000);
+        g_assert_cmphex(dst[1], ==, 0x80008000);
+        g_assert_cmphex(dst[2], ==, 0x00000000);
+        g_assert_cmphex(dst[3], ==, 0xff102030);
+
+        uint8_t const rgb[] = {
+                0x10, 0x20, 0x30,   0x40, 0x50, 0x60,
+        };
+
+        g_assert_true(convert_pixels(FileRequest::Format::RGB,
+                                     rgb, sizeof(rgb),
+                                     1, 2,
+                                     reinterpret_cast<uint8_t*>(dst), sizeof(uint32_t)));
+        g_assert_cmphex(dst[0], ==, 0xff102030);
+        g_assert_cmphex(dst[1], ==, 0xff405060);
+
+        /* Too little data */
+        g_assert_false(convert_pixels(FileRequest::Format::RGBA,
+                                      rgba, sizeof(rgba) - 1,
+                                      2, 2,
+                                      reinterpret_cast<uint8_t*>(dst), 2 * sizeof(uint32_t)));
+        g_assert_false(convert_pixels(FileRequest::Format::RGB,
+                                      rgb, sizeof(rgb),
+                                      2, 2,
+                                      reinterpret_cast<uint8_t*>(dst), 2 * sizeof(uint32_t)));
+}
+
+static void
+test_load_file(void)
+{
+        auto const path = write_file("image", pixels);
+        g_assert_true(load(make_request("f=32,s=1,v=2"sv, path), 1, 2));
+
+        /* Files are not deleted */
+        g_assert_true(exists(path));
+
+        g_unlink(path.c_str());
+}
+
+static void
+test_load_file_range(void)
+{
+        auto const path = write_file("image", "head"s + std::string{pixels} + "tail"s);
+
+        g_assert_true(load(make_request("f=32,s=1,v=2,O=4,S=8"sv, path), 1, 2));
+        g_assert_true(load(make_request("f=32,s=1,v=2,O=4"sv, path), 1, 2));
+        g_assert_true(load(make_request("f=32,s=1,v=2,S=16"sv, path), 1, 2));
+
+        /* Out of bounds */
+        g_assert_false(load(make_request("f=32,s=1,v=2,O=16"sv, path), 1, 2));
+        g_assert_false(load(make_request("f=32,s=1,v=2,O=100"sv, path), 1, 2));
+        g_assert_false(load(make_request("f=32,s=1,v=2,S=17"sv, path), 1, 2));
+        g_assert_false(load(make_request("f=32,s=1,v=2,O=12,S=8"sv, path), 1, 2));
+
+        /* Too short for the image */
+        g_assert_false(load(make_request("f=32,s=1,v=2,O=4,S=4"sv, path), 1, 2));
+        g_assert_false(load(make_request("f=32,s=1,v=2,O=12"sv, path), 1, 2));
+
+        g_unlink(path.c_str());
+}
+
+static void
+test_load_temp_file(void)
+{
+        auto const path = write_file("tty-graphics-protocol-1", pixels);
+
+        /* Not deleted when reading fails */
+        g_assert_false(load(make_request("t=t,f=32,s=1,v=2,O=8"sv, path), 1, 2));
+        g_assert_true(exists(path));
+
+        g_assert_true(load(make_request("t=t,f=32,s=1,v=2"sv, s_tmp_dir + "//./tty-graphics-protocol-1"s), 1, 2));
+        g_assert_false(exists(path));
+}
+
+static void
+test_load_symlink(void)
+{
+        auto const target = write_file("image", pixels);
+        auto const link = s_tmp_dir + "/tty-graphics-protocol-link";
+        g_assert_cmpint(symlink(target.c_str(), link.c_str()), ==, 0);
+
+        /* Temporary files must not be symlinks, since they are deleted */
+        g_assert_false(load(make_request("t=t,f=32,s=1,v=2"sv, link), 1, 2));
+        g_assert_true(exists(link));
+        g_assert_true(exists(target));
+
+        /* Files may be */
+        g_assert_true(load(make_request("f=32,s=1,v=2"sv, link), 1, 2));
+
+        g_unlink(link.c_str());
+        g_unlink(target.c_str());
+}
+
+static void
+test_load_special(void)
+{
+        /* Neither FIFOs, nor devices, nor directories are read */
+        auto const fifo = s_tmp_dir + "/tty-graphics-protocol-fifo";
+        g_assert_cmpint(mkfifo(fifo.c_str(), 0600), ==, 0);
+        g_assert_false(load(make_request("f=32,s=1,v=2"sv, fifo), 1, 2));
+        g_assert_false(load(make_request("t=t,f=32,s=1,v=2"sv, fifo), 1, 2));
+        g_assert_true(exists(fifo));
+        g_unlink(fifo.c_str());
+
+        g_assert_false(load(make_request("f=32,s=1,v=2"sv, "/dev/zero"sv), 1, 2));
+        g_assert_false(load(make_request("f=32,s=1,v=2"sv, "/dev/null"sv), 1, 2));
+        g_assert_false(load(make_request("f=32,s=1,v=2"sv, s_tmp_dir), 1, 2));
+
+        /* Files that report a size of 0 */
+        g_assert_false(load(make_request("f=32,s=1,v=2"sv, "/proc/self/environ"sv), 1, 2));
+
+        g_assert_false(load(make_request("f=32,s=1,v=2"sv, s_tmp_dir + "/nonexistent"s), 1, 2));
+}
+
+static void
+test_load_owner(void)
+{
+        /* Only the user's own files are read */
+        struct stat st;
+        if (stat("/etc/passwd", &st) != 0 ||
+            st.st_uid == geteuid() ||
+            !S_ISREG(st.st_mode) ||
+            st.st_size < 8) {
+                g_test_skip("No suitable file owned by another user");
+                return;
+        }
+
+        g_assert_false(load(make_request("f=32,s=1,v=2"sv, "/etc/passwd"sv), 1, 2));
+}
+
+static std::string
+write_png(char const* name,
+          int width,
+          int height)
+{
+        auto const path = s_tmp_dir + "/" + name;
+        auto const surface = vte::take_freeable(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height));
+        g_assert_cmpint(cairo_surface_write_to_png(surface.get(), path.c_str()), ==, CAIRO_STATUS_SUCCESS);
+        return path;
+}
+
+static void
+test_load_png(void)
+{
+        auto path = write_png("image.png", 2, 3);
+        g_assert_true(load(make_request("f=100"sv, path), 2, 3));
+
+        /* The size is checked before decoding */
+        path = write_png("image.png", VTE_SIXEL_MAX_WIDTH + 1, 1);
+        g_assert_false(load(make_request("f=100"sv, path), VTE_SIXEL_MAX_WIDTH + 1, 1));
+        path = write_png("image.png", 1, VTE_SIXEL_MAX_HEIGHT + 1);
+        g_assert_false(load(make_request("f=100"sv, path), 1, VTE_SIXEL_MAX_HEIGHT + 1));
+
+        /* A header claiming a huge image, without the image data */
+        auto header = std::string{"\x89PNG\r\n\x1a\n\0\0\0\x0dIHDR"sv};
+        for (auto value : {100000u, 100000u}) {
+                header.push_back(char(value >> 24));
+                header.push_back(char(value >> 16));
+                header.push_back(char(value >> 8));
+                header.push_back(char(value));
+        }
+        header.append("\x08\x06\0\0\0\0\0\0\0"sv);
+        path = write_file("image.png", header);
+        g_assert_false(load(make_request("f=100"sv, path), 100000, 100000));
+
+        /* Not a PNG */
+        path = write_file("image.png", pixels);
+        g_assert_false(load(make_request("f=100"sv, path), 1, 2));
+
+        g_unlink(path.c_str());
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        /* Run in a private temporary directory. It is given with a trailing
+         * slash, so that the check of temporary file paths has to compare
+         * it canonically. This has to happen before anything asks glib for
+         * the temporary directory.
+         */
+        char tmp_dir[] = "/tmp/vte-image-file-test-XXXXXX";
+        g_assert_nonnull(g_mkdtemp(tmp_dir));
+        s_tmp_dir = tmp_dir;
+        g_setenv("TMPDIR", (s_tmp_dir + "/").c_str(), true);
+
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/image/file/parse", test_parse_request);
+        g_test_add_func("/vte/image/file/parse/invalid", test_parse_request_invalid);
+        g_test_add_func("/vte/image/file/convert", test_convert_pixels);
+        g_test_add_func("/vte/image/file/load", test_load_file);
+        g_test_add_func("/vte/image/file/load/range", test_load_file_range);
+        g_test_add_func("/vte/image/file/load/temp", test_load_temp_file);
+        g_test_add_func("/vte/image/file/load/symlink", test_load_symlink);
+        g_test_add_func("/vte/image/file/load/special", test_load_special);
+        g_test_add_func("/vte/image/file/load/owner", test_load_owner);
+        g_test_add_func("/vte/image/file/load/png", test_load_png);
+
+        auto const rv = g_test_run();
+
+        g_rmdir(tmp_dir);
+        return rv;
+}
@@ -0,0 +1,492 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include "image-file.hh"
+
+#include <charconv>
+#include <cstring>
+
+#include <glib.h>
+
+#include "vtedefines.hh"
+
+#ifdef VTE_COMPILATION
+#include <cerrno>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.hh"
+#include "libc-glue.hh"
+#endif
+
+using namespace std::literals;
+
+namespace vte::image {
+
+/* Temporary files and shared memory objects may only be deleted if they
+ * look like ones made for the purpose, in the same way as the kitty graphics
+ * protocol.
+ */
+static bool
+is_temp_name(std::string_view name) noexcept
+{
+        return name.find("tty-graphics-protocol"sv) != name.npos;
+}
+
+/* Returns @path without repeated and trailing slashes, and without
+ * . and .. components.
+ */
+static std::string
+canonicalize_path(char const* path)
+{
+        auto canonical = g_canonicalize_filename(path, "/");
+        auto rv = std::string{canonical};
+        g_free(canonical);
+        return rv;
+}
+
+/* @path must be canonical */
+static bool
+is_temp_file_path(std::string_view path)
+{
+        auto const slash = path.rfind('/');
+        auto const dir = path.substr(0, slash);
+        auto const name = path.substr(slash + 1);
+
+        return is_temp_name(name) &&
+                (dir == "/tmp"sv || dir == "/dev/shm"sv || dir == canonicalize_path(g_get_tmp_dir()));
+}
+
+template<typename T>
+static std::optional<T>
+parse_number(std::string_view str) noexcept
+{
+        auto value = T{};
+        auto const [ptr, err] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (err != std::errc{} || ptr != str.data() + str.size())
+                return std::nullopt;
+
+        return value;
+}
+
+/*
+ * parse_file_request:
+ * @control: the comma separated key=value pairs
+ * @payload: the base64 encoded path
+ *
+ * Parses the parameters of an OSC 667 image transfer. Unknown keys are
+ * ignored, so that clients can share their code with the kitty graphics
+ * protocol, but unsupported values of known keys are errors.
+ *
+ * Returns: the request, or %std::nullopt if the parameters are invalid
+ */
+std::optional<FileRequest>
+parse_file_request(std::string_view control,
+                   std::string_view payload) noexcept
+try
+{
+        auto request = FileRequest{};
+
+        while (!control.empty()) {
+                auto const comma = control.find(',');
+                auto const pair = control.substr(0, comma);
+                control = comma == control.npos ? ""sv : control.substr(comma + 1);
+
+                if (pair.size() < 3 || pair[1] != '=')
+                        return std::nullopt;
+
+                auto const value = pair.substr(2);
+                switch (pair[0]) {
+                case 't':
+                        if (value == "f"sv)
+                                request.medium = FileRequest::Medium::FILE;
+                        else if (value == "t"sv)
+                                request.medium = FileRequest::Medium::TEMP_FILE;
+                        else if (value == "s"sv)
+                                request.medium = FileRequest::Medium::SHARED_MEMORY;
+                        else
+                                return std::nullopt;
+                        break;
+
+                case 'f': {
+                        auto const format = parse_number<unsigned>(value);
+                        if (!format)
+                                return std::nullopt;
+
+                        switch (*format) {
+                        case unsigned(FileRequest::Format::RGB):
+                        case unsigned(FileRequest::Format::RGBA):
+                        case unsigned(FileRequest::Format::PNG):
+                                request.format = FileRequest::Format(*format);
+                                break;
+                        default:
+                                return std::nullopt;
+                        }
+                        break;
+                }
+
+                case 's':
+                case 'v': {
+                        auto const size = parse_number<unsigned>(value);
+                        if (!size)
+                                return std::nullopt;
+
+                        (pair[0] == 's' ? request.width : request.height) = *size;
+                        break;
+                }
+
+                case 'O':
+                case 'S': {
+                        auto const size = parse_number<size_t>(value);
+                        if (!size)
+                                return std::nullopt;
+
+                        (pair[0] == 'O' ? request.offset : request.size) = *size;
+                        break;
+                }
+
+                default:
+                        break;
+                }
+        }
+
+        if (request.format != FileRequest::Format::PNG &&
+            (request.width == 0 || request.width > VTE_SIXEL_MAX_WIDTH ||
+             request.height == 0 || request.height > VTE_SIXEL_MAX_HEIGHT ||
+             size_t(request.width) * request.height * (request.format == FileRequest::Format::RGBA ? 4 : 3) > VTE_IMAGE_FILE_MAX_SIZE))
+                return std::nullopt;
+
+        if (request.size > VTE_IMAGE_FILE_MAX_SIZE)
+                return std::nullopt;
+
+        // g_base64_decode() needs a NUL terminated string
+        auto const encoded = std::string{payload};
+        auto decoded_len = gsize{0};
+        auto decoded = g_base64_decode(encoded.c_str(), &decoded_len);
+        request.path.assign(reinterpret_cast<char const*>(decoded), decoded_len);
+        g_free(decoded);
+
+        if (request.path.empty() ||
+            request.path.find('\0') != request.path.npos)
+                return std::nullopt;
+
+        // Files are referenced by absolute path, and shared memory objects
+        // by a single slash followed by their name
+        if (request.path[0] != '/')
+                return std::nullopt;
+        switch (request.medium) {
+        case FileRequest::Medium::FILE:
+                break;
+        case FileRequest::Medium::TEMP_FILE:
+                // Check the canonical path, and use it from here on, so that
+                // the file deleted is the one that was checked
+                request.path = canonicalize_path(request.path.c_str());
+                if (!is_temp_file_path(request.path))
+                        return std::nullopt;
+                break;
+        case FileRequest::Medium::SHARED_MEMORY:
+                if (request.path.find('/', 1) != request.path.npos ||
+                    !is_temp_name(std::string_view{request.path}.substr(1)))
+                        return std::nullopt;
+                break;
+        }
+
+        return request;
+}
+catch (...)
+{
+        return std::nullopt;
+}
+
+/*
+ * convert_pixels:
+ * @format: the format of @src, RGB or RGBA
+ * @src: the pixels, 8 bits per component, without row padding
+ * @src_size: the size of @src
+ * @width: the width of the image
+ * @height: the height of the image
+ * @dst: the CAIRO_FORMAT_ARGB32 data to write to
+ * @dst_stride: the stride of @dst
+ *
+ * Converts the pixels to cairo's native endian, premultiplied format.
+ *
+ * Returns: %false if @src is too short for the image
+ */
+bool
+convert_pixels(FileRequest::Format format,
+               uint8_t const* src,
+               size_t src_size,
+               unsigned width,
+               unsigned height,
+               uint8_t* dst,
+               size_t dst_stride) noexcept
+{
+        auto const bpp = format == FileRequest::Format::RGBA ? 4u : 3u;
+        if (format == FileRequest::Format::PNG ||
+            width == 0 ||
+            src_size / bpp / width < height)
+                return false;
+
+        for (auto y = 0u; y < height; ++y) {
+                auto row = reinterpret_cast<uint32_t*>(dst + y * dst_stride);
+                for (auto x = 0u; x < width; ++x, src += bpp) {
+                        auto const a = bpp == 4 ? unsigned(src[3]) : 0xffu;
+                        auto premultiply = [a](unsigned value) constexpr noexcept -> uint32_t
+                        {
+                                return (value * a + 127u) / 255u;
+                        };
+
+                        row[x] = a << 24 | premultiply(src[0]) << 16 | premultiply(src[1]) << 8 | premultiply(src[2]);
+                }
+        }
+
+        return true;
+}
+
+#ifdef VTE_COMPILATION
+
+/* Only regular files (which memfds and shared memory objects are too)
+ * that belong to the user are read; this rules out devices and FIFOs,
+ * and the procfs and sysfs files that report a size of 0.
+ */
+static bool
+is_user_file(struct stat const& st) noexcept
+{
+        return S_ISREG(st.st_mode) &&
+                st.st_uid == geteuid() &&
+                st.st_size > 0;
+}
+
+/* Opens the file of @request for reading, after checking that it is one
+ * that may be read. The check happens before opening it, since merely
+ * opening a device or FIFO can have side effects; and again after, in
+ * case the file was replaced meanwhile.
+ */
+static vte::libc::FD
+open_file(FileRequest const& request,
+          struct stat* st) noexcept
+{
+        auto const& path = request.path;
+
+        auto fd = vte::libc::FD{};
+        switch (request.medium) {
+        case FileRequest::Medium::FILE:
+        case FileRequest::Medium::TEMP_FILE: {
+                auto const nofollow = request.medium == FileRequest::Medium::TEMP_FILE;
+
+                struct stat path_st;
+                if ((nofollow ? lstat(path.c_str(), &path_st) : stat(path.c_str(), &path_st)) != 0 ||
+                    !is_user_file(path_st)) {
+                        errno = EACCES;
+                        return {};
+                }
+
+                fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK | (nofollow ? O_NOFOLLOW : 0));
+                if (!fd)
+                        return {};
+
+                if (fstat(fd.get(), st) != 0 ||
+                    st->st_dev != path_st.st_dev ||
+                    st->st_ino != path_st.st_ino) {
+                        errno = EACCES;
+                        return {};
+                }
+                break;
+        }
+
+        case FileRequest::Medium::SHARED_MEMORY:
+                // Shared memory objects cannot be devices, so there is
+                // nothing to check before opening them
+                fd = shm_open(path.c_str(), O_RDONLY, 0);
+                if (!fd)
+                        return {};
+
+                if (fstat(fd.get(), st) != 0)
+                        return {};
+                break;
+        }
+
+        if (!is_user_file(*st)) {
+                errno = EACCES;
+                return {};
+        }
+
+        return fd;
+}
+
+static std::optional<std::vector<uint8_t>>
+read_file(FileRequest const& request) noexcept
+try
+{
+        auto const& path = request.path;
+
+        struct stat st;
+        auto fd = open_file(request, &st);
+        if (!fd) {
+                auto errsv = vte::libc::ErrnoSaver{};
+                _vte_debug_print(vte::debug::category::IMAGE,
+                                 "Failed to open image file \"{}\": {}",
+                                 path, g_strerror(errsv));
+                return std::nullopt;
+        }
+
+        if (request.offset >= size_t(st.st_size))
+                return std::nullopt;
+
+        auto const available = size_t(st.st_size) - request.offset;
+        auto const size = request.size ? request.size : available;
+        if (size > available || size > VTE_IMAGE_FILE_MAX_SIZE)
+                return std::nullopt;
+
+        auto data = std::vector<uint8_t>(size);
+        for (auto done = size_t{0}; done < size; ) {
+                auto const r = pread(fd.get(), data.data() + done, size - done, off_t(request.offset + done));
+                if (r < 0 && errno == EINTR)
+                        continue;
+                if (r <= 0)
+                        return std::nullopt;
+
+                done += size_t(r);
+        }
+
+        switch (request.medium) {
+        case FileRequest::Medium::FILE:
+                break;
+        case FileRequest::Medium::TEMP_FILE:
+                unlink(path.c_str());
+                break;
+        case FileRequest::Medium::SHARED_MEMORY:
+                shm_unlink(path.c_str());
+                break;
+        }
+
+        return data;
+}
+catch (...)
+{
+        return std::nullopt;
+}
+
+/* Checks the dimensions in the IHDR chunk before decoding, so that
+ * a small file cannot make cairo allocate a huge surface.
+ */
+static bool
+check_png_size(std::vector<uint8_t> const& data) noexcept
+{
+        static constexpr uint8_t const signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n',
+                                                      0, 0, 0, 13, 'I', 'H', 'D', 'R'};
+        if (data.size() < sizeof(signature) + 8 ||
+            std::memcmp(data.data(), signature, sizeof(signature)) != 0)
+                return false;
+
+        auto read_u32 = [&](size_t pos) constexpr noexcept -> uint32_t
+        {
+                return uint32_t(data[pos]) << 24 | uint32_t(data[pos + 1]) << 16 |
+                        uint32_t(data[pos + 2]) << 8 | uint32_t(data[pos + 3]);
+        };
+
+        auto const width = read_u32(sizeof(signature));
+        auto const height = read_u32(sizeof(signature) + 4);
+        return width > 0 && width <= VTE_SIXEL_MAX_WIDTH &&
+                height > 0 && height <= VTE_SIXEL_MAX_HEIGHT;
+}
+
+static vte::Freeable<cairo_surface_t>
+decode_png(std::vector<uint8_t> const& data) noexcept
+{
+        if (!check_png_size(data))
+                return nullptr;
+
+        struct Reader {
+                uint8_t const* pos;
+                size_t remaining;
+        } reader{data.data(), data.size()};
+
+        auto read_func = [](void* closure,
+                            unsigned char* buf,
+                            unsigned int len) noexcept -> cairo_status_t
+        {
+                auto r = static_cast<Reader*>(closure);
+                if (len > r->remaining)
+                        return CAIRO_STATUS_READ_ERROR;
+
+                std::memcpy(buf, r->pos, len);
+                r->pos += len;
+                r->remaining -= len;
+                return CAIRO_STATUS_SUCCESS;
+        };
+
+        auto surface = vte::take_freeable(cairo_image_surface_create_from_png_stream(read_func, &reader));
+        if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+                return nullptr;
+
+        return surface;
+}
+
+static vte::Freeable<cairo_surface_t>
+decode_pixels(FileRequest const& request,
+              std::vector<uint8_t> const& data) noexcept
+{
+        auto surface = vte::take_freeable(cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                                     request.width,
+                                                                     request.height));
+        if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+                return nullptr;
+
+        cairo_surface_flush(surface.get());
+        if (!convert_pixels(request.format,
+                            data.data(),
+                            data.size(),
+                            request.width,
+                            request.height,
+                            cairo_image_surface_get_data(surface.get()),
+                            cairo_image_surface_get_stride(surface.get())))
+                return nullptr;
+
+        cairo_surface_mark_dirty(surface.get());
+        return surface;
+}
+
+/*
+ * load_file_image:
+ * @request: the request
+ *
+ * Reads the image data from the file or shared memory object, and
+ * decodes it directly into a surface.
+ *
+ * Returns: the surface, or %nullptr on failure
+ */
+vte::Freeable<cairo_surface_t>
+load_file_image(FileRequest const& request) noexcept
+{
+        auto const data = read_file(request);
+        if (!data)
+                return nullptr;
+
+        if (request.format == FileRequest::Format::PNG)
+                return decode_png(*data);
+
+        return decode_pixels(request, *data);
+}
+
+#endif /* VTE_COMPILATION */
+
+} // namespace vte::image
@@ -0,0 +1,92 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#ifdef VTE_COMPILATION
+#include <cairo.h>
+#include "cairo-glue.hh"
+#endif
+
+namespace vte::image {
+
+/*
+ * FileRequest:
+ *
+ * An image that a client on the same machine transfers by reference instead
+ * of sending its pixels through the PTY, in an OSC 667 sequence:
+ *
+ *   OSC 667 ; key=value[,key=value...] ; base64 encoded path ST
+ *
+ * The keys are modelled on the kitty graphics protocol's transmission keys:
+ *
+ *   t: the medium; 'f' for a file (also a memfd, passed as /proc/PID/fd/FD),
+ *      't' for a temporary file that is deleted after reading, and 's'
+ *      for a POSIX shared memory object that is unlinked after reading.
+ *      As in the kitty graphics protocol, the names of temporary files and
+ *      shared memory objects must contain "tty-graphics-protocol", and
+ *      temporary files must be in the temporary directory.
+ *   f: the format; 24 for RGB, 32 for RGBA (the default), or 100 for PNG
+ *   s, v: the width and height in pixels, required for the RGB(A) formats
+ *   O, S: the offset and size of the data in the file; S=0 reads to the end
+ *
+ * The data may be at most VTE_IMAGE_FILE_MAX_SIZE bytes.
+ */
+struct FileRequest {
+        enum class Medium {
+                FILE,
+                TEMP_FILE,
+                SHARED_MEMORY,
+        };
+
+        enum class Format {
+                RGB = 24,
+                RGBA = 32,
+                PNG = 100,
+        };
+
+        Medium medium{Medium::FILE};
+        Format format{Format::RGBA};
+        unsigned width{0};
+        unsigned height{0};
+        size_t offset{0};
+        size_t size{0};
+        std::string path{};
+};
+
+std::optional<FileRequest> parse_file_request(std::string_view control,
+                                              std::string_view payload) noexcept;
+
+bool convert_pixels(FileRequest::Format format,
+                    uint8_t const* src,
+                    size_t src_size,
+                    unsigned width,
+                    unsigned height,
+                    uint8_t* dst,
+                    size_t dst_stride) noexcept;
+
+#ifdef VTE_COMPILATION
+
+vte::Freeable<cairo_surface_t> load_file_image(FileRequest const& request) noexcept;
+
+#endif /* VTE_COMPILATION */
+
+} // namespace vte::image
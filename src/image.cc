@@ -20,6 +20,9 @@
 
 #include <glib.h>
 #include <stdio.h>
+
+#include <cmath>
+
 #include "vteinternal.hh"
 
 #include "image.hh"
@@ -28,14 +31,59 @@ namespace vte {
 
 namespace image {
 
-/* Paint the image with provided cairo context */
+/* Returns a new surface with the image scaled from the cell dimensions at
+ * time of image creation to @cell_width x @cell_height, or %nullptr on
+ * failure. See Ring::scaled_image_surface() for the cached one.
+ */
+vte::Freeable<cairo_surface_t>
+Image::create_scaled_surface(int cell_width,
+                             int cell_height) const noexcept
+{
+        if (is_spilled())
+                return nullptr;
+
+        auto const scale_x = cell_width / (double) m_cell_width;
+        auto const scale_y = cell_height / (double) m_cell_height;
+        auto const width = int(std::ceil(m_width_pixels * scale_x));
+        auto const height = int(std::ceil(m_height_pixels * scale_y));
+        if (width <= 0 || height <= 0)
+                return nullptr;
+
+        auto surface = vte::take_freeable(cairo_surface_create_similar_image(m_surface.get(),
+                                                                             CAIRO_FORMAT_ARGB32,
+                                                                             width,
+                                                                             height));
+        if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+                return nullptr;
+
+        auto cr = vte::take_freeable(cairo_create(surface.get()));
+        cairo_scale(cr.get(), scale_x, scale_y);
+        cairo_set_source_surface(cr.get(), m_surface.get(), 0, 0);
+        cairo_pattern_set_filter(cairo_get_source(cr.get()), CAIRO_FILTER_GOOD);
+        cairo_pattern_set_extend(cairo_get_source(cr.get()), CAIRO_EXTEND_PAD);
+        cairo_set_operator(cr.get(), CAIRO_OPERATOR_SOURCE);
+        cairo_paint(cr.get());
+        if (cairo_status(cr.get()) != CAIRO_STATUS_SUCCESS)
+                return nullptr;
+
+        return surface;
+}
+
+/* Paint the image with provided cairo context. If the cell dimensions
+ * differ from the ones at time of image creation, @scaled_surface is the
+ * image already scaled to them, or %nullptr to scale it while painting.
+ */
 void
 Image::paint(cairo_t* cr,
              int offset_x,
              int offset_y,
              int cell_width,
-             int cell_height) const noexcept
+             int cell_height,
+             cairo_surface_t* scaled_surface) const noexcept
 {
+        if (is_spilled())
+                return;
+
         auto scale_x = 1.0;
         auto scale_y = 1.0;
 
@@ -43,6 +91,19 @@ Image::paint(cairo_t* cr,
         auto real_offset_y = double(offset_y);
 
         if (cell_width != m_cell_width || cell_height != m_cell_height) {
+                if (auto const scaled = scaled_surface) {
+                        cairo_save(cr);
+                        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+                        cairo_rectangle(cr, real_offset_x, real_offset_y,
+                                        cairo_image_surface_get_width(scaled),
+                                        cairo_image_surface_get_height(scaled));
+                        cairo_clip(cr);
+                        cairo_set_source_surface(cr, scaled, real_offset_x, real_offset_y);
+                        cairo_paint(cr);
+                        cairo_restore(cr);
+                        return;
+                }
+
                 scale_x = cell_width / (double) m_cell_width;
                 scale_y = cell_height / (double) m_cell_height;
 
@@ -21,15 +21,40 @@
 #include <pango/pangocairo.h>
 #include "cairo-glue.hh"
 
+#include <array>
+#include <cstdint>
+#include <optional>
+
 namespace vte {
 
 namespace image {
 
+/* Identifies an image by its contents, so that identical images can
+ * share one surface; see vte::sixel::Context::image_hash().
+ */
+struct ContentKey {
+        std::array<uint64_t, 2> hash{};
+        int width{0};
+        int height{0};
+
+        constexpr bool operator==(ContentKey const&) const noexcept = default;
+
+        struct Hash {
+                inline constexpr size_t operator()(ContentKey const& key) const noexcept
+                {
+                        return size_t(key.hash[0]);
+                }
+        };
+};
+
 class Image {
 private:
         // Image data, device-independent
         vte::Freeable<cairo_surface_t> m_surface{};
 
+        // Content key of the surface if it is shared with other images
+        std::optional<ContentKey> m_key;
+
         // Draw/prune priority, must be unique
         size_t m_priority;
 
@@ -47,6 +72,7 @@ private:
 
 public:
         Image(vte::Freeable<cairo_surface_t> surface,
+              std::optional<ContentKey> const& key,
               size_t priority,
               int width_pixels,
               int height_pixels,
@@ -55,6 +81,7 @@ public:
               int cell_width,
               int cell_height) noexcept
                 : m_surface{std::move(surface)},
+                  m_key{key},
                   m_priority{priority},
                   m_width_pixels{width_pixels},
                   m_height_pixels{height_pixels},
@@ -72,6 +99,16 @@ public:
         Image operator=(Image const&) = delete;
         Image operator=(Image&&) = delete;
 
+        inline constexpr auto const& get_key() const noexcept { return m_key; }
+        inline auto get_surface() const noexcept { return m_surface.get(); }
+
+        /* A spilled image has had its surface written out to the ring's
+         * image stream, and needs to be re-materialized before painting.
+         */
+        inline auto is_spilled() const noexcept { return !m_surface; }
+        inline auto take_surface() noexcept { return std::move(m_surface); }
+        inline void set_surface(vte::Freeable<cairo_surface_t> surface) noexcept { m_surface = std::move(surface); }
+
         inline constexpr auto get_priority() const noexcept { return m_priority; }
         inline constexpr auto get_left() const noexcept { return m_left_cells; }
         inline auto get_top() const noexcept { return m_top_cells; }
@@ -79,6 +116,8 @@ public:
         inline constexpr auto get_width() const noexcept { return (m_width_pixels + m_cell_width - 1) / m_cell_width; }
         inline constexpr auto get_height() const noexcept { return (m_height_pixels + m_cell_height - 1) / m_cell_height; }
         inline auto get_bottom() const noexcept { return m_top_cells + get_height() - 1; }
+        inline constexpr auto get_cell_width() const noexcept { return m_cell_width; }
+        inline constexpr auto get_cell_height() const noexcept { return m_cell_height; }
 
         inline auto resource_size() const noexcept
         {
@@ -89,11 +128,15 @@ public:
                 return m_width_pixels * m_height_pixels * 4;
         }
 
+        vte::Freeable<cairo_surface_t> create_scaled_surface(int cell_width,
+                                                             int cell_height) const noexcept;
+
         void paint(cairo_t* cr,
                    int offset_x,
                    int offset_y,
                    int cell_width,
-                   int cell_height) const noexcept;
+                   int cell_height,
+                   cairo_surface_t* scaled_surface = nullptr) const noexcept;
 
 }; // class Image
 
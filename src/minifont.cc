@@ -195,6 +195,28 @@ create_surface(int width,
         return surface;
 }
 
+#if VTE_GTK == 4
+
+static GdkTexture*
+texture_from_surface(cairo_surface_t* surface)
+{
+        cairo_surface_flush(surface);
+
+        auto const data = cairo_image_surface_get_data(surface);
+        auto const width = cairo_image_surface_get_width(surface);
+        auto const height = cairo_image_surface_get_height(surface);
+        auto const stride = cairo_image_surface_get_stride(surface);
+        auto const bytes = vte::take_freeable(g_bytes_new(data, height * stride));
+        auto const texture = gdk_memory_texture_new(width,
+                                                    height,
+                                                    GDK_MEMORY_A8,
+                                                    bytes.get(),
+                                                    stride);
+        return texture;
+}
+
+#endif // VTE_GTK == 4
+
 #if VTE_GTK == 4 || (VTE_DEBUG && (VERSION_MINOR % 2))
 #define ENABLE_FILL_CHARACTERS
 #define ENABLE_SEPARATED_MOSAICS
@@ -2663,20 +2685,7 @@ MinifontCache::begin_cairo(int x,
 GdkTexture*
 MinifontCache::surface_to_texture(cairo_t *cr) const
 {
-        auto const surface = cairo_get_target(cr);
-        cairo_surface_flush(surface);
-
-        auto const data = cairo_image_surface_get_data(surface);
-        auto const width = cairo_image_surface_get_width(surface);
-        auto const height = cairo_image_surface_get_height(surface);
-        auto const stride = cairo_image_surface_get_stride(surface);
-        auto const bytes = vte::take_freeable(g_bytes_new(data, height * stride));
-        auto const texture = gdk_memory_texture_new(width,
-                                                    height,
-                                                    GDK_MEMORY_A8,
-                                                    bytes.get(),
-                                                    stride);
-        return texture;
+        return texture_from_surface(cairo_get_target(cr));
 }
 #endif // VTE_GTK == 4
 
@@ -2755,6 +2764,161 @@ MinifontCache::draw_graphic(DrawingContext const& context,
         cached_minifont_draw(mf, context, x, y, width, height, fg);
 }
 
+// MinifontAtlas
+
+// The blocks containing local graphics, most commonly used first, since
+// with large cells not all of them may fit into the atlas.
+static constexpr struct {
+        vteunistr first;
+        vteunistr last;
+} const atlas_blocks[] = {
+        { 0x2500, 0x25ff }, // Box Drawing, Block Elements, Geometric Shapes
+        { 0x2300, 0x23ff }, // Miscellaneous Technical
+        { 0x1fb00, 0x1fbff }, // Symbols for Legacy Computing
+        { 0x1cc00, 0x1ceff }, // Symbols for Legacy Computing Supplement
+};
+
+// Space between the glyphs so that they never bleed into each other
+// when the renderer samples the texture.
+#define MINIFONT_ATLAS_GUTTER 1
+
+void
+MinifontAtlas::reset() noexcept
+{
+        m_chars.clear();
+        m_columns = m_slot_width = m_slot_height = 0;
+        m_width = m_height = 0;
+        m_cell_width = m_cell_height = 0;
+        m_font_width = m_font_height = 0;
+        m_scale_factor = 0;
+#if VTE_GTK == 3
+        m_surface.reset();
+#elif VTE_GTK == 4
+        m_texture.reset();
+#endif
+}
+
+void
+MinifontAtlas::update(int cell_width,
+                      int cell_height,
+                      int font_width,
+                      int font_height,
+                      int scale_factor)
+{
+        if (cell_width == m_cell_width &&
+            cell_height == m_cell_height &&
+            font_width == m_font_width &&
+            font_height == m_font_height &&
+            scale_factor == m_scale_factor) [[likely]]
+                return;
+
+        reset();
+
+        m_cell_width = cell_width;
+        m_cell_height = cell_height;
+        m_font_width = font_width;
+        m_font_height = font_height;
+        m_scale_factor = scale_factor;
+
+        if (cell_width < 1 || cell_height < 1 || scale_factor < 1)
+                return;
+
+        m_slot_width = cell_width + MINIFONT_ATLAS_GUTTER;
+        m_slot_height = cell_height + MINIFONT_ATLAS_GUTTER;
+
+        auto const slot_size = size_t(m_slot_width * scale_factor) * size_t(m_slot_height * scale_factor);
+        auto const max_chars = max_size() / slot_size;
+
+        for (auto const& block : atlas_blocks) {
+                for (auto c = block.first; c <= block.last && m_chars.size() < max_chars; ++c) {
+                        if (!unistr_is_local_graphic(c))
+                                continue;
+
+                        switch (c) {
+                        case 0x1fb95 ... 0x1fb99:
+                        case 0x1cc40 ... 0x1cc47:
+                                // These patterns depend on the cell position,
+                                // see MinifontCache::draw_graphic().
+                                continue;
+                        default:
+                                break;
+                        }
+
+                        // Skip the characters that draw outside their cell
+                        auto xpad = 0, ypad = 0;
+                        get_char_padding(c, font_width, font_height, xpad, ypad);
+                        if (xpad != 0 || ypad != 0)
+                                continue;
+
+                        m_chars.push_back(c);
+                }
+        }
+
+        if (m_chars.empty())
+                return;
+
+        std::sort(m_chars.begin(), m_chars.end());
+
+        // Lay the slots out in a roughly square grid
+        auto const n_chars = int(m_chars.size());
+        m_columns = std::max(int(std::ceil(std::sqrt(double(n_chars) * m_slot_height / m_slot_width))), 1);
+        auto const rows = (n_chars + m_columns - 1) / m_columns;
+        m_width = m_columns * m_slot_width;
+        m_height = rows * m_slot_height;
+
+        auto const surface = vte::take_freeable(create_surface(m_width, m_height, 0, 0, scale_factor));
+        auto const cr = vte::take_freeable(cairo_create(surface.get()));
+        auto const white = vte::color::rgb{0xffff, 0xffff, 0xffff};
+        cairo_set_source_rgba(cr.get(), 1, 1, 1, 1);
+
+        for (auto i = 0; i < n_chars; ++i) {
+                auto const x = (i % m_columns) * m_slot_width;
+                auto const y = (i / m_columns) * m_slot_height;
+
+                // Draw each glyph at the origin, like the cache does,
+                // since some of them (e.g. the separated mosaics) mask
+                // with patterns that are anchored at the origin.
+                cairo_save(cr.get());
+                cairo_translate(cr.get(), x, y);
+                cairo_rectangle(cr.get(), 0, 0, cell_width, cell_height);
+                cairo_clip(cr.get());
+                Minifont::draw_graphic(cr.get(),
+                                       m_chars[i],
+                                       &white,
+                                       cell_width,
+                                       cell_height,
+                                       0,
+                                       0,
+                                       font_width,
+                                       1,
+                                       font_height,
+                                       scale_factor);
+                cairo_restore(cr.get());
+        }
+
+#if VTE_GTK == 3
+        cairo_surface_flush(surface.get());
+        m_surface = vte::take_freeable(cairo_surface_reference(surface.get()));
+#elif VTE_GTK == 4
+        m_texture = vte::glib::take_ref(texture_from_surface(surface.get()));
+#endif
+}
+
+bool
+MinifontAtlas::lookup(vteunistr c,
+                      int& x,
+                      int& y) const noexcept
+{
+        auto const it = std::lower_bound(m_chars.begin(), m_chars.end(), c);
+        if (it == m_chars.end() || *it != c)
+                return false;
+
+        auto const i = int(it - m_chars.begin());
+        x = (i % m_columns) * m_slot_width;
+        y = (i / m_columns) * m_slot_height;
+        return true;
+}
+
 #endif // !MINIFONT_COVERAGE
 
 // MinifontGsk
@@ -19,13 +19,18 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 #include "fwd.hh"
 #include "vtetypes.hh"
 #include "vteunistr.h"
 
 #include "cairo-glue.hh"
-#include "drawing-context.hh"
+
+#if VTE_GTK == 4
+#include <gdk/gdk.h>
+#include "refptr.hh"
+#endif
 
 namespace vte {
 namespace view {
@@ -97,6 +102,76 @@ private:
 
 }; // class MinifontCache
 
+/*
+ * MinifontAtlas:
+ *
+ * Keeps the local graphics that don't depend on their position, pre-rendered
+ * for the current cell size into a single alpha-only surface (texture on gtk4),
+ * so that drawing them is just a blit of a part of that surface.
+ *
+ * The atlas is rebuilt when the cell size or scale factor changes, which in
+ * practice means when the font changes.
+ */
+class MinifontAtlas : private Minifont {
+public:
+
+        /* Re-renders the atlas if any of the parameters changed */
+        void update(int cell_width,
+                    int cell_height,
+                    int font_width,
+                    int font_height,
+                    int scale_factor);
+
+        void reset() noexcept;
+
+        /* Looks up the position of @c's single-column glyph in the atlas.
+         * Returns false if the character is not in the atlas.
+         */
+        bool lookup(vteunistr c,
+                    int& x,
+                    int& y) const noexcept;
+
+        inline constexpr auto width() const noexcept { return m_width; }
+        inline constexpr auto height() const noexcept { return m_height; }
+
+#if VTE_GTK == 3
+        inline auto surface() const noexcept { return m_surface.get(); }
+#elif VTE_GTK == 4
+        inline auto texture() const noexcept { return m_texture.get(); }
+#endif
+
+        /* Upper limit on the atlas size in bytes; if all local graphics
+         * don't fit, the less commonly used ones are left out.
+         */
+        static inline constexpr size_t max_size() noexcept { return 4 * 1024 * 1024; }
+
+private:
+
+        /* The characters in the atlas, sorted; the glyph of the character
+         * at index i is at slot i.
+         */
+        std::vector<vteunistr> m_chars{};
+        int m_columns{0};
+        int m_slot_width{0};
+        int m_slot_height{0};
+
+        int m_width{0};
+        int m_height{0};
+
+        int m_cell_width{0};
+        int m_cell_height{0};
+        int m_font_width{0};
+        int m_font_height{0};
+        int m_scale_factor{0};
+
+#if VTE_GTK == 3
+        vte::Freeable<cairo_surface_t> m_surface{};
+#elif VTE_GTK == 4
+        vte::glib::RefPtr<GdkTexture> m_texture{};
+#endif
+
+}; // class MinifontAtlas
+
 #if VTE_GTK == 4
 
 class MinifontGsk : private MinifontCache {
@@ -66,6 +66,7 @@ _VTE_OSC(VTECWF, 6)
 _VTE_OSC(VTECWD, 7)
 _VTE_OSC(VTEHYPER, 8)
 _VTE_OSC(VTE_TERMPROP, 666)
+_VTE_OSC(VTE_IMAGE_FILE, 667)
 _VTE_OSC(VTE_SYSTEMD, 3008)
 
 _VTE_OSC(XTERM_SET_WINDOW_AND_ICON_TITLE, 0)
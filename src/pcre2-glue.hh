@@ -33,6 +33,7 @@ namespace vte {
 
 VTE_DECLARE_FREEABLE(pcre2_code_8, pcre2_code_free_8);
 VTE_DECLARE_FREEABLE(pcre2_compile_context_8, pcre2_compile_context_free_8);
+VTE_DECLARE_FREEABLE(pcre2_jit_stack_8, pcre2_jit_stack_free_8);
 VTE_DECLARE_FREEABLE(pcre2_match_context_8, pcre2_match_context_free_8);
 VTE_DECLARE_FREEABLE(pcre2_match_data_8, pcre2_match_data_free_8);
 
@@ -30,6 +30,10 @@ namespace vte {
 
 namespace base {
 
+/* JIT stack sizes for matching, see Regex::jit_stack() */
+static constexpr auto const k_jit_stack_start_size = size_t{32 * 1024};
+static constexpr auto const k_jit_stack_max_size = size_t{512 * 1024};
+
 static bool
 set_gerror_from_pcre_error(int errcode,
                            GError **error)
@@ -169,6 +173,30 @@ Regex::jited() const noexcept
         return r == 0 && s != 0;
 }
 
+/*
+ * Regex::jit_stack:
+ *
+ * Returns the JIT stack to use when matching this regex, creating it
+ * on first use. The default JIT stack that PCRE2 uses when none is
+ * assigned to the match context is only 32KiB and lives on the machine
+ * stack, which is too small for some of the URL-matching patterns; so
+ * each JITed regex gets its own heap-allocated stack, which then is
+ * reused for all matches.
+ *
+ * Returns: the JIT stack, or %nullptr if the regex is not JITed or
+ *   the stack could not be allocated
+ */
+pcre2_jit_stack_8*
+Regex::jit_stack() const noexcept
+{
+        if (!m_jit_stack && jited())
+                m_jit_stack = vte::take_freeable(pcre2_jit_stack_create_8(k_jit_stack_start_size,
+                                                                          k_jit_stack_max_size,
+                                                                          nullptr /* general context */));
+
+        return m_jit_stack.get();
+}
+
 /*
  * Regex::has_compile_flags:
  * @flags:
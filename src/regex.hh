@@ -52,6 +52,9 @@ private:
 
         vte::Freeable<pcre2_code_8> m_code{};
 
+        /* Created on first use, see jit_stack() */
+        mutable vte::Freeable<pcre2_jit_stack_8> m_jit_stack{};
+
         Purpose m_purpose;
 
 public:
@@ -78,6 +81,8 @@ public:
 
         bool jited() const noexcept;
 
+        pcre2_jit_stack_8* jit_stack() const noexcept;
+
         std::optional<std::string> substitute(std::string_view const& subject,
                                               std::string_view const& replacement,
                                               uint32_t flags,
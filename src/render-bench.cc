@@ -0,0 +1,364 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * render-bench: Renders the terminal into an image surface, without
+ * showing any window, for reproducible rendering measurements.
+ *
+ * Each fixture is fed to a fresh terminal in an offscreen window; files
+ * ending in .sh are run with bash and their output is fed instead. Then
+ * the terminal is drawn --frames times into an image surface, and the
+ * draw times are printed. The last frame can be written to a PNG file,
+ * and compared to a golden image.
+ *
+ * This still needs a display connection for gtk, but no GPU and no
+ * visible window; run it under Xvfb or with GDK_BACKEND=broadway on a
+ * headless machine.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <locale.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtk/gtk.h>
+#include <vte/vte.h>
+
+#include "cairo-glue.hh"
+#include "fmt-glue.hh"
+#include "glib-glue.hh"
+#include "pango-glue.hh"
+#include "std-glue.hh"
+
+/* Exit status that tells meson the test was skipped */
+#define EXIT_SKIP 77
+
+/* How long the terminal must not have changed before the
+ * fed data is considered to have been processed completely.
+ */
+#define QUIESCENT_TIME_MS 100
+
+class Options {
+private:
+        int m_columns{80};
+        int m_rows{24};
+        int m_frames{10};
+        vte::glib::StringPtr m_font{};
+        vte::glib::StringPtr m_output_dir{};
+        vte::glib::StringPtr m_golden_dir{};
+        vte::glib::StrvPtr m_filenames{};
+
+public:
+
+        Options() noexcept = default;
+        Options(Options const&) = delete;
+        Options(Options&&) = delete;
+
+        ~Options() = default;
+
+        inline constexpr int columns() const noexcept { return m_columns; }
+        inline constexpr int rows()    const noexcept { return m_rows;    }
+        inline constexpr int frames()  const noexcept { return m_frames;  }
+        inline char const* font()       const noexcept { return m_font ? m_font.get() : "Monospace 12"; }
+        inline char const* output_dir() const noexcept { return m_output_dir.get(); }
+        inline char const* golden_dir() const noexcept { return m_golden_dir.get(); }
+        inline char const* const* filenames() const noexcept { return m_filenames.get(); }
+
+        bool parse(int argc,
+                   char* argv[],
+                   GError** error) noexcept
+        {
+                using IntOption = vte::ValueGetter<int, int>;
+                using StringOption = vte::ValueGetter<vte::glib::StringPtr, char*, nullptr>;
+                using StrvOption = vte::ValueGetter<vte::glib::StrvPtr, char**, nullptr>;
+
+                auto columns = IntOption{m_columns, 80};
+                auto rows = IntOption{m_rows, 24};
+                auto frames = IntOption{m_frames, 10};
+                auto font = StringOption{m_font, nullptr};
+                auto output_dir = StringOption{m_output_dir, nullptr};
+                auto golden_dir = StringOption{m_golden_dir, nullptr};
+                auto filenames = StrvOption{m_filenames, nullptr};
+
+                GOptionEntry const entries[] = {
+                        { "columns", 'c', 0, G_OPTION_ARG_INT, &columns,
+                          "Number of columns", "COLUMNS" },
+                        { "font", 'f', 0, G_OPTION_ARG_STRING, &font,
+                          "Font to use", "FONT" },
+                        { "frames", 'n', 0, G_OPTION_ARG_INT, &frames,
+                          "Number of frames to draw for each fixture", "COUNT" },
+                        { "golden-dir", 'g', 0, G_OPTION_ARG_FILENAME, &golden_dir,
+                          "Compare the rendering against the PNG images in DIR", "DIR" },
+                        { "output-dir", 'o', 0, G_OPTION_ARG_FILENAME, &output_dir,
+                          "Write the rendering as PNG images to DIR", "DIR" },
+                        { "rows", 'r', 0, G_OPTION_ARG_INT, &rows,
+                          "Number of rows", "ROWS" },
+                        { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames,
+                          nullptr, nullptr },
+                        { nullptr },
+                };
+
+                auto context = vte::take_freeable(g_option_context_new("FIXTURE… — render benchmark"));
+                g_option_context_set_help_enabled(context.get(), true);
+                g_option_context_add_main_entries(context.get(), entries, nullptr);
+
+                return g_option_context_parse(context.get(), &argc, &argv, error);
+        }
+}; // class Options
+
+/* Reads the fixture, or runs it if it's a script, and converts
+ * the line endings like the pty would.
+ */
+static bool
+load_fixture(char const* filename,
+             std::string& data,
+             GError** error)
+{
+        auto contents = vte::glib::StringPtr{};
+        auto length = size_t{0};
+
+        if (g_str_has_suffix(filename, ".sh")) {
+                auto const dir = vte::glib::take_string(g_path_get_dirname(filename));
+                char const* argv[] = {"bash", filename, nullptr};
+                char* out = nullptr;
+                auto status = 0;
+                if (!g_spawn_sync(dir.get(),
+                                  const_cast<char**>(argv),
+                                  nullptr,
+                                  GSpawnFlags(G_SPAWN_SEARCH_PATH |
+                                              G_SPAWN_STDIN_FROM_DEV_NULL |
+                                              G_SPAWN_STDERR_TO_DEV_NULL),
+                                  nullptr, nullptr,
+                                  &out, nullptr,
+                                  &status,
+                                  error))
+                        return false;
+
+                contents = vte::glib::take_string(out);
+                length = strlen(out);
+        } else {
+                char* out = nullptr;
+                if (!g_file_get_contents(filename, &out, &length, error))
+                        return false;
+
+                contents = vte::glib::take_string(out);
+        }
+
+        data.clear();
+        data.reserve(length + length / 16);
+        auto const view = std::string_view{contents.get(), length};
+        for (auto const c : view) {
+                if (c == '\n')
+                        data.push_back('\r');
+                data.push_back(c);
+        }
+
+        return true;
+}
+
+static void
+contents_changed_cb(VteTerminal* terminal,
+                    int64_t* last_change)
+{
+        *last_change = g_get_monotonic_time();
+}
+
+/* Runs the main loop until the terminal has processed all the fed data */
+static void
+wait_for_processing(VteTerminal* terminal)
+{
+        auto last_change = g_get_monotonic_time();
+        auto const id = g_signal_connect(terminal, "contents-changed",
+                                         G_CALLBACK(contents_changed_cb), &last_change);
+
+        while (g_get_monotonic_time() - last_change < QUIESCENT_TIME_MS * 1000) {
+                while (g_main_context_pending(nullptr))
+                        g_main_context_iteration(nullptr, false);
+                g_usleep(1000);
+        }
+
+        g_signal_handler_disconnect(terminal, id);
+}
+
+static bool
+compare_to_golden(cairo_surface_t* surface,
+                  char const* golden_path)
+{
+        auto const golden = vte::take_freeable(cairo_image_surface_create_from_png(golden_path));
+        if (cairo_surface_status(golden.get()) != CAIRO_STATUS_SUCCESS) {
+                fmt::println(stderr, "Failed to load golden image {}", golden_path);
+                return false;
+        }
+
+        auto const width = cairo_image_surface_get_width(surface);
+        auto const height = cairo_image_surface_get_height(surface);
+        if (cairo_image_surface_get_width(golden.get()) != width ||
+            cairo_image_surface_get_height(golden.get()) != height ||
+            cairo_image_surface_get_format(golden.get()) != cairo_image_surface_get_format(surface)) {
+                fmt::println(stderr, "Size or format differs from golden image {}", golden_path);
+                return false;
+        }
+
+        cairo_surface_flush(surface);
+
+        auto const stride = cairo_image_surface_get_stride(surface);
+        auto const golden_stride = cairo_image_surface_get_stride(golden.get());
+        auto const data = cairo_image_surface_get_data(surface);
+        auto const golden_data = cairo_image_surface_get_data(golden.get());
+        auto n_differing = 0;
+        for (auto y = 0; y < height; ++y) {
+                auto const row = reinterpret_cast<uint32_t const*>(data + y * stride);
+                auto const golden_row = reinterpret_cast<uint32_t const*>(golden_data + y * golden_stride);
+                for (auto x = 0; x < width; ++x)
+                        n_differing += row[x] != golden_row[x];
+        }
+
+        if (n_differing != 0) {
+                fmt::println(stderr, "{} pixels differ from golden image {}", n_differing, golden_path);
+                return false;
+        }
+
+        return true;
+}
+
+static bool
+process_fixture(Options const& options,
+                char const* filename)
+{
+        auto error = vte::glib::Error{};
+        auto data = std::string{};
+        if (!load_fixture(filename, data, error)) {
+                fmt::println(stderr, "Failed to load fixture {}: {}", filename, error.message());
+                return false;
+        }
+
+        auto const window = gtk_offscreen_window_new();
+        auto const terminal = VTE_TERMINAL(vte_terminal_new());
+        gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(terminal));
+
+        auto const font_desc = vte::take_freeable(pango_font_description_from_string(options.font()));
+        vte_terminal_set_font(terminal, font_desc.get());
+        vte_terminal_set_size(terminal, options.columns(), options.rows());
+        vte_terminal_set_cursor_blink_mode(terminal, VTE_CURSOR_BLINK_OFF);
+
+        gtk_widget_show_all(window);
+        wait_for_processing(terminal);
+
+        vte_terminal_feed(terminal, data.data(), data.size());
+        wait_for_processing(terminal);
+
+        auto const width = gtk_widget_get_allocated_width(GTK_WIDGET(terminal));
+        auto const height = gtk_widget_get_allocated_height(GTK_WIDGET(terminal));
+        auto const surface = vte::take_freeable(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height));
+
+        auto times = std::vector<int64_t>{};
+        times.reserve(options.frames());
+        for (auto i = 0; i < options.frames(); ++i) {
+                auto const cr = vte::take_freeable(cairo_create(surface.get()));
+                cairo_set_operator(cr.get(), CAIRO_OPERATOR_CLEAR);
+                cairo_paint(cr.get());
+                cairo_set_operator(cr.get(), CAIRO_OPERATOR_OVER);
+
+                auto const start = g_get_monotonic_time();
+                gtk_widget_draw(GTK_WIDGET(terminal), cr.get());
+                cairo_surface_flush(surface.get());
+                times.push_back(g_get_monotonic_time() - start);
+        }
+
+        gtk_widget_destroy(window);
+
+        std::sort(times.begin(), times.end());
+        auto total_time = int64_t{0};
+        for (auto const t : times)
+                total_time += t;
+
+        auto const basename = vte::glib::take_string(g_path_get_basename(filename));
+        fmt::println("{}: {}x{} px, {} frames: best {}µs median {}µs worst {}µs average {}µs",
+                     basename.get(),
+                     width, height,
+                     times.size(),
+                     times.front(),
+                     times[times.size() / 2],
+                     times.back(),
+                     total_time / int64_t(times.size()));
+
+        auto const png_name = fmt::format("{}.png", basename.get());
+        auto rv = true;
+
+        if (options.output_dir()) {
+                g_mkdir_with_parents(options.output_dir(), 0755);
+                auto const path = vte::glib::take_string(g_build_filename(options.output_dir(),
+                                                                          png_name.c_str(),
+                                                                          nullptr));
+                if (cairo_surface_write_to_png(surface.get(), path.get()) != CAIRO_STATUS_SUCCESS) {
+                        fmt::println(stderr, "Failed to write {}", path.get());
+                        rv = false;
+                }
+        }
+
+        if (options.golden_dir()) {
+                auto const path = vte::glib::take_string(g_build_filename(options.golden_dir(),
+                                                                          png_name.c_str(),
+                                                                          nullptr));
+                rv = compare_to_golden(surface.get(), path.get()) && rv;
+        }
+
+        return rv;
+}
+
+int
+main(int argc,
+     char *argv[])
+{
+        setlocale(LC_ALL, "");
+
+        Options options{};
+        auto error = vte::glib::Error{};
+        if (!options.parse(argc, argv, error)) {
+                fmt::println(stderr,
+                             "Failed to parse arguments: {}",
+                             error.message());
+                return EXIT_FAILURE;
+        }
+
+        if (!options.filenames()) {
+                fmt::println(stderr, "No fixtures given");
+                return EXIT_FAILURE;
+        }
+
+        if (options.columns() < 1 || options.rows() < 1 || options.frames() < 1) {
+                fmt::println(stderr, "Columns, rows and frames must be positive");
+                return EXIT_FAILURE;
+        }
+
+        if (!gtk_init_check(nullptr, nullptr)) {
+                fmt::println(stderr, "No display available, skipping");
+                return EXIT_SKIP;
+        }
+
+        auto rv = true;
+        for (auto filename = options.filenames(); *filename; ++filename)
+                rv = process_fixture(options, *filename) && rv;
+
+        return rv ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -19,12 +19,19 @@
 
 #include "config.h"
 
+#include "bidi.hh"
 #include "debug.hh"
 #include "ring.hh"
 #include "vterowdata.hh"
 
 #include <string.h>
 
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
 #if WITH_SIXEL
 
 #include "cxx-utils.hh"
@@ -37,8 +44,20 @@
  * of potential issues related to algorithmic complexity. */
 #define IMAGE_FAST_COUNT_MAX 4096
 
+/* Limits on the images spilled to the image stream. Beyond these, the
+ * oldest images are deleted. */
+#define IMAGE_COUNT_MAX (16 * IMAGE_FAST_COUNT_MAX)
+#define IMAGE_SPILLED_SIZE_MAX (256 * 1024 * 1024)
+
+/* Number of rows per band of the image grid index. */
+#define IMAGE_GRID_ROWS 16
+
 #endif /* WITH_SIXEL */
 
+/* Minimum number of hyperlink idxs to hand out between two GCs triggered by
+ * allocation, see Ring::hyperlink_gc_due(). */
+#define HYPERLINK_GC_MIN_ALLOCATIONS 256
+
 /*
  * Copy the common attributes from VteCellAttr to VteStreamCellAttr or vice versa.
  */
@@ -115,6 +134,11 @@ Ring::~Ring()
 		g_object_unref (m_row_stream);
 	}
 
+#if WITH_SIXEL
+        if (m_image_stream)
+                g_object_unref(m_image_stream);
+#endif
+
 	g_string_free (m_utf8_buffer, TRUE);
 
         for (size_t i = 0; i < m_hyperlinks->len; i++)
@@ -143,6 +167,7 @@ Ring::hyperlink_gc()
                          m_hyperlink_highest_used_idx);
 
         m_hyperlink_maybe_gc_counter = 0;
+        m_hyperlink_allocated_since_gc = 0;
 
         if (m_hyperlink_highest_used_idx == 0) {
                 _vte_debug_print(vte::debug::category::HYPERLINK,
@@ -172,6 +197,7 @@ Ring::hyperlink_gc()
                                          "hyperlink: GC purging link {} to id;uri=\"{}\"",
                                          idx,
                                          hyperlink_get(idx)->str);
+                        m_hyperlink_map.erase(std::string_view{hyperlink_get(idx)->str, hyperlink_get(idx)->len});
                         /* Wipe out the ID and URI itself so it doesn't linger on in the memory for a long time */
                         memset(hyperlink_get(idx)->str, 0, hyperlink_get(idx)->len);
                         g_string_truncate (hyperlink_get(idx), 0);
@@ -182,6 +208,14 @@ Ring::hyperlink_gc()
                m_hyperlink_highest_used_idx--;
         }
 
+        /* Collect the empty entries for reuse, lowest idx last */
+        m_hyperlink_free_idxs.clear();
+        for (idx = m_hyperlinks->len - 1; idx >= 1; idx--) {
+                if (hyperlink_get(idx)->len == 0)
+                        m_hyperlink_free_idxs.push_back(idx);
+        }
+        m_hyperlink_live_after_gc = m_hyperlinks->len - 1 - m_hyperlink_free_idxs.size();
+
         _vte_debug_print(vte::debug::category::HYPERLINK,
                          "hyperlink: GC done (highest used idx is now {})",
                          m_hyperlink_highest_used_idx);
@@ -189,6 +223,24 @@ Ring::hyperlink_gc()
         g_free (used);
 }
 
+/*
+ * Whether a GC should be done before allocating a new idx.
+ *
+ * Scanning the writable region is only worth it once at least as many idxs
+ * have been handed out since the last GC as survived it, so that the cost of
+ * the GC is amortised over the allocations. This keeps programs that emit a
+ * new hyperlink for every line (e.g. "ls --hyperlink") from triggering a full
+ * scan for each of them, while the pool still can't grow to more than about
+ * twice the number of hyperlinks in use.
+ */
+bool
+Ring::hyperlink_gc_due() const noexcept
+{
+        return m_hyperlink_free_idxs.empty() &&
+                m_hyperlink_allocated_since_gc >= std::max(m_hyperlink_live_after_gc,
+                                                           hyperlink_idx_t{HYPERLINK_GC_MIN_ALLOCATIONS});
+}
+
 /*
  * Cumulate the given value, and do a GC when 65536 is reached.
  */
@@ -207,58 +259,353 @@ Ring::hyperlink_maybe_gc(row_t increment)
 
 #if WITH_SIXEL
 
+/* Accounts for the surface of the resident @image. If @image has a content
+ * key, its surface is shared with the other images with that key.
+ */
 void
-Ring::image_gc_region() noexcept
+Ring::retain_image(vte::image::Image const* image) /* throws */
 {
-        cairo_region_t *region = cairo_region_create();
+        ++m_image_fast_count;
 
-        for (auto rit = m_image_map.rbegin();
-             rit != m_image_map.rend();
-             ) {
-                auto const& image = rit->second;
-                auto const rect = cairo_rectangle_int_t{image->get_left(),
-                                                        image->get_top(),
-                                                        image->get_width(),
-                                                        image->get_height()};
+        auto const& key = image->get_key();
+        if (!key) {
+                m_image_fast_memory_used += image->resource_size();
+                return;
+        }
 
-                if (cairo_region_contains_rectangle(region, &rect) == CAIRO_REGION_OVERLAP_IN) {
-                        /* vte::image::Image has been completely overdrawn; delete it */
+        auto [it, inserted] = m_image_store.try_emplace(*key);
+        auto& entry = it->second;
+        if (inserted) {
+                entry.surface = vte::take_freeable(cairo_surface_reference(image->get_surface()));
+                entry.n_images = 0;
+                entry.resource_size = image->resource_size();
+                m_image_fast_memory_used += entry.resource_size;
+        }
 
-                        m_image_fast_memory_used -= image->resource_size();
+        ++entry.n_images;
+}
 
-                        /* Apparently this is the cleanest way to erase() with a reverse iterator... */
-                        /* Unlink the image from m_image_by_top_map, then erase it from m_image_map */
-                        unlink_image_from_top_map(image.get());
-                        rit = image_map_type::reverse_iterator{m_image_map.erase(std::next(rit).base())};
-                        continue;
+/* Accounts for the deletion of @image, dropping its surface from the
+ * store, or its data from the spill store, if no other image uses it.
+ */
+void
+Ring::release_image(vte::image::Image const* image) noexcept
+{
+        auto const& key = image->get_key();
+
+        if (image->is_spilled()) {
+                auto const it = m_image_spill_store.find(*key);
+                if (it == m_image_spill_store.end()) {
+                        /* If this happens, we've miscounted somehow. */
+                        return;
                 }
 
-                cairo_region_union_rectangle(region, &rect);
-                ++rit;
+                if (--it->second.n_images == 0) {
+                        m_image_spilled_size -= it->second.length;
+                        m_image_spill_store.erase(it);
+                        m_image_stream_reclaim = true;
+                }
+
+                return;
+        }
+
+        --m_image_fast_count;
+
+        if (!key) {
+                m_image_fast_memory_used -= image->resource_size();
+                return;
+        }
+
+        auto const it = m_image_store.find(*key);
+        if (it == m_image_store.end()) {
+                /* If this happens, we've miscounted somehow. */
+                return;
+        }
+
+        if (--it->second.n_images == 0) {
+                drop_scaled_surface(it->second);
+                m_image_fast_memory_used -= it->second.resource_size;
+                m_image_store.erase(it);
+        }
+}
+
+/* Frees the scaled surface cached in @entry, if any */
+void
+Ring::drop_scaled_surface(ImageStoreEntry& entry) noexcept
+{
+        m_image_fast_memory_used -= entry.scaled_resource_size;
+        entry.scaled_surface.reset();
+        entry.scaled_resource_size = 0;
+}
+
+/* Deletes the image at @it, and returns the iterator following it */
+Ring::image_map_type::iterator
+Ring::drop_image(image_map_type::iterator it) noexcept
+{
+        auto const& image = it->second;
+        release_image(image.get());
+        unlink_image(image.get());
+        return m_image_map.erase(it);
+}
+
+/* Writes the surface of @image to the image stream and drops it from
+ * memory. Only images with a content key can be spilled.
+ */
+bool
+Ring::spill_image(vte::image::Image* image) noexcept
+try
+{
+        auto const& key = image->get_key();
+        if (!m_has_streams || !key)
+                return false;
+
+        auto [it, inserted] = m_image_spill_store.try_emplace(*key);
+        auto& entry = it->second;
+        if (inserted) {
+                auto data = std::string{};
+                auto const status = cairo_surface_write_to_png_stream
+                        (image->get_surface(),
+                         [](void* closure,
+                            unsigned char const* buf,
+                            unsigned int len) noexcept -> cairo_status_t
+                         {
+                                 try {
+                                         reinterpret_cast<std::string*>(closure)->append(reinterpret_cast<char const*>(buf), len);
+                                         return CAIRO_STATUS_SUCCESS;
+                                 } catch (...) {
+                                         return CAIRO_STATUS_WRITE_ERROR;
+                                 }
+                         },
+                         &data);
+                if (status != CAIRO_STATUS_SUCCESS) {
+                        m_image_spill_store.erase(it);
+                        return false;
+                }
+
+                if (!m_image_stream)
+                        m_image_stream = _vte_file_stream_new();
+
+                entry.offset = _vte_stream_head(m_image_stream);
+                entry.length = data.size();
+                entry.n_images = 0;
+                stream_append(m_image_stream, data.data(), data.size());
+                m_image_spilled_size += data.size();
+        }
+
+        release_image(image);
+        image->take_surface();
+        ++entry.n_images;
+
+        return true;
+}
+catch (...)
+{
+        vte::log_exception();
+        return false;
+}
+
+/* Reads the surface of the spilled @image back from the image stream,
+ * unless an image with the same content key is resident.
+ */
+bool
+Ring::materialize_image(vte::image::Image* image) noexcept
+try
+{
+        if (!image->is_spilled())
+                return true;
+
+        auto const& key = *image->get_key();
+        auto const it = m_image_spill_store.find(key);
+        if (it == m_image_spill_store.end()) {
+                /* If this happens, we've miscounted somehow. */
+                return false;
+        }
+
+        auto surface = lookup_image_surface(key);
+        if (!surface) {
+                auto data = std::string(it->second.length, '\0');
+                if (!stream_read(m_image_stream, it->second.offset, data.data(), data.size()))
+                        return false;
+
+                struct Reader {
+                        std::string_view data;
+                } reader{data};
+
+                surface = vte::take_freeable
+                        (cairo_image_surface_create_from_png_stream
+                         ([](void* closure,
+                             unsigned char* buf,
+                             unsigned int len) noexcept -> cairo_status_t
+                          {
+                                  auto& r = *reinterpret_cast<Reader*>(closure);
+                                  if (len > r.data.size())
+                                          return CAIRO_STATUS_READ_ERROR;
+
+                                  std::memcpy(buf, r.data.data(), len);
+                                  r.data.remove_prefix(len);
+                                  return CAIRO_STATUS_SUCCESS;
+                          },
+                          &reader));
+                if (cairo_surface_status(surface.get()) != CAIRO_STATUS_SUCCESS)
+                        return false;
+        }
+
+        /* Move the image from the spill store to the resident images */
+        release_image(image);
+        image->set_surface(std::move(surface));
+        retain_image(image);
+
+        return true;
+}
+catch (...)
+{
+        vte::log_exception();
+        return false;
+}
+
+/* Discards the image stream data that no spilled image refers to anymore */
+void
+Ring::reclaim_image_stream() noexcept
+{
+        if (!m_image_stream_reclaim || !m_image_stream)
+                return;
+
+        m_image_stream_reclaim = false;
+
+        auto const head = _vte_stream_head(m_image_stream);
+        if (m_image_spill_store.empty()) {
+                _vte_stream_reset(m_image_stream, head);
+                return;
         }
 
-        cairo_region_destroy(region);
+        auto tail = head;
+        for (auto const& [key, entry] : m_image_spill_store)
+                tail = std::min(tail, entry.offset);
+
+        _vte_stream_advance_tail(m_image_stream, tail);
+}
+
+static inline auto
+image_rect(vte::image::Image const* image) noexcept
+{
+        return cairo_rectangle_int_t{image->get_left(),
+                                     image->get_top(),
+                                     image->get_width(),
+                                     image->get_height()};
+}
+
+/* Returns whether @image is completely overdrawn by the newer images */
+bool
+Ring::image_is_overdrawn(vte::image::Image const* image) const /* throws */
+{
+        auto const rect = image_rect(image);
+        auto region = vte::take_freeable(cairo_region_create());
+
+        for (auto const other : images_in_area(image->get_top(),
+                                               image->get_bottom() + 1,
+                                               image->get_left(),
+                                               image->get_left() + image->get_width())) {
+                if (other->get_priority() <= image->get_priority())
+                        continue;
+
+                auto const other_rect = image_rect(other);
+                cairo_region_union_rectangle(region.get(), &other_rect);
+        }
+
+        return cairo_region_contains_rectangle(region.get(), &rect) == CAIRO_REGION_OVERLAP_IN;
+}
+
+/* Deletes the images that the newly added @image has completely overdrawn,
+ * possibly together with other newer images. Only the images that @image
+ * intersects need to be checked, since no image was completely overdrawn
+ * before @image was added.
+ */
+void
+Ring::image_gc_region(vte::image::Image const* image) noexcept
+try
+{
+        for (auto const candidate : images_in_area(image->get_top(),
+                                                   image->get_bottom() + 1,
+                                                   image->get_left(),
+                                                   image->get_left() + image->get_width())) {
+                if (candidate->get_priority() >= image->get_priority() ||
+                    !image_is_overdrawn(candidate))
+                        continue;
+
+                /* vte::image::Image has been completely overdrawn; delete it */
+                if (auto const it = m_image_map.find(candidate->get_priority());
+                    it != m_image_map.end())
+                        drop_image(it);
+        }
+}
+catch (...)
+{
+        vte::log_exception();
 }
 
 void
 Ring::image_gc() noexcept
 {
-        while (m_image_fast_memory_used > IMAGE_FAST_MEMORY_USED_MAX ||
-               m_image_map.size() > IMAGE_FAST_COUNT_MAX) {
+        /* Delete the images that have scrolled out of the ring */
+        for (auto it = m_image_by_top_map.begin();
+             it != m_image_by_top_map.end() && it->first < m_start;
+             ) {
+                auto const image = it->second;
+                ++it;
+
+                if (row_t(image->get_bottom()) >= m_start)
+                        continue;
+
+                if (auto const image_it = m_image_map.find(image->get_priority());
+                    image_it != m_image_map.end())
+                        drop_image(image_it);
+        }
+
+        /* Spill the oldest images to the stream, or delete them if that is not possible */
+        for (auto it = m_image_map.begin();
+             m_image_fast_memory_used > IMAGE_FAST_MEMORY_USED_MAX ||
+                     m_image_fast_count > IMAGE_FAST_COUNT_MAX;
+             ) {
+                if (it == m_image_map.end()) {
+                        /* If this happens, we've miscounted somehow. */
+                        break;
+                }
+
+                if (it->second->is_spilled() || spill_image(it->second.get()))
+                        ++it;
+                else
+                        it = drop_image(it);
+        }
+
+        /* Delete the oldest images, spilled or not, once there are too many */
+        while (m_image_map.size() > IMAGE_COUNT_MAX ||
+               m_image_spilled_size > IMAGE_SPILLED_SIZE_MAX) {
                 if (m_image_map.empty()) {
                         /* If this happens, we've miscounted somehow. */
                         break;
                 }
 
-                auto& image = m_image_map.begin()->second;
-                m_image_fast_memory_used -= image->resource_size();
-                unlink_image_from_top_map(image.get());
-                m_image_map.erase(m_image_map.begin());
+                drop_image(m_image_map.begin());
         }
+
+        reclaim_image_stream();
+}
+
+void
+Ring::link_image(vte::image::Image* image) /* throws */
+{
+        m_image_by_top_map.emplace(std::piecewise_construct,
+                                   std::forward_as_tuple(image->get_top()),
+                                   std::forward_as_tuple(image));
+
+        for (auto band = row_t(image->get_top()) / IMAGE_GRID_ROWS;
+             band <= row_t(image->get_bottom()) / IMAGE_GRID_ROWS;
+             ++band)
+                m_image_grid[band].push_back(image);
 }
 
 void
-Ring::unlink_image_from_top_map(vte::image::Image const* image) noexcept
+Ring::unlink_image(vte::image::Image const* image) noexcept
 {
         auto [begin, end] = m_image_by_top_map.equal_range(image->get_top());
 
@@ -269,21 +616,28 @@ Ring::unlink_image_from_top_map(vte::image::Image const* image) noexcept
                 m_image_by_top_map.erase(it);
                 break;
         }
+
+        for (auto band = row_t(image->get_top()) / IMAGE_GRID_ROWS;
+             band <= row_t(image->get_bottom()) / IMAGE_GRID_ROWS;
+             ++band) {
+                auto const it = m_image_grid.find(band);
+                if (it == m_image_grid.end())
+                        continue;
+
+                std::erase(it->second, image);
+                if (it->second.empty())
+                        m_image_grid.erase(it);
+        }
 }
 
 void
-Ring::rebuild_image_top_map() /* throws */
+Ring::rebuild_image_index() /* throws */
 {
         m_image_by_top_map.clear();
+        m_image_grid.clear();
 
-        for (auto it = m_image_map.begin(), end = m_image_map.end();
-             it != end;
-             ++it) {
-                auto const& image = it->second;
-                m_image_by_top_map.emplace(std::piecewise_construct,
-                                           std::forward_as_tuple(image->get_top()),
-                                           std::forward_as_tuple(image.get()));
-        }
+        for (auto const& [priority, image] : m_image_map)
+                link_image(image.get());
 }
 
 bool
@@ -320,8 +674,6 @@ Ring::rewrap_images_in_range(Ring::image_by_top_map_type::iterator& it,
  * Returns 0 if given no hyperlink or an empty one, or if the pool is full.
  * Returns the idx (either already existing or newly allocated) from 1 up to
  * VTE_HYPERLINK_COUNT_MAX inclusive otherwise.
- *
- * FIXME do something more effective than a linear search
  */
 Ring::hyperlink_idx_t
 Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
@@ -335,31 +687,34 @@ Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
 
         len = strlen(hyperlink);
 
-        /* Linear search for this particular URI */
-        auto const last_idx = m_hyperlink_highest_used_idx + 1;
-        for (idx = 1; idx < last_idx; ++idx) {
-                if (strcmp(hyperlink_get(idx)->str, hyperlink) == 0) {
-                        _vte_debug_print(vte::debug::category::HYPERLINK,
-                                         "get_hyperlink_idx: already existing idx {} for id;uri=\"{}\"",
-                                         idx, hyperlink);
-                        return idx;
-                }
+        /* Look up this particular URI */
+        if (auto const it = m_hyperlink_map.find(std::string_view{hyperlink, len});
+            it != m_hyperlink_map.end()) {
+                _vte_debug_print(vte::debug::category::HYPERLINK,
+                                 "get_hyperlink_idx: already existing idx {} for id;uri=\"{}\"",
+                                 it->second, hyperlink);
+                return it->second;
         }
 
-        /* FIXME it's the second time we're GCing if coming from get_hyperlink_idx */
-        hyperlink_gc();
+        if (hyperlink_gc_due() ||
+            (m_hyperlink_free_idxs.empty() && m_hyperlink_highest_used_idx == VTE_HYPERLINK_COUNT_MAX))
+                hyperlink_gc();
 
-        /* Another linear search for an empty slot where a GString is already allocated */
-        for (idx = 1; idx < m_hyperlinks->len; idx++) {
-                if (hyperlink_get(idx)->len == 0) {
-                        _vte_debug_print(vte::debug::category::HYPERLINK,
-                                         "get_hyperlink_idx: reassigning old idx {} for id;uri=\"{}\"",
-                                         idx, hyperlink);
-                        /* Grow size if required, however, never shrink to avoid long-term memory fragmentation. */
-                        g_string_append_len (hyperlink_get(idx), hyperlink, len);
-                        m_hyperlink_highest_used_idx = MAX (m_hyperlink_highest_used_idx, idx);
-                        return idx;
-                }
+        ++m_hyperlink_allocated_since_gc;
+
+        /* Reuse an empty slot where a GString is already allocated */
+        if (!m_hyperlink_free_idxs.empty()) {
+                idx = m_hyperlink_free_idxs.back();
+                m_hyperlink_free_idxs.pop_back();
+                _vte_debug_print(vte::debug::category::HYPERLINK,
+                                 "get_hyperlink_idx: reassigning old idx {} for id;uri=\"{}\"",
+                                 idx, hyperlink);
+                /* Grow size if required, however, never shrink to avoid long-term memory fragmentation. */
+                str = hyperlink_get(idx);
+                g_string_append_len (str, hyperlink, len);
+                m_hyperlink_map.emplace(std::string_view{str->str, str->len}, idx);
+                m_hyperlink_highest_used_idx = MAX (m_hyperlink_highest_used_idx, idx);
+                return idx;
         }
 
         /* All allocated slots are in use. Gotta allocate a new one */
@@ -380,6 +735,7 @@ Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
                          idx, hyperlink);
         str = g_string_new_len (hyperlink, len);
         g_ptr_array_add(m_hyperlinks, str);
+        m_hyperlink_map.emplace(std::string_view{str->str, str->len}, idx);
 
         vte_assert_cmpuint(m_hyperlink_highest_used_idx + 1, ==, m_hyperlinks->len);
 
@@ -394,15 +750,13 @@ Ring::get_hyperlink_idx_no_update_current(char const* hyperlink)
  * VTE_HYPERLINK_COUNT_MAX inclusive otherwise.
  *
  * The current idx is also updated, in order not to be garbage collected.
+ * The previous current idx is released; its hyperlink is purged by a later
+ * GC if it no longer occurs in the ring.
  */
 Ring::hyperlink_idx_t
 Ring::get_hyperlink_idx(char const* hyperlink)
 {
-        /* Release current idx and do a round of GC to possibly purge its hyperlink,
-         * even if new hyperlink is nullptr or empty. */
         m_hyperlink_current_idx = 0;
-        hyperlink_gc();
-
         m_hyperlink_current_idx = get_hyperlink_idx_no_update_current(hyperlink);
         return m_hyperlink_current_idx;
 }
@@ -411,6 +765,10 @@ void
 Ring::freeze_row(row_t position,
                  VteRowData const* row)
 {
+        auto timer = std::optional<Stats::ScopedTimer>{};
+        if (m_stats)
+                timer.emplace(*m_stats, Stats::Timing::FREEZE_ROW);
+
 	VteCell *cell;
 	GString *buffer = m_utf8_buffer;
         GString *hyperlink;
@@ -458,13 +816,13 @@ Ring::freeze_row(row_t position,
                                 _attrcpy(&attr_change.attr, &m_last_attr);
                                 hyperlink = hyperlink_get(m_last_attr.hyperlink_idx);
                                 attr_change.attr.hyperlink_length = hyperlink->len;
-				_vte_stream_append (m_attr_stream, (char const* ) &attr_change, sizeof (attr_change));
+				stream_append(m_attr_stream, (char const* ) &attr_change, sizeof (attr_change));
                                 if (G_UNLIKELY (hyperlink->len != 0)) {
-                                        _vte_stream_append (m_attr_stream, hyperlink->str, hyperlink->len);
+                                        stream_append(m_attr_stream, hyperlink->str, hyperlink->len);
                                         froze_hyperlink = TRUE;
                                 }
                                 hyperlink_length = attr_change.attr.hyperlink_length;
-                                _vte_stream_append (m_attr_stream, (char const* ) &hyperlink_length, 2);
+                                stream_append(m_attr_stream, (char const* ) &hyperlink_length, 2);
 				if (!buffer->len)
 					/* This row doesn't use last_attr, adjust */
                                         record.attr_start_offset += sizeof (attr_change) + hyperlink_length + 2;
@@ -482,13 +840,13 @@ Ring::freeze_row(row_t position,
                                 _attrcpy(&attr_change.attr, &m_last_attr);
                                 hyperlink = hyperlink_get(m_last_attr.hyperlink_idx);
                                 attr_change.attr.hyperlink_length = hyperlink->len;
-				_vte_stream_append (m_attr_stream, (char const* ) &attr_change, sizeof (attr_change));
+				stream_append(m_attr_stream, (char const* ) &attr_change, sizeof (attr_change));
                                 if (G_UNLIKELY (hyperlink->len != 0)) {
-                                        _vte_stream_append (m_attr_stream, hyperlink->str, hyperlink->len);
+                                        stream_append(m_attr_stream, hyperlink->str, hyperlink->len);
                                         froze_hyperlink = TRUE;
                                 }
                                 hyperlink_length = attr_change.attr.hyperlink_length;
-                                _vte_stream_append (m_attr_stream, (char const* ) &hyperlink_length, 2);
+                                stream_append(m_attr_stream, (char const* ) &hyperlink_length, 2);
 				m_last_attr = attr;
 			}
 
@@ -501,7 +859,7 @@ Ring::freeze_row(row_t position,
 	record.soft_wrapped = row->attr.soft_wrapped;
         record.bidi_flags = row->attr.bidi_flags;
 
-	_vte_stream_append(m_text_stream, buffer->str, buffer->len);
+	stream_append(m_text_stream, buffer->str, buffer->len);
 	append_row_record(&record, position);
 
         /* After freezing some hyperlinks, do a hyperlink GC. The constant is totally arbitrary, feel free to fine tune. */
@@ -555,7 +913,7 @@ Ring::thaw_row(row_t position,
 		records[1].text_start_offset = _vte_stream_head (m_text_stream);
 
 	g_string_set_size (buffer, records[1].text_start_offset - records[0].text_start_offset);
-	if (!_vte_stream_read (m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
+	if (!stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
 		return;
 
 	record = records[0];
@@ -574,11 +932,11 @@ Ring::thaw_row(row_t position,
                         strcpy(hyperlink_readbuf, hyperlink_get(attr.hyperlink_idx)->str);
 		} else {
 			if (record.text_start_offset >= attr_change.text_end_offset) {
-				if (!_vte_stream_read (m_attr_stream, record.attr_start_offset, (char *) &attr_change, sizeof (attr_change)))
+				if (!stream_read(m_attr_stream, record.attr_start_offset, (char *) &attr_change, sizeof (attr_change)))
 					return;
 				record.attr_start_offset += sizeof (attr_change);
                                 vte_assert_cmpuint (attr_change.attr.hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                if (attr_change.attr.hyperlink_length && !_vte_stream_read (m_attr_stream, record.attr_start_offset, hyperlink_readbuf, attr_change.attr.hyperlink_length))
+                                if (attr_change.attr.hyperlink_length && !stream_read(m_attr_stream, record.attr_start_offset, hyperlink_readbuf, attr_change.attr.hyperlink_length))
                                         return;
                                 hyperlink_readbuf[attr_change.attr.hyperlink_length] = '\0';
                                 record.attr_start_offset += attr_change.attr.hyperlink_length + 2;
@@ -610,6 +968,7 @@ Ring::thaw_row(row_t position,
                         }
                 }
 		cell.c = g_utf8_get_char (p);
+                _vte_row_data_note_char (row, cell.c);
 
 		q = g_utf8_next_char (p);
 		record.text_start_offset += q - p;
@@ -656,9 +1015,9 @@ Ring::thaw_row(row_t position,
 		if (records[0].text_start_offset <= m_last_attr_text_start_offset) {
 			/* Check the previous attr record. If its text ends where truncating, this attr record also needs to be removed. */
                         guint16 hyperlink_length;
-                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
+                        if (stream_read(m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
                                 vte_assert_cmpuint (hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
+                                if (stream_read(m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
                                         if (records[0].text_start_offset == attr_change.text_end_offset) {
                                                 _vte_debug_print(vte::debug::category::RING, "... at attribute change");
                                                 attr_stream_truncate_at -= sizeof (attr_change) + hyperlink_length + 2;
@@ -667,16 +1026,16 @@ Ring::thaw_row(row_t position,
 			}
 			/* Reconstruct last_attr from the first record of attr_stream that we cut off,
 			   last_attr_text_start_offset from the last record that we keep. */
-			if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at, (char *) &attr_change, sizeof (attr_change))) {
+			if (stream_read(m_attr_stream, attr_stream_truncate_at, (char *) &attr_change, sizeof (attr_change))) {
                                 _attrcpy(&m_last_attr, &attr_change.attr);
                                 m_last_attr.hyperlink_idx = 0;
-                                if (attr_change.attr.hyperlink_length && _vte_stream_read (m_attr_stream, attr_stream_truncate_at + sizeof (attr_change), (char *) &hyperlink_readbuf, attr_change.attr.hyperlink_length)) {
+                                if (attr_change.attr.hyperlink_length && stream_read(m_attr_stream, attr_stream_truncate_at + sizeof (attr_change), (char *) &hyperlink_readbuf, attr_change.attr.hyperlink_length)) {
                                         hyperlink_readbuf[attr_change.attr.hyperlink_length] = '\0';
                                         m_last_attr.hyperlink_idx = get_hyperlink_idx(hyperlink_readbuf);
                                 }
-                                if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
+                                if (stream_read(m_attr_stream, attr_stream_truncate_at - 2, (char *) &hyperlink_length, 2)) {
                                         vte_assert_cmpuint (hyperlink_length, <=, VTE_HYPERLINK_TOTAL_LENGTH_MAX);
-                                        if (_vte_stream_read (m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
+                                        if (stream_read(m_attr_stream, attr_stream_truncate_at - 2 - hyperlink_length - sizeof (attr_change), (char *) &attr_change, sizeof (attr_change))) {
                                                 m_last_attr_text_start_offset = attr_change.text_end_offset;
                                         } else {
                                                 m_last_attr_text_start_offset = 0;
@@ -722,12 +1081,22 @@ Ring::reset()
         reset_streams(m_end);
         m_start = m_writable = m_end;
         m_cached_row_num = (row_t)-1;
+        ++m_generation;
 
 #if WITH_SIXEL
         m_image_by_top_map.clear();
+        m_image_grid.clear();
         m_image_map.clear();
+        m_image_store.clear();
+        m_image_spill_store.clear();
         m_next_image_priority = 0;
         m_image_fast_memory_used = 0;
+        m_image_fast_count = 0;
+        m_image_spilled_size = 0;
+        m_image_stream_reclaim = false;
+        m_provisional_image.reset();
+        if (m_image_stream)
+                _vte_stream_reset(m_image_stream, _vte_stream_head(m_image_stream));
 #endif
 
         return m_end;
@@ -905,6 +1274,8 @@ Ring::thaw_one_row()
 
 	row = get_writable_index(m_writable);
         thaw_row(m_writable, row, true, -1, nullptr);
+        touch(row);
+        ++m_frozen_generation;
 }
 
 void
@@ -1037,6 +1408,16 @@ Ring::shrink(row_t max_len)
 	validate();
 }
 
+BidiCache&
+Ring::bidi_cache()
+{
+        if (!m_bidi_cache)
+                m_bidi_cache = std::make_unique<BidiCache>();
+
+        m_bidi_cache->validate(m_generation, m_frozen_generation);
+        return *m_bidi_cache;
+}
+
 /**
  * Ring::insert:
  * @position: an index
@@ -1072,6 +1453,7 @@ Ring::insert(row_t position, guint8 bidi_flags)
 
 	row = get_writable_index(position);
 	_vte_row_data_clear (row);
+        touch(row);
         row->attr.bidi_flags = bidi_flags;
 	m_end++;
 
@@ -1210,7 +1592,7 @@ Ring::frozen_row_column_to_text_offset(row_t position,
                 return true;
 
         g_string_set_size (buffer, records[1].text_start_offset - records[0].text_start_offset);
-	if (!_vte_stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
+	if (!stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
 		return false;
 
 	if (G_LIKELY (buffer->len && buffer->str[buffer->len - 1] == '\n'))
@@ -1283,7 +1665,7 @@ Ring::frozen_row_text_offset_to_column(row_t position,
 		records[1].text_start_offset = _vte_stream_head (m_text_stream);
 
 	g_string_set_size (buffer, records[1].text_start_offset - records[0].text_start_offset);
-	if (!_vte_stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
+	if (!stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
 		return false;
 
 	if (G_LIKELY (buffer->len && buffer->str[buffer->len - 1] == '\n'))
@@ -1359,6 +1741,7 @@ Ring::rewrap(column_t columns,
 
 	if (G_UNLIKELY(length() == 0))
 		return;
+        ++m_generation;
 	_vte_debug_print(vte::debug::category::RING,
                          "Ring before rewrapping:");
         validate();
@@ -1398,7 +1781,7 @@ Ring::rewrap(column_t columns,
 	new_row_index = 0;
 
 	attr_offset = old_record.attr_start_offset;
-	if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
+	if (!stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
                 _attrcpy(&attr_change.attr, &m_last_attr);
                 attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
 		attr_change.text_end_offset = _vte_stream_head(m_text_stream);
@@ -1449,7 +1832,7 @@ Ring::rewrap(column_t columns,
 		if (attr_change.text_end_offset <= text_offset) {
 			/* Attr change at paragraph boundary, advance to next attr. */
                         attr_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
-			if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
+			if (!stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
                                 _attrcpy(&attr_change.attr, &m_last_attr);
                                 attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
 				attr_change.text_end_offset = _vte_stream_head(m_text_stream);
@@ -1467,7 +1850,7 @@ Ring::rewrap(column_t columns,
 			if (attr_change.text_end_offset <= text_offset) {
 				/* Attr change at line boundary, advance to next attr. */
                                 attr_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
-				if (!_vte_stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
+				if (!stream_read(m_attr_stream, attr_offset, (char *) &attr_change, sizeof (attr_change))) {
                                         _attrcpy(&attr_change.attr, &m_last_attr);
                                         attr_change.attr.hyperlink_length = hyperlink_get(m_last_attr.hyperlink_idx)->len;
 					attr_change.text_end_offset = _vte_stream_head(m_text_stream);
@@ -1500,7 +1883,7 @@ Ring::rewrap(column_t columns,
 						/* Wrap now, write the soft wrapped row's record */
                                                 new_record.width = col;
 						new_record.soft_wrapped = 1;
-						_vte_stream_append(new_row_stream, (char const* ) &new_record, sizeof (new_record));
+						stream_append(new_row_stream, (char const* ) &new_record, sizeof (new_record));
 						_vte_debug_print(vte::debug::category::RING,
                                                                  "    New row {}  text_offset {}  attr_offset {}  soft_wrapped",
                                                                  new_row_index,
@@ -1546,7 +1929,7 @@ Ring::rewrap(column_t columns,
 						/* Find beginning of next UTF-8 character */
 						text_offset++; paragraph_len--; runlength--;
 						textbuf_len = MIN(runlength, sizeof (textbuf));
-						if (!_vte_stream_read(m_text_stream, text_offset, textbuf, textbuf_len))
+						if (!stream_read(m_text_stream, text_offset, textbuf, textbuf_len))
 							goto err;
 						for (i = 0; i < textbuf_len && (textbuf[i] & 0xC0) == 0x80; i++) {
 							text_offset++; paragraph_len--; runlength--;
@@ -1560,7 +1943,7 @@ Ring::rewrap(column_t columns,
 		/* Hard wrapped, except maybe at the end of the very last paragraph */
                 new_record.width = col;
 		new_record.soft_wrapped = prev_record_was_soft_wrapped;
-		_vte_stream_append(new_row_stream, (char const* ) &new_record, sizeof (new_record));
+		stream_append(new_row_stream, (char const* ) &new_record, sizeof (new_record));
 		_vte_debug_print(vte::debug::category::RING,
                                  "    New row {}  text_offset {}  attr_offset {}",
                                  new_row_index,
@@ -1624,8 +2007,11 @@ Ring::rewrap(column_t columns,
 	g_free(new_markers);
 
 #if WITH_SIXEL
+        /* The provisional image is set again on the next update */
+        drop_provisional_image();
+
         try {
-                rebuild_image_top_map();
+                rebuild_image_index();
         } catch (...) {
                 vte::log_exception();
         }
@@ -1647,31 +2033,207 @@ err:
 }
 
 
-bool
-Ring::write_row(GOutputStream* stream,
-                VteRowData* row,
-                VteWriteFlags flags,
-                GCancellable* cancellable,
-                GError** error)
+void
+Ring::append_row_text(VteRowData const* row,
+                      GString* buffer)
 {
-	VteCell *cell;
-	GString *buffer = m_utf8_buffer;
+	VteCell const* cell;
 	int i;
-	gsize bytes_written;
 
 	/* Simple version of the loop in freeze_row().
 	 * TODO Should unify one day */
-	g_string_truncate (buffer, 0);
 	for (i = 0, cell = row->cells; i < row->len; i++, cell++) {
 		if (G_LIKELY (!cell->attr.fragment()))
 			_vte_unistr_append_to_string (cell->c, buffer);
 	}
 	if (!row->attr.soft_wrapped)
 		g_string_append_c (buffer, '\n');
+}
+
+bool
+Ring::write_row(GOutputStream* stream,
+                VteRowData* row,
+                VteWriteFlags flags,
+                GCancellable* cancellable,
+                GError** error)
+{
+	GString *buffer = m_utf8_buffer;
+	gsize bytes_written;
+
+	g_string_truncate (buffer, 0);
+        append_row_text(row, buffer);
 
 	return g_output_stream_write_all (stream, buffer->str, buffer->len, &bytes_written, cancellable, error);
 }
 
+/**
+ * Ring::append_text:
+ * @start: the first row
+ * @end: the row to stop at
+ * @buffer: a #GString to append to
+ *
+ * Appends the text of the rows from @start up to @end to @buffer, the same
+ * way write_contents() writes it. Rows that are scrolled out to the streams
+ * are copied straight from the text stream, without thawing them.
+ *
+ * Return: %TRUE on success, %FALSE if the text stream could not be read
+ */
+bool
+Ring::append_text(row_t start,
+                  row_t end,
+                  GString* buffer)
+{
+        start = MAX(start, m_start);
+        end = MIN(end, m_end);
+        if (start >= end)
+                return true;
+
+        if (start < m_writable) {
+                RowRecord record;
+
+                if (!read_row_record(&record, start))
+                        return false;
+
+                auto const start_offset = record.text_start_offset;
+                auto end_offset = _vte_stream_head(m_text_stream);
+                if (end < m_writable) {
+                        if (!read_row_record(&record, end))
+                                return false;
+                        end_offset = record.text_start_offset;
+                }
+
+                auto const old_len = buffer->len;
+                g_string_set_size(buffer, old_len + end_offset - start_offset);
+                if (!stream_read(m_text_stream, start_offset,
+                                      buffer->str + old_len, end_offset - start_offset)) {
+                        g_string_truncate(buffer, old_len);
+                        return false;
+                }
+
+                start = m_writable;
+        }
+
+        for (auto i = start; i < end; i++)
+                append_row_text(get_writable_index(i), buffer);
+
+        return true;
+}
+
+/* Whether the cells with @a and @b belong to the same run of text,
+ * ignoring their width and hyperlinks.
+ */
+static inline bool
+run_attr_equal(VteCellAttr const& a,
+               VteCellAttr const& b) noexcept
+{
+        auto const mask = ~uint32_t(VTE_ATTR_COLUMNS_MASK | VTE_ATTR_FRAGMENT_MASK);
+        return (a.attr & mask) == (b.attr & mask) && a.colors() == b.colors();
+}
+
+/**
+ * Ring::foreach_run:
+ * @position: the row
+ * @soft_wrapped: (out): whether the row is soft wrapped
+ * @func: the function to call
+ *
+ * Calls @func with the attributes and the UTF-8 text of each run of
+ * characters of the row at @position, in order. Consecutive runs may have
+ * attributes that only differ in their width or hyperlink. Rows that are
+ * scrolled out to the streams are read from the text and attribute streams
+ * directly, without thawing them. @func must not call into the ring.
+ *
+ * Return: %TRUE on success, %FALSE if the streams could not be read
+ */
+bool
+Ring::foreach_run(row_t position,
+                  bool& soft_wrapped,
+                  RunFunc const& func)
+{
+        auto const buffer = m_utf8_buffer;
+        soft_wrapped = false;
+
+        if (position < m_start || position >= m_end)
+                return true;
+
+        if (position >= m_writable) {
+                auto const row = get_writable_index(position);
+                soft_wrapped = row->attr.soft_wrapped;
+
+                for (auto col = 0; col < row->len; ) {
+                        auto const& attr = row->cells[col].attr;
+
+                        g_string_truncate(buffer, 0);
+                        for (; col < row->len; ++col) {
+                                auto const cell = &row->cells[col];
+                                if (cell->attr.fragment())
+                                        continue;
+                                if (!run_attr_equal(cell->attr, attr))
+                                        break;
+
+                                _vte_unistr_append_to_string(cell->c, buffer);
+                        }
+
+                        if (buffer->len)
+                                func(attr, std::string_view{buffer->str, buffer->len});
+                }
+
+                return true;
+        }
+
+        RowRecord records[2];
+        if (!read_row_record(&records[0], position))
+                return false;
+        if ((position + 1) * sizeof (records[0]) < _vte_stream_head (m_row_stream)) {
+                if (!read_row_record(&records[1], position + 1))
+                        return false;
+        } else
+                records[1].text_start_offset = _vte_stream_head (m_text_stream);
+
+        g_string_set_size(buffer, records[1].text_start_offset - records[0].text_start_offset);
+        if (!stream_read(m_text_stream, records[0].text_start_offset, buffer->str, buffer->len))
+                return false;
+
+        auto len = size_t(buffer->len);
+        if (len && buffer->str[len - 1] == '\n')
+                --len;
+        else
+                soft_wrapped = true;
+
+        /* Walk the attribute changes like thaw_row() does, but per run
+         * instead of per character.
+         */
+        auto record = records[0];
+        auto attr = VteCellAttr{};
+        auto attr_change = CellAttrChange{};
+        attr_change.text_end_offset = 0;
+
+        for (auto pos = size_t{0}; pos < len; ) {
+                auto run_end = len;
+                if (record.text_start_offset >= m_last_attr_text_start_offset) {
+                        attr = m_last_attr;
+                } else {
+                        if (record.text_start_offset >= attr_change.text_end_offset) {
+                                if (!stream_read(m_attr_stream, record.attr_start_offset,
+                                                 (char*)&attr_change, sizeof (attr_change)))
+                                        return false;
+                                record.attr_start_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
+
+                                _attrcpy(&attr, &attr_change.attr);
+                                attr.hyperlink_idx = 0;
+                                continue;
+                        }
+
+                        run_end = std::min(len, size_t(attr_change.text_end_offset - records[0].text_start_offset));
+                }
+
+                func(attr, std::string_view{buffer->str + pos, run_end - pos});
+                record.text_start_offset += run_end - pos;
+                pos = run_end;
+        }
+
+        return true;
+}
+
 /**
  * Ring::write_contents:
  * @stream: a #GOutputStream to write to
@@ -1708,7 +2270,7 @@ Ring::write_contents(GOutputStream* stream,
 
 				len = MIN (G_N_ELEMENTS (buf), end_offset - start_offset);
 
-				if (!_vte_stream_read (m_text_stream, start_offset,
+				if (!stream_read(m_text_stream, start_offset,
 						       buf, len))
 					return false;
 
@@ -1737,9 +2299,174 @@ Ring::write_contents(GOutputStream* stream,
 
 #if WITH_SIXEL
 
+/**
+ * Ring::lookup_image_surface:
+ * @key: the content key of an image
+ *
+ * Returns: a new reference to the surface of an image in the ring
+ *   with content key @key, or %nullptr if there is no such image
+ */
+vte::Freeable<cairo_surface_t>
+Ring::lookup_image_surface(vte::image::ContentKey const& key) const noexcept
+{
+        auto const it = m_image_store.find(key);
+        if (it == m_image_store.end())
+                return nullptr;
+
+        return vte::take_freeable(cairo_surface_reference(it->second.surface.get()));
+}
+
+/**
+ * Ring::images_in_area:
+ * @start_row: the first row
+ * @end_row: the row after the last row
+ * @start_col: the first column
+ * @end_col: the column after the last column
+ *
+ * Returns: the images intersecting the area, ordered by priority
+ */
+std::vector<vte::image::Image*>
+Ring::images_in_area(row_t start_row,
+                     row_t end_row,
+                     long start_col,
+                     long end_col) const /* throws */
+{
+        auto images = std::vector<vte::image::Image*>{};
+        if (start_row >= end_row || start_col >= end_col)
+                return images;
+
+        for (auto band = start_row / IMAGE_GRID_ROWS;
+             band <= (end_row - 1) / IMAGE_GRID_ROWS;
+             ++band) {
+                auto const it = m_image_grid.find(band);
+                if (it == m_image_grid.end())
+                        continue;
+
+                for (auto const image : it->second) {
+                        if (row_t(image->get_top()) < end_row &&
+                            row_t(image->get_bottom()) >= start_row &&
+                            image->get_left() < end_col &&
+                            image->get_left() + image->get_width() > start_col)
+                                images.push_back(image);
+                }
+        }
+
+        /* Images spanning several bands were found more than once */
+        std::ranges::sort(images, {}, &vte::image::Image::get_priority);
+        auto const [first, last] = std::ranges::unique(images);
+        images.erase(first, last);
+
+        return images;
+}
+
+/**
+ * Ring::materialize_images:
+ * @start: the first row
+ * @end: the row after the last row
+ *
+ * Reads the spilled images that intersect the rows from @start to @end
+ * back from the image stream, so that they can be painted. Call this
+ * before painting those rows' images.
+ */
+void
+Ring::materialize_images(row_t start,
+                         row_t end) noexcept
+{
+        auto images = std::vector<vte::image::Image*>{};
+        try {
+                images = images_in_area(start, end, 0, G_MAXLONG);
+        } catch (...) {
+                vte::log_exception();
+        }
+
+        for (auto const image : images) {
+                if (!image->is_spilled())
+                        continue;
+
+                if (!materialize_image(image))
+                        _vte_debug_print(vte::debug::category::RING,
+                                         "Failed to materialize image {}",
+                                         image->get_priority());
+        }
+
+        reclaim_image_stream();
+}
+
+/**
+ * Ring::scaled_image_surface:
+ * @image: a resident image
+ * @cell_width: the current cell width in pixels
+ * @cell_height: the current cell height in pixels
+ *
+ * Returns the surface of @image scaled to @cell_width x @cell_height, to
+ * pass to vte::image::Image::paint(). The scaled surface is cached together
+ * with the surface in the image store, so that identical images share it,
+ * and counts towards the images' memory use. Images without a content key
+ * are not cached, nor are those whose scaled surface would exceed the
+ * memory limit; these are scaled while painting instead.
+ *
+ * Returns: the scaled surface, or %nullptr
+ */
+cairo_surface_t*
+Ring::scaled_image_surface(vte::image::Image const* image,
+                           int cell_width,
+                           int cell_height) noexcept
+{
+        auto const& key = image->get_key();
+        if (!key || image->is_spilled())
+                return nullptr;
+
+        auto const it = m_image_store.find(*key);
+        if (it == m_image_store.end())
+                return nullptr;
+
+        auto& entry = it->second;
+        if (entry.scaled_surface &&
+            entry.scaled_from_cell_width == image->get_cell_width() &&
+            entry.scaled_from_cell_height == image->get_cell_height() &&
+            entry.scaled_cell_width == cell_width &&
+            entry.scaled_cell_height == cell_height)
+                return entry.scaled_surface.get();
+
+        drop_scaled_surface(entry);
+
+        auto surface = image->create_scaled_surface(cell_width, cell_height);
+        if (!surface)
+                return nullptr;
+
+        auto const size = size_t(cairo_image_surface_get_stride(surface.get())) *
+                size_t(cairo_image_surface_get_height(surface.get()));
+        if (m_image_fast_memory_used + size > IMAGE_FAST_MEMORY_USED_MAX)
+                return nullptr;
+
+        entry.scaled_surface = std::move(surface);
+        entry.scaled_from_cell_width = image->get_cell_width();
+        entry.scaled_from_cell_height = image->get_cell_height();
+        entry.scaled_cell_width = cell_width;
+        entry.scaled_cell_height = cell_height;
+        entry.scaled_resource_size = size;
+        m_image_fast_memory_used += size;
+
+        return entry.scaled_surface.get();
+}
+
+/**
+ * Ring::drop_scaled_images:
+ *
+ * Frees the cached scaled surfaces. Call this when the cell size changes,
+ * since they are then no longer useful.
+ */
+void
+Ring::drop_scaled_images() noexcept
+{
+        for (auto& [key, entry] : m_image_store)
+                drop_scaled_surface(entry);
+}
+
 /**
  * Ring::append_image:
  * @surface: A Cairo surface object
+ * @key: the content key of @surface, or %std::nullopt
  * @pixelwidth: vte::image::Image width in pixels
  * @pixelheight: vte::image::Image height in pixels
  * @left: Left position of image in cell units
@@ -1747,10 +2474,13 @@ Ring::write_contents(GOutputStream* stream,
  * @cell_width: Width of image in cell units
  * @cell_height: Height of image in cell units
  *
- * Append an image to the internal image list.
+ * Append an image to the internal image list. If @key is given, the
+ * image shares its surface with the other images with the same key.
+ * Appending an image replaces the provisional image, if any.
  */
 void
 Ring::append_image(vte::Freeable<cairo_surface_t> surface,
+                   std::optional<vte::image::ContentKey> const& key,
                    int pixelwidth,
                    int pixelheight,
                    long left,
@@ -1758,10 +2488,13 @@ Ring::append_image(vte::Freeable<cairo_surface_t> surface,
                    long cell_width,
                    long cell_height) /* throws */
 {
+        drop_provisional_image();
+
         auto const priority = m_next_image_priority;
         auto [it, success] = m_image_map.try_emplace
                 (priority, // key
                  std::make_unique<vte::image::Image>(std::move(surface),
+                                                     key,
                                                      priority,
                                                      pixelwidth,
                                                      pixelheight,
@@ -1776,14 +2509,59 @@ Ring::append_image(vte::Freeable<cairo_surface_t> surface,
 
         auto const& image = it->second;
 
-        m_image_by_top_map.emplace(std::piecewise_construct,
-                                   std::forward_as_tuple(image->get_top()),
-                                   std::forward_as_tuple(image.get()));
+        link_image(image.get());
+        retain_image(image.get());
 
-        m_image_fast_memory_used += image->resource_size ();
-
-        image_gc_region();
+        image_gc_region(image.get());
         image_gc();
 }
 
+/**
+ * Ring::set_provisional_image:
+ * @surface: A Cairo surface object
+ * @pixelwidth: vte::image::Image width in pixels
+ * @pixelheight: vte::image::Image height in pixels
+ * @left: Left position of image in cell units
+ * @top: Top position of image in cell units
+ * @cell_width: Width of image in cell units
+ * @cell_height: Height of image in cell units
+ *
+ * Sets the provisional image, showing the part received so far of an
+ * image that is still being received. It replaces the previous provisional
+ * image, and is itself replaced by the next image appended. It is drawn
+ * above the other images, but neither overdraws them nor counts towards
+ * the limits that make them be spilled or deleted, since it may yet be
+ * aborted.
+ */
+void
+Ring::set_provisional_image(vte::Freeable<cairo_surface_t> surface,
+                            int pixelwidth,
+                            int pixelheight,
+                            long left,
+                            long top,
+                            long cell_width,
+                            long cell_height) /* throws */
+{
+        m_provisional_image = std::make_unique<vte::image::Image>(std::move(surface),
+                                                                  std::nullopt,
+                                                                  m_next_image_priority,
+                                                                  pixelwidth,
+                                                                  pixelheight,
+                                                                  left,
+                                                                  top,
+                                                                  cell_width,
+                                                                  cell_height);
+}
+
+/**
+ * Ring::drop_provisional_image:
+ *
+ * Deletes the provisional image, if any.
+ */
+void
+Ring::drop_provisional_image() noexcept
+{
+        m_provisional_image.reset();
+}
+
 #endif /* WITH_SIXEL */
@@ -24,6 +24,7 @@
 #include <gio/gio.h>
 #include <vte/vte.h>
 
+#include "stats.hh"
 #include "vterowdata.hh"
 #include "vtestream.h"
 
@@ -31,10 +32,14 @@
 #include "cairo-glue.hh"
 #include "image.hh"
 #include <map>
-#include <memory>
 #endif
 
+#include <functional>
+#include <memory>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 typedef struct _VteVisualPosition {
 	long row, col;
@@ -44,6 +49,8 @@ namespace vte {
 
 namespace base {
 
+class BidiCache;
+
 /*
  * Ring:
  *
@@ -77,6 +84,7 @@ public:
         inline row_t delta() const { return m_start; }
         inline row_t length() const { return m_end - m_start; }
         inline row_t next() const { return m_end; }
+        inline row_t writable() const { return m_writable; }
 
         //FIXMEchpe rename this to at()
         //FIXMEchpe use references not pointers
@@ -105,10 +113,39 @@ public:
                             VteWriteFlags flags,
                             GCancellable* cancellable,
                             GError** error);
+        bool append_text(row_t start,
+                         row_t end,
+                         GString* buffer);
+
+        using RunFunc = std::function<void(VteCellAttr const&, std::string_view)>;
+        bool foreach_run(row_t position,
+                         bool& soft_wrapped,
+                         RunFunc const& func);
+
+        inline void set_stats(Stats* stats) noexcept { m_stats = stats; }
+
+        /* Changes whenever existing row positions become meaningless, i.e. on rewrap and reset */
+        inline auto generation() const noexcept { return m_generation; }
+
+        /* Changes whenever frozen rows are thawed, i.e. when the contents at a
+         * frozen row's position may change without a new generation() */
+        inline auto frozen_generation() const noexcept { return m_frozen_generation; }
+
+        /* The BiDi mappings shared by the RingViews on this ring */
+        BidiCache& bidi_cache();
 
         inline VteRowData* index_writable(row_t position) {
                 ensure_writable(position);
-                return get_writable_index(position);
+                return touch(get_writable_index(position));
+        }
+
+        /* Returns a value that changes whenever the row at @position may have
+         * been modified, or 0 if this isn't tracked, i.e. for frozen rows. */
+        inline uint32_t row_serial(row_t position) const noexcept
+        {
+                if (position < m_writable || position >= m_end)
+                        return 0;
+                return get_writable_index(position)->serial;
         }
 
 private:
@@ -121,7 +158,17 @@ private:
 
         inline VteRowData* get_writable_index(row_t position) const { return &m_array[position & m_mask]; }
 
+        /* Stamps @row as modified, see row_serial() */
+        inline VteRowData* touch(VteRowData* row) noexcept
+        {
+                if (G_UNLIKELY(++m_row_serial == 0))
+                        ++m_row_serial;
+                row->serial = m_row_serial;
+                return row;
+        }
+
         void hyperlink_gc();
+        bool hyperlink_gc_due() const noexcept;
         hyperlink_idx_t get_hyperlink_idx_no_update_current(char const* hyperlink);
 
         typedef struct _CellAttrChange {
@@ -149,10 +196,30 @@ private:
 
         static_assert(std::is_standard_layout_v<CellTextOffset> && std::is_trivial_v<CellTextOffset>, "Ring::CellTextOffset is not POD");
 
+        /* Wrappers around the stream I/O that count the bytes */
+        inline bool stream_read(VteStream* stream,
+                                gsize offset,
+                                char* data,
+                                gsize len) const
+        {
+                if (m_stats)
+                        m_stats->add_stream_read(len);
+                return _vte_stream_read(stream, offset, data, len);
+        }
+
+        inline void stream_append(VteStream* stream,
+                                  char const* data,
+                                  gsize len) const
+        {
+                if (m_stats)
+                        m_stats->add_stream_written(len);
+                _vte_stream_append(stream, data, len);
+        }
+
         inline bool read_row_record(RowRecord* record /* out */,
                                     row_t position)
         {
-                return _vte_stream_read(m_row_stream,
+                return stream_read(m_row_stream,
                                         position * sizeof(*record),
                                         (char*)record,
                                         sizeof(*record));
@@ -161,7 +228,7 @@ private:
         inline void append_row_record(RowRecord const* record,
                                       row_t position)
         {
-                _vte_stream_append(m_row_stream,
+                stream_append(m_row_stream,
                                    (char const*)record,
                                    sizeof(*record));
         }
@@ -173,6 +240,8 @@ private:
                                               CellTextOffset const* offset,
                                               column_t* column);
 
+        void append_row_text(VteRowData const* row,
+                             GString* buffer);
         bool write_row(GOutputStream* stream,
                        VteRowData* row,
                        VteWriteFlags flags,
@@ -207,6 +276,13 @@ private:
 	row_t m_max;
 	row_t m_start{0};
         row_t m_end{0};
+        uint64_t m_generation{0};
+        uint64_t m_frozen_generation{0};
+        std::unique_ptr<BidiCache> m_bidi_cache;
+        uint32_t m_row_serial{0};
+
+        /* The terminal's counters, or nullptr */
+        Stats* m_stats{nullptr};
 
 	/* Writable */
 	row_t m_writable{0};
@@ -248,11 +324,19 @@ private:
                                                  An idx is allocated on hover even if the cell is scrolled out to the streams. */
         row_t m_hyperlink_maybe_gc_counter{0};  /* Do a GC when it reaches 65536. */
 
+        /* Maps the id;uri of every nonempty pool entry to its idx. The keys point into the GStrings of m_hyperlinks. */
+        std::unordered_map<std::string_view, hyperlink_idx_t> m_hyperlink_map{};
+        /* Empty pool entries available for reuse, in descending order so that the lowest idx is reused first. */
+        std::vector<hyperlink_idx_t> m_hyperlink_free_idxs{};
+        hyperlink_idx_t m_hyperlink_allocated_since_gc{0};  /* Number of idxs handed out since the last GC. */
+        hyperlink_idx_t m_hyperlink_live_after_gc{0};  /* Number of idxs that survived the last GC. */
+
 #if WITH_SIXEL
 
 private:
         size_t m_next_image_priority{0};
         size_t m_image_fast_memory_used{0};
+        size_t m_image_fast_count{0};
 
         /* m_image_priority_map stores the Image. key is the priority of the image. */
         using image_map_type = std::map<size_t, std::unique_ptr<vte::image::Image>>;
@@ -264,10 +348,76 @@ private:
         using image_by_top_map_type = std::multimap<row_t, vte::image::Image*>;
         image_by_top_map_type m_image_by_top_map{};
 
+        /* m_image_grid indexes the images by the bands of rows they intersect,
+         * so that finding the images in an area doesn't need to go through
+         * all of them; key is the band number.
+         */
+        using image_grid_type = std::unordered_map<row_t, std::vector<vte::image::Image*>>;
+        image_grid_type m_image_grid{};
+
+        /* m_image_store holds the surfaces of the images that have a content key,
+         * so that identical images share one surface. Each surface is counted only
+         * once in m_image_fast_memory_used, and is dropped when the last image
+         * using it is deleted. The entry also caches the surface scaled to the
+         * current cell size, which is counted in m_image_fast_memory_used too.
+         */
+        struct ImageStoreEntry {
+                vte::Freeable<cairo_surface_t> surface;
+                size_t n_images;
+                size_t resource_size;
+
+                /* See scaled_image_surface() */
+                vte::Freeable<cairo_surface_t> scaled_surface{};
+                int scaled_from_cell_width{0};
+                int scaled_from_cell_height{0};
+                int scaled_cell_width{0};
+                int scaled_cell_height{0};
+                size_t scaled_resource_size{0};
+        };
+        using image_store_type = std::unordered_map<vte::image::ContentKey,
+                                                    ImageStoreEntry,
+                                                    vte::image::ContentKey::Hash>;
+        image_store_type m_image_store{};
+
+        /* Images evicted from memory are spilled to m_image_stream as PNG, and
+         * re-materialized on demand. m_image_spill_store holds the location of
+         * the data of each spilled image's content key, so that identical
+         * images are written only once, and is refcounted by the spilled
+         * images. m_image_stream is only created when the ring has streams.
+         */
+        struct ImageSpillEntry {
+                gsize offset;
+                gsize length;
+                size_t n_images;
+        };
+        using image_spill_store_type = std::unordered_map<vte::image::ContentKey,
+                                                          ImageSpillEntry,
+                                                          vte::image::ContentKey::Hash>;
+        image_spill_store_type m_image_spill_store{};
+        VteStream* m_image_stream{nullptr};
+        size_t m_image_spilled_size{0};
+        bool m_image_stream_reclaim{false};
+
+        /* The provisional image showing the part received so far of an image
+         * that is still being received, if any. It is kept apart from the other
+         * images, and not counted in their memory use, so that it cannot make
+         * image_gc() spill or delete them.
+         */
+        std::unique_ptr<vte::image::Image> m_provisional_image{};
+
+        void retain_image(vte::image::Image const* image) /* throws */;
+        void release_image(vte::image::Image const* image) noexcept;
+        void drop_scaled_surface(ImageStoreEntry& entry) noexcept;
+        image_map_type::iterator drop_image(image_map_type::iterator it) noexcept;
+        bool spill_image(vte::image::Image* image) noexcept;
+        bool materialize_image(vte::image::Image* image) noexcept;
+        void reclaim_image_stream() noexcept;
         void image_gc() noexcept;
-        void image_gc_region() noexcept;
-        void unlink_image_from_top_map(vte::image::Image const* image) noexcept;
-        void rebuild_image_top_map() /* throws */;
+        bool image_is_overdrawn(vte::image::Image const* image) const /* throws */;
+        void image_gc_region(vte::image::Image const* image) noexcept;
+        void link_image(vte::image::Image* image) /* throws */;
+        void unlink_image(vte::image::Image const* image) noexcept;
+        void rebuild_image_index() /* throws */;
         bool rewrap_images_in_range(image_by_top_map_type::iterator& it,
                                     size_t text_start_ofs,
                                     size_t text_end_ofs,
@@ -276,7 +426,24 @@ private:
 public:
         auto const& image_map() const noexcept { return m_image_map; }
 
+        vte::Freeable<cairo_surface_t> lookup_image_surface(vte::image::ContentKey const& key) const noexcept;
+
+        std::vector<vte::image::Image*> images_in_area(row_t start_row,
+                                                       row_t end_row,
+                                                       long start_col,
+                                                       long end_col) const /* throws */;
+
+        void materialize_images(row_t start,
+                                row_t end) noexcept;
+
+        cairo_surface_t* scaled_image_surface(vte::image::Image const* image,
+                                              int cell_width,
+                                              int cell_height) noexcept;
+
+        void drop_scaled_images() noexcept;
+
         void append_image(vte::Freeable<cairo_surface_t> surface,
+                          std::optional<vte::image::ContentKey> const& key,
                           int pixelwidth,
                           int pixelheight,
                           long left,
@@ -284,6 +451,18 @@ public:
                           long cell_width,
                           long cell_height) /* throws */;
 
+        auto provisional_image() const noexcept { return m_provisional_image.get(); }
+
+        void set_provisional_image(vte::Freeable<cairo_surface_t> surface,
+                                   int pixelwidth,
+                                   int pixelheight,
+                                   long left,
+                                   long top,
+                                   long cell_width,
+                                   long cell_height) /* throws */;
+
+        void drop_provisional_image() noexcept;
+
 
 #endif /* WITH_SIXEL */
 };
@@ -17,6 +17,8 @@
 
 #include <config.h>
 
+#include <algorithm>
+
 #include "bidi.hh"
 #include "debug.hh"
 #include "vtedefines.hh"
@@ -52,21 +54,28 @@ RingView::pause()
 
         _vte_debug_print (vte::debug::category::RINGVIEW,
                           "Ringview: pause, freeing {} rows, {} bidirows",
-                          m_rows_alloc_len,
+                          m_row_copies_alloc_len,
                           m_bidirows_alloc_len);
 
-        for (i = 0; i < m_rows_alloc_len; i++) {
-                _vte_row_data_fini(m_rows[i]);
-                g_free (m_rows[i]);
+        for (i = 0; i < m_row_copies_alloc_len; i++) {
+                _vte_row_data_fini(m_row_copies[i]);
+                g_free (m_row_copies[i]);
         }
-        g_free (m_rows);
-        m_rows_alloc_len = 0;
+        g_free (m_row_copies);
+        m_row_copies_alloc_len = 0;
 
         for (i = 0; i < m_bidirows_alloc_len; i++) {
                 delete m_bidirows[i];
         }
         g_free (m_bidirows);
         m_bidirows_alloc_len = 0;
+        m_bidirow_keys = {};
+
+        m_rows = {};
+        m_row_ids = {};
+        m_paragraphs = {};
+        m_prev_row_ids = {};
+        m_prev_paragraphs = {};
 
         m_invalid = true;
         m_paused = true;
@@ -80,11 +89,11 @@ RingView::resume()
 
         /* +16: A bit of arbitrary heuristics to likely prevent a quickly following
          * realloc for the required context lines. */
-        m_rows_alloc_len = m_len + 16;
-        m_rows = (VteRowData **) g_malloc (sizeof (VteRowData *) * m_rows_alloc_len);
-        for (int i = 0; i < m_rows_alloc_len; i++) {
-                m_rows[i] = (VteRowData *) g_malloc (sizeof (VteRowData));
-                _vte_row_data_init (m_rows[i]);
+        m_row_copies_alloc_len = m_len + 16;
+        m_row_copies = (VteRowData **) g_malloc (sizeof (VteRowData *) * m_row_copies_alloc_len);
+        for (int i = 0; i < m_row_copies_alloc_len; i++) {
+                m_row_copies[i] = (VteRowData *) g_malloc (sizeof (VteRowData));
+                _vte_row_data_init (m_row_copies[i]);
         }
 
         /* +2: Likely prevent a quickly following realloc.
@@ -97,15 +106,25 @@ RingView::resume()
         for (int i = 0; i < m_bidirows_alloc_len; i++) {
                 m_bidirows[i] = new BidiRow();
         }
+        m_bidirow_keys.assign(m_bidirows_alloc_len, {});
 
         _vte_debug_print (vte::debug::category::RINGVIEW,
                           "Ringview: resume, allocating {} rows, {} bidirows",
-                          m_rows_alloc_len,
+                          m_row_copies_alloc_len,
                           m_bidirows_alloc_len);
 
         m_paused = false;
 }
 
+/* Drops the paragraphs of the previous update, so that the next one
+ * recomputes everything. */
+void
+RingView::forget_paragraphs() noexcept
+{
+        m_prev_paragraphs.clear();
+        m_prev_row_ids.clear();
+}
+
 void
 RingView::set_ring(Ring *ring)
 {
@@ -113,6 +132,7 @@ RingView::set_ring(Ring *ring)
                 return;
 
         m_ring = ring;
+        forget_paragraphs();
         m_invalid = true;
 }
 
@@ -123,6 +143,7 @@ RingView::set_width(vte::grid::column_t width)
                 return;
 
         m_width = width;
+        forget_paragraphs();
         m_invalid = true;
 }
 
@@ -157,6 +178,9 @@ RingView::set_rows(vte::grid::row_t start, vte::grid::row_t len)
                 for (; i < m_bidirows_alloc_len; i++) {
                         m_bidirows[i] = new BidiRow();
                 }
+
+                /* The rows map to different BidiRows now */
+                m_bidirow_keys.assign(m_bidirows_alloc_len, {});
         }
 
         m_start = start;
@@ -169,6 +193,7 @@ RingView::get_row(vte::grid::row_t row) const
 {
         vte_assert_cmpint(row, >=, m_top);
         vte_assert_cmpint(row, <, m_top + m_rows_len);
+        vte_assert_true(m_rows[row - m_top] != nullptr);
 
         return m_rows[row - m_top];
 }
@@ -180,6 +205,7 @@ RingView::set_enable_bidi(bool enable_bidi)
                 return;
 
         m_enable_bidi = enable_bidi;
+        forget_paragraphs();
         m_invalid = true;
 }
 
@@ -190,9 +216,110 @@ RingView::set_enable_shaping(bool enable_shaping)
                 return;
 
         m_enable_shaping = enable_shaping;
+        forget_paragraphs();
         m_invalid = true;
 }
 
+/* Returns a value that identifies the contents of @row as long as the Ring's
+ * generation and frozen generation don't change: the modification serial
+ * for writable rows, 0 for frozen rows which never change, and yet another
+ * value for rows that don't exist (yet). */
+uint64_t
+RingView::row_id(vte::grid::row_t row) const noexcept
+{
+        if (!m_ring->contains(row))
+                return G_MAXUINT64;
+
+        return m_ring->row_serial(row);
+}
+
+/* Returns whether @paragraph consists of the same rows with the same contents
+ * as one of the previous update, and the mapping of its visible rows is still
+ * around. If so, sets @paragraph's seq to the update that computed it. */
+bool
+RingView::paragraph_unchanged(Paragraph& paragraph) const noexcept
+{
+        auto const it = std::lower_bound(m_prev_paragraphs.begin(), m_prev_paragraphs.end(),
+                                         paragraph.start,
+                                         [](Paragraph const& p, vte::grid::row_t start) { return p.start < start; });
+        if (it == m_prev_paragraphs.end() ||
+            it->start != paragraph.start ||
+            it->end != paragraph.end)
+                return false;
+
+        /* All rows of the previous paragraph were extracted back then */
+        for (auto row = paragraph.start; row < paragraph.end; row++) {
+                if (m_row_ids[row - m_top] != m_prev_row_ids[row - m_prev_top])
+                        return false;
+        }
+
+        /* Rows that only were context rows back then don't have their mapping */
+        auto const first = std::max(paragraph.start, m_start);
+        auto const last = std::min(paragraph.end, m_start + m_len);
+        for (auto row = first; row < last; row++) {
+                auto const& key = m_bidirow_keys[bidirow_index(row)];
+                if (key.row != row || key.seq != it->seq)
+                        return false;
+        }
+
+        paragraph.seq = it->seq;
+        return true;
+}
+
+/* Returns the data of @row for the BiDi code. Rows in the writable area
+ * are used in place; rows read back from the stream, missing rows, and
+ * rows that need clipping are copied. */
+VteRowData const*
+RingView::extract_row(vte::grid::row_t row)
+{
+        auto const row_data = m_ring->contains(row) ? m_ring->index(row) : nullptr;
+        if (G_LIKELY (row_data != nullptr &&
+                      row >= m_ring->writable() &&
+                      _vte_row_data_length(row_data) <= m_width))
+                return row_data;
+
+        auto const i = int(row - m_top);
+        if (G_UNLIKELY (i >= m_row_copies_alloc_len)) {
+                int j = m_row_copies_alloc_len;
+                while (i >= m_row_copies_alloc_len) {
+                        /* Don't realloc too aggressively. */
+                        m_row_copies_alloc_len = std::max(m_row_copies_alloc_len + 1, m_row_copies_alloc_len * 5 / 4 /* whatever */);
+                }
+                _vte_debug_print (vte::debug::category::RINGVIEW,
+                                  "Ringview: reallocate to {} rows",
+                                  m_row_copies_alloc_len);
+                m_row_copies = (VteRowData **) g_realloc (m_row_copies, sizeof (VteRowData *) * m_row_copies_alloc_len);
+                for (; j < m_row_copies_alloc_len; j++) {
+                        m_row_copies[j] = (VteRowData *) g_malloc (sizeof (VteRowData));
+                        _vte_row_data_init (m_row_copies[j]);
+                }
+        }
+
+        auto const copy = m_row_copies[i];
+        if (row_data == nullptr) {
+                _vte_row_data_clear (copy);
+                return copy;
+        }
+
+        _vte_row_data_copy (row_data, copy);
+        /* Make sure that the extracted data is not wider than the screen,
+         * something that can happen if the window was narrowed with rewrapping disabled.
+         * Also make sure that we won't end up with unfinished characters.
+         * FIXME remove this once bug 135 is addressed. */
+        if (G_UNLIKELY (_vte_row_data_length(copy) > m_width)) {
+                int j = m_width;
+                while (j > 0) {
+                        VteCell const* cell = _vte_row_data_get(copy, j);
+                        if (!cell->attr.fragment())
+                                break;
+                        j--;
+                }
+                _vte_row_data_shrink(copy, j);
+        }
+
+        return copy;
+}
+
 void
 RingView::update()
 {
@@ -201,6 +328,13 @@ RingView::update()
         if (m_paused)
                 resume();
 
+        if (m_ring->generation() != m_ring_generation ||
+            m_ring->frozen_generation() != m_ring_frozen_generation) {
+                forget_paragraphs();
+                m_ring_generation = m_ring->generation();
+                m_ring_frozen_generation = m_ring->frozen_generation();
+        }
+
         /* Find the beginning of the topmost paragraph.
          *
          * Extract at most VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX context rows.
@@ -209,7 +343,6 @@ RingView::update()
          * than VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX lines, and thus the
          * BiDi code will skip it. */
         vte::grid::row_t row = m_start;
-        const VteRowData *row_data;
 
         _vte_debug_print (vte::debug::category::RINGVIEW,
                           "Ringview: updating for [{}..{}] ({} rows)",
@@ -224,7 +357,8 @@ RingView::update()
                 row--;
         }
 
-        /* Extract the data beginning at the found row.
+        /* Walk the rows beginning at the found row, collecting their
+         * identities and the paragraphs they form.
          *
          * Extract at most VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX rows
          * beyond the end of the specified area. Again, if this safety
@@ -233,73 +367,66 @@ RingView::update()
          * VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX lines, and thus the
          * BiDi code will skip it. */
         m_top = row;
-        m_rows_len = 0;
+        m_row_ids.clear();
+        m_paragraphs.clear();
+        auto top = row;
         while (row < m_start + m_len + VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX) {
-                if (G_UNLIKELY (m_rows_len == m_rows_alloc_len)) {
-                        /* Don't realloc too aggressively. */
-                        m_rows_alloc_len = std::max(m_rows_alloc_len + 1, m_rows_alloc_len * 5 / 4 /* whatever */);
-                        _vte_debug_print (vte::debug::category::RINGVIEW,
-                                          "Ringview: reallocate to {} rows",
-                                          m_rows_alloc_len);
-                        m_rows = (VteRowData **) g_realloc (m_rows, sizeof (VteRowData *) * m_rows_alloc_len);
-                        for (int j = m_rows_len; j < m_rows_alloc_len; j++) {
-                                m_rows[j] = (VteRowData *) g_malloc (sizeof (VteRowData));
-                                _vte_row_data_init (m_rows[j]);
-                        }
-                }
-
-                row_data = m_ring->contains(row) ? m_ring->index(row) : nullptr;
-                if (G_LIKELY (row_data != nullptr)) {
-                        _vte_row_data_copy (row_data, m_rows[m_rows_len]);
-                        /* Make sure that the extracted data is not wider than the screen,
-                         * something that can happen if the window was narrowed with rewrapping disabled.
-                         * Also make sure that we won't end up with unfinished characters.
-                         * FIXME remove this once bug 135 is addressed. */
-                        if (G_UNLIKELY (_vte_row_data_length(m_rows[m_rows_len]) > m_width)) {
-                                int j = m_width;
-                                while (j > 0) {
-                                        VteCell const* cell = _vte_row_data_get(m_rows[m_rows_len], j);
-                                        if (!cell->attr.fragment())
-                                                break;
-                                        j--;
-                                }
-                                _vte_row_data_shrink(m_rows[m_rows_len], j);
-                        }
-                } else {
-                        _vte_row_data_clear (m_rows[m_rows_len]);
-                }
-                m_rows_len++;
+                m_row_ids.push_back(row_id(row));
+                auto const soft_wrapped = m_ring->is_soft_wrapped(row);
                 row++;
 
-                /* Once the bottom of the specified area is reached, stop at a hard newline. */
-                if (row >= m_start + m_len && (!row_data || !row_data->attr.soft_wrapped))
-                        break;
+                if (!soft_wrapped) {
+                        m_paragraphs.push_back(Paragraph{top, row, 0});
+                        top = row;
+
+                        /* Once the bottom of the specified area is reached, stop at a hard newline. */
+                        if (row >= m_start + m_len)
+                                break;
+                }
         }
+        if (top < row)
+                m_paragraphs.push_back(Paragraph{top, row, 0});
+        m_rows_len = int(m_row_ids.size());
 
         _vte_debug_print (vte::debug::category::RINGVIEW,
                           "Ringview: extracted {}+{} context lines: [{}..{}] ({} rows)",
                           m_start - m_top, (m_top + m_rows_len) - (m_start + m_len),
                           m_top, m_top + m_rows_len - 1, m_rows_len);
 
-        /* Loop through paragraphs of the extracted text, and do whatever we need to do on each paragraph. */
-        auto top = m_top;
-        row = top;
-        while (row < m_top + m_rows_len) {
-                row_data = m_rows[row - m_top];
-                if (!row_data->attr.soft_wrapped || row == m_top + m_rows_len - 1) {
-                        /* Found a paragraph from @top to @row, inclusive. */
+        /* Loop through the paragraphs, and do whatever we need to do on each
+         * paragraph that changed since the previous update. */
+        m_seq++;
+        m_rows.assign(m_rows_len, nullptr);
+        auto n_computed = 0;
+        for (auto& paragraph : m_paragraphs) {
+                if (paragraph_unchanged(paragraph))
+                        continue;
 
-                        /* Run the BiDi algorithm. */
-                        m_bidirunner->paragraph(top, row + 1,
-                                                m_enable_bidi, m_enable_shaping);
+                for (row = paragraph.start; row < paragraph.end; row++)
+                        m_rows[row - m_top] = extract_row(row);
 
-                        /* Doing syntax highlighting etc. come here in the future. */
+                /* Run the BiDi algorithm. */
+                m_bidirunner->paragraph(paragraph.start, paragraph.end,
+                                        m_enable_bidi, m_enable_shaping);
 
-                        top = row + 1;
-                }
-                row++;
+                /* Doing syntax highlighting etc. come here in the future. */
+
+                paragraph.seq = m_seq;
+                auto const last = std::min(paragraph.end, m_start + m_len);
+                for (row = std::max(paragraph.start, m_start); row < last; row++)
+                        m_bidirow_keys[bidirow_index(row)] = BidiRowKey{row, m_seq};
+
+                n_computed++;
         }
 
+        _vte_debug_print (vte::debug::category::RINGVIEW,
+                          "Ringview: recomputed {} of {} paragraphs",
+                          n_computed, m_paragraphs.size());
+
+        std::swap(m_row_ids, m_prev_row_ids);
+        std::swap(m_paragraphs, m_prev_paragraphs);
+        m_prev_top = m_top;
+
         m_invalid = false;
 }
 
@@ -310,5 +437,5 @@ BidiRow* RingView::get_bidirow_writable(vte::grid::row_t row) const
         if (row < m_start || row >= m_start + m_len)
                 return nullptr;
 
-        return m_bidirows[row - m_start];
+        return m_bidirows[bidirow_index(row)];
 }
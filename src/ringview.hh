@@ -19,6 +19,9 @@
 
 #include <glib.h>
 
+#include <memory>
+#include <vector>
+
 #include "bidi.hh"
 #include "ring.hh"
 #include "vterowdata.hh"
@@ -47,6 +50,10 @@ class BidiRunner;
  * Currently RingView is used for BiDi: to figure out which logical character is
  * mapped to which visual position.
  *
+ * The rows are not copied out of the Ring unless they need to be (i.e. they are
+ * read back from the stream), and only the paragraphs whose rows changed since
+ * the previous update are run through BiDi again; the others keep their mapping.
+ *
  * Future possible uses include "highlight all" for the search match, and
  * syntax highlighting. URL autodetection might also be ported to this
  * infrastructure one day.
@@ -86,19 +93,50 @@ public:
                 vte_assert_false (m_invalid);
                 vte_assert_false (m_paused);
 
-                return m_bidirows[row - m_start];
+                return m_bidirows[bidirow_index(row)];
         }
 
 private:
+        /* A paragraph of the extracted rows, from @start to @end (exclusive),
+         * whose BiDi mapping was computed in the update numbered @seq. */
+        struct Paragraph {
+                vte::grid::row_t start;
+                vte::grid::row_t end;
+                uint64_t seq;
+        };
+
+        /* Which row's mapping a BidiRow holds, and from which update */
+        struct BidiRowKey {
+                vte::grid::row_t row{-1};
+                uint64_t seq{0};
+        };
+
         Ring *m_ring{nullptr};
 
-        VteRowData **m_rows{nullptr};
+        /* The rows of the paragraphs being (re)computed, indexed from m_top.
+         * These point into the Ring where possible, or to one of m_row_copies
+         * for rows that had to be thawed from the stream or clipped. */
+        std::vector<VteRowData const*> m_rows{};
         int m_rows_len{0};
-        int m_rows_alloc_len{0};
+
+        VteRowData **m_row_copies{nullptr};
+        int m_row_copies_alloc_len{0};
+
+        /* The row identities (see row_id()) and paragraphs of the previous
+         * update, from m_prev_top on, and the ones being built by this one */
+        std::vector<uint64_t> m_row_ids{}, m_prev_row_ids{};
+        std::vector<Paragraph> m_paragraphs{}, m_prev_paragraphs{};
+        vte::grid::row_t m_prev_top{0};
+        uint64_t m_seq{0};
+
+        /* The Ring state the previous paragraphs are valid for */
+        uint64_t m_ring_generation{0};
+        uint64_t m_ring_frozen_generation{0};
 
         bool m_enable_bidi{true};      /* These two are the most convenient defaults */
         bool m_enable_shaping{false};  /* for short-lived ringviews. */
         BidiRow **m_bidirows{nullptr};
+        std::vector<BidiRowKey> m_bidirow_keys{};
         int m_bidirows_alloc_len{0};
 
         std::unique_ptr<BidiRunner> m_bidirunner;
@@ -113,6 +151,19 @@ private:
         bool m_paused{true};
 
         void resume();
+        void forget_paragraphs() noexcept;
+
+        /* The BidiRows are indexed by the row modulo their number, so that
+         * they stay in place when the view scrolls. */
+        inline int bidirow_index(vte::grid::row_t row) const noexcept
+        {
+                auto const n = vte::grid::row_t(m_bidirows_alloc_len);
+                return int(((row % n) + n) % n);
+        }
+
+        uint64_t row_id(vte::grid::row_t row) const noexcept;
+        bool paragraph_unchanged(Paragraph& paragraph) const noexcept;
+        VteRowData const* extract_row(vte::grid::row_t row);
 
         BidiRow* get_bidirow_writable(vte::grid::row_t row) const;
 };
@@ -20,8 +20,10 @@
 #include "sixel-context.hh"
 
 #include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 
 #if VTE_DEBUG
 #include "debug.hh"
@@ -345,14 +347,58 @@ Context::prepare(int id,
         ensure_scanline();
 }
 
+/* Converts the first @h rows of the scanline at @scanline, consisting of
+ * @columns columns of six interleaved colour indices, into the rows at
+ * @wdata that are @wstride items apart, and fills the rest of each row
+ * up to @wstride with the background.
+ *
+ * The scanline is processed in blocks of columns, so that both the reads
+ * from the scanline and the sequential writes to the @h rows stay in the
+ * L1 cache. The inner loop has no dependencies between its iterations so
+ * that the compiler can vectorise the strided reads and the palette lookup
+ * (with gathers or shuffles, depending on the target).
+ */
+template<typename C,
+         typename P>
+static inline void
+convert_scanline(C* wdata,
+                 size_t wstride,
+                 Context::color_index_t const* scanline,
+                 size_t columns,
+                 unsigned h,
+                 P&& pen) noexcept
+{
+        constexpr auto const block = size_t{128};
+
+        for (auto x0 = size_t{0}; x0 < columns; x0 += block) {
+                auto const n_columns = std::min(block, columns - x0);
+                auto const src = scanline + x0 * 6;
+
+                for (auto n = 0u; n < h; ++n) {
+                        auto const dst = wdata + n * wstride + x0;
+                        for (auto x = size_t{0}; x < n_columns; ++x)
+                                dst[x] = pen(src[x * 6 + n]);
+                }
+        }
+
+        /* Clear leftover space */
+        if (columns < wstride) {
+                auto const bg = pen(0);
+                for (auto n = 0u; n < h; ++n)
+                        std::fill(&wdata[n * wstride + columns],
+                                  &wdata[(n + 1) * wstride],
+                                  bg);
+        }
+}
+
 template<typename C,
          typename P>
 inline C*
 Context::image_data(size_t* size,
                     unsigned stride,
+                    unsigned height,
                     P pen) noexcept
 {
-        auto const height = image_height();
         auto const width = image_width();
         if (height == 0 || width == 0 || !m_scanlines_data)
                 return nullptr;
@@ -364,14 +410,9 @@ Context::image_data(size_t* size,
         if (!wdata)
                 return nullptr;
 
-        /* FIXMEchpe: this can surely be optimised, perhaps using SIMD, and
-         * being more cache-friendly.
-         */
-
         assert((stride % sizeof(C)) == 0);
         auto wstride = stride / sizeof(C);
         assert(wstride >= width);
-        // auto wdata_end = wdata + wstride * height;
 
         /* There may be one scanline at the bottom that extends below the image's height,
          * and needs to be handled specially. First convert all the full scanlines, then
@@ -385,57 +426,24 @@ Context::image_data(size_t* size,
              ++scanlines_offsets_pos, wdata_pos += 6 * wstride, y += 6) {
                 auto const scanline_begin = m_scanlines_data.get() + scanlines_offsets_pos[0];
                 auto const scanline_end = m_scanlines_data.get() + scanlines_offsets_pos[1];
-                auto x = 0u;
-                for (auto scanline_pos = scanline_begin; scanline_pos < scanline_end; ++x) {
-                        for (auto n = 0; n < 6; ++n) {
-                                wdata_pos[n * wstride + x] = pen(*scanline_pos++);
-                        }
-                }
-
-                /* Clear leftover space */
-                if (x < wstride) {
-                        auto const bg = pen(0);
-                        for (auto n = 0; n < 6; ++n) {
-                                std::fill(&wdata_pos[n * wstride + x],
-                                          &wdata_pos[(n + 1) * wstride],
-                                          bg);
-                        }
-                }
+                convert_scanline(wdata_pos, wstride,
+                                 scanline_begin, size_t(scanline_end - scanline_begin) / 6,
+                                 6, pen);
         }
 
         if (y < height && (y + 6) > height &&
             (scanlines_offsets_pos + 1) < scanlines_offsets_end()) {
-                auto const h = height - y;
                 auto const scanline_begin = m_scanlines_data.get() + scanlines_offsets_pos[0];
                 auto const scanline_end = m_scanlines_data.get() + scanlines_offsets_pos[1];
-                auto x = 0u;
-                for (auto scanline_pos = scanline_begin; scanline_pos < scanline_end; ++x) {
-                        for (auto n = 0u; n < h; ++n) {
-                                wdata_pos[n * wstride + x] = pen(*scanline_pos++);
-                        }
-
-                        scanline_pos += 6 - h;
-                }
-
-                /* Clear leftover space */
-                if (x < wstride) {
-                        auto const bg = pen(0);
-                        for (auto n = 0u; n < h; ++n) {
-                                std::fill(&wdata_pos[n * wstride + x],
-                                          &wdata_pos[(n + 1) * wstride],
-                                          bg);
-                        }
-                }
+                convert_scanline(wdata_pos, wstride,
+                                 scanline_begin, size_t(scanline_end - scanline_begin) / 6,
+                                 height - y, pen);
         }
 
-        /* We drop the scanlines buffer here if it's bigger than the default buffer size,
-         * so that parsing a big image doesn't retain the large buffer forever.
+        /* Note that this keeps the scanlines buffer, since the image may be
+         * converted while it is still being received; reset() drops it if it
+         * is bigger than the default buffer size.
          */
-        if (m_scanlines_data_capacity > minimum_capacity()) {
-                m_scanlines_data.reset();
-                m_scanlines_data_capacity = 0;
-        }
-
         return wdata.release();
 }
 
@@ -446,25 +454,150 @@ Context::image_data_indexed(size_t* size,
 {
         return image_data<color_index_t>(size,
                                          (image_width() + extra_width_stride) * sizeof(color_index_t),
+                                         image_height(),
                                          [](color_index_t pen) constexpr noexcept -> color_index_t { return pen; });
 }
 
+// This is only used in the test suite
+Context::color_t*
+Context::image_data_colors(size_t* size,
+                           unsigned extra_width_stride) noexcept
+{
+        return image_data<color_t>(size,
+                                   (image_width() + extra_width_stride) * sizeof(color_t),
+                                   image_height(),
+                                   [&](color_index_t pen) constexpr noexcept -> color_t { return m_colors[pen]; });
+}
+
+/* A fast non-cryptographic hash with 128 bits of state, built from
+ * two independent lanes of the xxHash64 round function. It is only used
+ * to recognise repeated images, see Context::image_hash().
+ */
+class ContentHasher {
+public:
+        void
+        update(void const* data,
+               size_t size) noexcept
+        {
+                auto p = reinterpret_cast<uint8_t const*>(data);
+                m_length += size;
+
+                for (; size >= sizeof(uint64_t); p += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+                        auto word = uint64_t{};
+                        std::memcpy(&word, p, sizeof(word));
+                        mix(word);
+                }
+
+                /* The tail is zero-padded; the total length is mixed in at the end */
+                if (size) {
+                        auto word = uint64_t{};
+                        std::memcpy(&word, p, size);
+                        mix(word);
+                }
+        }
+
+        template<typename T>
+        inline void
+        update(T const& value) noexcept
+        {
+                update(&value, sizeof(value));
+        }
+
+        std::array<uint64_t, 2>
+        finish() const noexcept
+        {
+                return {avalanche(m_a ^ m_length), avalanche(m_b + m_length)};
+        }
+
+private:
+        static inline constexpr uint64_t const k_prime1 = 0x9e3779b185ebca87ull;
+        static inline constexpr uint64_t const k_prime2 = 0xc2b2ae3d27d4eb4full;
+        static inline constexpr uint64_t const k_prime3 = 0x165667b19e3779f9ull;
+
+        uint64_t m_a{k_prime1};
+        uint64_t m_b{k_prime2};
+        uint64_t m_length{0};
+
+        inline void
+        mix(uint64_t word) noexcept
+        {
+                m_a = std::rotl(m_a + word * k_prime2, 31) * k_prime1;
+                m_b = std::rotl(m_b ^ (word * k_prime3), 29) * k_prime2;
+        }
+
+        static inline constexpr uint64_t
+        avalanche(uint64_t h) noexcept
+        {
+                h ^= h >> 33;
+                h *= k_prime2;
+                h ^= h >> 29;
+                h *= k_prime3;
+                h ^= h >> 32;
+                return h;
+        }
+};
+
+/*
+ * Context::image_hash:
+ *
+ * Hashes the image's dimensions, colours and indexed pixel data. This is
+ * much cheaper than converting the image with image_data(), so that an
+ * image that is drawn repeatedly can be recognised before doing that work.
+ */
+std::array<uint64_t, 2>
+Context::image_hash() const noexcept
+{
+        auto hasher = ContentHasher{};
+
+        auto const height = image_height();
+        auto const width = image_width();
+        hasher.update(height);
+        hasher.update(width);
+        hasher.update(m_colors, sizeof(m_colors));
+
+        if (height == 0 || width == 0 || !m_scanlines_data)
+                return hasher.finish();
+
+        /* Hash the same scanlines that image_data() converts */
+        auto y = 0u;
+        for (auto scanlines_offsets_pos = std::begin(m_scanlines_offsets);
+             (scanlines_offsets_pos + 1) < scanlines_offsets_end() && y < height;
+             ++scanlines_offsets_pos, y += 6) {
+                auto const scanline_begin = m_scanlines_data.get() + scanlines_offsets_pos[0];
+                auto const scanline_end = m_scanlines_data.get() + scanlines_offsets_pos[1];
+                auto const size = size_t(scanline_end - scanline_begin) * sizeof(color_index_t);
+                hasher.update(size);
+                hasher.update(scanline_begin, size);
+        }
+
+        return hasher.finish();
+}
+
 #ifdef VTE_COMPILATION
 
 uint8_t*
-Context::image_data() noexcept
+Context::image_data(unsigned height) noexcept
 {
         return reinterpret_cast<uint8_t*>(image_data<color_t>(nullptr,
                                                               cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, image_width()),
+                                                              height,
                                                               [&](color_index_t pen) constexpr noexcept -> color_t { return m_colors[pen]; }));
 }
 
+/*
+ * Context::image_cairo:
+ * @height: the height of the image to convert
+ *
+ * Converts the first @height rows of the image to a cairo surface. Use
+ * complete_height() for @height to get the part of an image that is still
+ * being received that is complete so far.
+ */
 vte::Freeable<cairo_surface_t>
-Context::image_cairo() noexcept
+Context::image_cairo(unsigned height) noexcept
 {
         static cairo_user_data_key_t s_data_key;
 
-        auto data = image_data();
+        auto data = image_data(height);
         if (!data)
                 return nullptr;
 
@@ -472,7 +605,7 @@ Context::image_cairo() noexcept
         auto surface = vte::take_freeable(cairo_image_surface_create_for_data(data,
                                                                               CAIRO_FORMAT_ARGB32,
                                                                               image_width(),
-                                                                              image_height(),
+                                                                              height,
                                                                               stride));
 
 #if VTE_DEBUG
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <array>
 #include <bit>
 #include <cstdint>
 #include <iterator>
@@ -93,6 +94,14 @@ public:
                 return std::max(m_height, m_raster_height);
         }
 
+        /* The height of the scanlines that have been completed so far,
+         * while the image is still being received.
+         */
+        constexpr auto complete_height() const noexcept
+        {
+                return std::min(image_height(), scanlines_count() * 6);
+        }
+
 private:
 
         color_t m_colors[2 + k_num_colors];
@@ -335,6 +344,7 @@ private:
                  typename P>
         inline C* image_data(size_t* size,
                              unsigned stride,
+                             unsigned height,
                              P pen) noexcept;
 
         void
@@ -647,15 +657,20 @@ public:
 
         void reset() noexcept;
 
-        uint8_t* image_data() noexcept;
+        std::array<uint64_t, 2> image_hash() const noexcept;
+
+        uint8_t* image_data(unsigned height) noexcept;
 
         // These are only used in the test suite
         color_index_t* image_data_indexed(size_t* size = nullptr,
                                           unsigned extra_width_stride = 0) noexcept;
+        color_t* image_data_colors(size_t* size = nullptr,
+                                   unsigned extra_width_stride = 0) noexcept;
         auto color(unsigned idx) const noexcept { return m_colors[idx]; }
 
 #ifdef VTE_COMPILATION
-        vte::Freeable<cairo_surface_t> image_cairo() noexcept;
+        vte::Freeable<cairo_surface_t> image_cairo(unsigned height) noexcept;
+        vte::Freeable<cairo_surface_t> image_cairo() noexcept { return image_cairo(image_height()); }
 #endif
 
         void
@@ -684,4 +699,55 @@ public:
 
 }; // class Context
 
+/*
+ * Progress:
+ *
+ * Decides when to show the part of an image that has been received so far,
+ * see Terminal::update_progressive_image(). Times are in microseconds.
+ */
+class Progress {
+private:
+        int64_t m_interval;
+        int64_t m_time{0};
+        unsigned m_height{0};
+
+public:
+        constexpr explicit Progress(int64_t interval) noexcept
+                : m_interval{interval}
+        {
+        }
+
+        /* Starts a new image at @now */
+        constexpr void begin(int64_t now) noexcept
+        {
+                m_height = 0;
+                m_time = now;
+        }
+
+        /* Returns whether to show the completed @height pixel rows of the
+         * image at @now, instead of the part shown so far. This is the case
+         * when more rows have been completed and the last update is at least
+         * the interval ago.
+         */
+        constexpr bool update(unsigned height,
+                              int64_t now) noexcept
+        {
+                if (height <= m_height || now - m_time < m_interval)
+                        return false;
+
+                m_height = height;
+                m_time = now;
+                return true;
+        }
+
+        /* Returns the height of the part shown, or 0 if none, and forgets
+         * it; call this when the image is complete or aborted.
+         */
+        constexpr unsigned finish() noexcept { return std::exchange(m_height, 0); }
+
+        /* The height of the part shown, or 0 if none */
+        constexpr auto height() const noexcept { return m_height; }
+
+}; // class Progress
+
 } // namespace vte::sixel
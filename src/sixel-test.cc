@@ -28,6 +28,8 @@
 
 #include <glib.h>
 
+#include <fmt/format.h>
+
 #include "sixel-parser.hh"
 #include "sixel-context.hh"
 
@@ -37,6 +39,7 @@ using Command = vte::sixel::Command;
 using Context = vte::sixel::Context;
 using Mode = vte::sixel::Parser::Mode;
 using ParseStatus = vte::sixel::Parser::ParseStatus;
+using Progress = vte::sixel::Progress;
 
 // Parser tests
 
@@ -1391,6 +1394,107 @@ test_context_scanlines_underfull(void)
         }
 }
 
+static void
+test_context_scanlines_complete(void)
+{
+        /* Test that complete_height() only counts the scanlines that have
+         * been terminated, while the image is still being received.
+         */
+
+        auto context = TestContext{};
+        context.reset();
+        context.prepare(-1, /* no ID */
+                        0x50 /* C0 DCS */,
+                        0xffu, 0xffu, 0xffu,
+                        0u, 0u, 0u,
+                        false /* bg transparent */,
+                        true /* private color registers */);
+
+        auto feed = [&](std::string_view const& str) {
+                auto const beginptr = reinterpret_cast<uint8_t const*>(str.data());
+                auto const endptr = reinterpret_cast<uint8_t const*>(beginptr + str.size());
+                auto [status, ip] = context.Context::parse(beginptr, endptr, false);
+                g_assert_cmpint(int(status), ==, int(ParseStatus::CONTINUE));
+        };
+
+        feed("~~"sv);
+        g_assert_cmpuint(context.complete_height(), ==, 0);
+
+        feed("-~~"sv);
+        g_assert_cmpuint(context.complete_height(), ==, 6);
+
+        feed("-~"sv);
+        g_assert_cmpuint(context.complete_height(), ==, 12);
+
+        /* A partly set last complete scanline counts with its set rows only */
+        feed("-@"sv);
+        g_assert_cmpuint(context.complete_height(), ==, 18);
+        feed("-"sv);
+        g_assert_cmpuint(context.complete_height(), ==, 18 + 1);
+}
+
+static void
+test_context_progress(void)
+{
+        /* Test that the part of the image received so far is only shown
+         * again after the interval, and once more scanlines are complete;
+         * and that it is replaced once the image is complete.
+         */
+
+        auto context = TestContext{};
+        context.reset();
+        context.prepare(-1, /* no ID */
+                        0x50 /* C0 DCS */,
+                        0xffu, 0xffu, 0xffu,
+                        0u, 0u, 0u,
+                        false /* bg transparent */,
+                        true /* private color registers */);
+
+        auto feed = [&](std::string_view const& str) {
+                auto const beginptr = reinterpret_cast<uint8_t const*>(str.data());
+                auto const endptr = reinterpret_cast<uint8_t const*>(beginptr + str.size());
+                auto [status, ip] = context.Context::parse(beginptr, endptr, false);
+                g_assert_cmpint(int(status), ==, int(ParseStatus::CONTINUE));
+        };
+
+        auto progress = Progress{100};
+        progress.begin(1000);
+
+        /* Nothing completed yet */
+        feed("~~"sv);
+        g_assert_false(progress.update(context.complete_height(), 2000));
+        g_assert_cmpuint(progress.height(), ==, 0);
+
+        /* Completed, but too soon */
+        feed("-"sv);
+        g_assert_false(progress.update(context.complete_height(), 1050));
+        g_assert_cmpuint(progress.height(), ==, 0);
+
+        g_assert_true(progress.update(context.complete_height(), 1100));
+        g_assert_cmpuint(progress.height(), ==, 6);
+
+        /* Nothing more completed */
+        feed("~~"sv);
+        g_assert_false(progress.update(context.complete_height(), 5000));
+        g_assert_cmpuint(progress.height(), ==, 6);
+
+        /* The interval counts from the last update */
+        feed("-~-"sv);
+        g_assert_false(progress.update(context.complete_height(), 1199));
+        g_assert_true(progress.update(context.complete_height(), 1200));
+        g_assert_cmpuint(progress.height(), ==, 18);
+
+        /* On completion, the part shown is replaced exactly once */
+        g_assert_cmpuint(progress.finish(), ==, 18);
+        g_assert_cmpuint(progress.height(), ==, 0);
+        g_assert_cmpuint(progress.finish(), ==, 0);
+
+        /* A new image starts from scratch */
+        progress.begin(10000);
+        g_assert_false(progress.update(6, 10050));
+        g_assert_true(progress.update(6, 10100));
+}
+
 static void
 test_context_scanlines_max_width(void)
 {
@@ -1572,6 +1676,123 @@ test_context_image_compositing(void)
         g_assert_cmpuint(size_t(data - pixels.get()), <=, size);
 }
 
+/* Returns a sixel image of @width columns with @scanlines full scanlines
+ * and a partial one of three rows, made of random runs in random colours.
+ */
+static std::string
+random_image(unsigned width,
+             unsigned scanlines)
+{
+        auto str = std::string{};
+        for (auto n = 0u; n <= scanlines; ++n) {
+                auto const last = n == scanlines;
+                for (auto x = 0u; x < width; ) {
+                        auto const run = std::min(unsigned(g_test_rand_int_range(1, 16)), width - x);
+                        auto const sixel = last ? g_test_rand_int_range(0b1, 0b1000)
+                                                : g_test_rand_int_range(0, 0b100'0000);
+                        str.append(fmt::format("#{}!{}{:c}",
+                                               g_test_rand_int_range(0, 16),
+                                               run,
+                                               char(0x3f + sixel)));
+                        x += run;
+                }
+
+                if (!last)
+                        str.push_back('-');
+        }
+
+        return str;
+}
+
+static void
+test_context_image_colors(void)
+{
+        /* Test that converting to colours resolves each pixel of the indexed
+         * image, including the stride padding and a partial last scanline,
+         * for a width that is not a multiple of the conversion's block size.
+         */
+
+        auto context = TestContext{};
+        auto const str = random_image(300, 20);
+        auto const extra_stride = 5u;
+
+        auto [indexed, indexed_size] = parse_pixels(context, str, extra_stride);
+        assert_image_dimensions(context, 300, 20 * 6 + 3);
+
+        parse_image(context, str);
+        auto colors_size = size_t{};
+        auto colors = vte::glib::take_free_ptr(context.image_data_colors(&colors_size, extra_stride));
+        g_assert_nonnull(colors.get());
+        g_assert_cmpuint(colors_size / sizeof(Context::color_t), ==, indexed_size / sizeof(Context::color_index_t));
+
+        auto const n_pixels = (context.image_width() + extra_stride) * context.image_height();
+        for (auto i = 0u; i < n_pixels; ++i)
+                g_assert_cmphex(colors.get()[i], ==, context.color(indexed.get()[i]));
+}
+
+static void
+test_context_image_colors_perf(void)
+{
+        if (!g_test_perf()) {
+                g_test_skip("Only in perf mode");
+                return;
+        }
+
+        auto context = TestContext{};
+        auto const str = random_image(800, 100);
+        auto const n_iterations = 200;
+
+        auto elapsed = 0.0;
+        for (auto i = 0; i < n_iterations; ++i) {
+                parse_image(context, str);
+
+                g_test_timer_start();
+                auto colors = vte::glib::take_free_ptr(context.image_data_colors());
+                elapsed += g_test_timer_elapsed();
+
+                g_assert_nonnull(colors.get());
+        }
+
+        g_test_minimized_result(elapsed / n_iterations,
+                                "Converting a %ux%u image took %.3fms",
+                                context.image_width(),
+                                context.image_height(),
+                                elapsed * 1000. / n_iterations);
+}
+
+static void
+test_context_image_hash(void)
+{
+        auto context = TestContext{};
+        auto const str = random_image(300, 20);
+
+        parse_image(context, str);
+        auto const hash = context.image_hash();
+
+        /* The same image hashes the same */
+        parse_image(context, str);
+        g_assert_true(context.image_hash() == hash);
+
+        /* Changing one pixel changes the hash */
+        parse_image(context, "#1~~-~~"sv, 0xffu, 0xffu, 0xffu, 0u, 0u, 0u);
+        auto const hash_fg = context.image_hash();
+        parse_image(context, "#1~~-~}"sv, 0xffu, 0xffu, 0xffu, 0u, 0u, 0u);
+        assert_image_dimensions(context, 2, 12);
+        g_assert_false(context.image_hash() == hash_fg);
+
+        /* Changing the colours changes the hash */
+        parse_image(context, "#1~~-~~"sv, 0xffu, 0u, 0u, 0u, 0u, 0u);
+        g_assert_false(context.image_hash() == hash_fg);
+
+        /* Changing the dimensions changes the hash, even if the
+         * additional pixels are all in the background colour.
+         */
+        parse_image(context, "#1~~-~~"sv, 0xffu, 0xffu, 0xffu, 0u, 0u, 0u);
+        g_assert_true(context.image_hash() == hash_fg);
+        parse_image(context, "\"1;1;3;12#1~~-~~"sv, 0xffu, 0xffu, 0xffu, 0u, 0u, 0u);
+        g_assert_false(context.image_hash() == hash_fg);
+}
+
 // Main
 
 int
@@ -1597,11 +1818,16 @@ main(int argc,
         g_test_add_func("/vte/sixel/context/repeat", test_context_repeat);
         g_test_add_func("/vte/sixel/context/scanlines/grow", test_context_scanlines_grow);
         g_test_add_func("/vte/sixel/context/scanlines/underfull", test_context_scanlines_underfull);
+        g_test_add_func("/vte/sixel/context/scanlines/complete", test_context_scanlines_complete);
+        g_test_add_func("/vte/sixel/context/progress", test_context_progress);
         g_test_add_func("/vte/sixel/context/scanlines/max-width", test_context_scanlines_max_width);
         g_test_add_func("/vte/sixel/context/scanlines/max-height", test_context_scanlines_max_height);
         g_test_add_func("/vte/sixel/context/image/stride", test_context_image_stride);
         g_test_add_func("/vte/sixel/context/image/palette", test_context_image_palette);
         g_test_add_func("/vte/sixel/context/image/compositing", test_context_image_compositing);
+        g_test_add_func("/vte/sixel/context/image/colors", test_context_image_colors);
+        g_test_add_func("/vte/sixel/context/image/colors/perf", test_context_image_colors_perf);
+        g_test_add_func("/vte/sixel/context/image/hash", test_context_image_hash);
 
         return g_test_run();
 }
@@ -0,0 +1,118 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "stats.hh"
+
+using namespace vte::base;
+
+static void
+test_histogram_bucket(void)
+{
+        g_assert_cmpuint(Histogram::bucket(0), ==, 0);
+        g_assert_cmpuint(Histogram::bucket(1), ==, 0);
+        g_assert_cmpuint(Histogram::bucket(2), ==, 1);
+        g_assert_cmpuint(Histogram::bucket(3), ==, 1);
+        g_assert_cmpuint(Histogram::bucket(4), ==, 2);
+        g_assert_cmpuint(Histogram::bucket(1023), ==, 9);
+        g_assert_cmpuint(Histogram::bucket(1024), ==, 10);
+
+        /* Overlong durations end up in the last bucket */
+        g_assert_cmpuint(Histogram::bucket(UINT64_MAX), ==, Histogram::n_buckets() - 1);
+}
+
+static void
+test_histogram_add(void)
+{
+        Histogram h;
+        g_assert_cmpuint(h.count(), ==, 0);
+        g_assert_cmpuint(h.mean(), ==, 0);
+        g_assert_cmpuint(h.percentile(500), ==, 0);
+
+        h.add(100);
+        h.add(300);
+        h.add(200);
+        g_assert_cmpuint(h.count(), ==, 3);
+        g_assert_cmpuint(h.total(), ==, 600);
+        g_assert_cmpuint(h.mean(), ==, 200);
+        g_assert_cmpuint(h.max(), ==, 300);
+        g_assert_cmpuint(h.bucket_count(6), ==, 1);
+        g_assert_cmpuint(h.bucket_count(7), ==, 1);
+        g_assert_cmpuint(h.bucket_count(8), ==, 1);
+
+        h.reset();
+        g_assert_cmpuint(h.count(), ==, 0);
+        g_assert_cmpuint(h.max(), ==, 0);
+        g_assert_cmpuint(h.bucket_count(6), ==, 0);
+}
+
+static void
+test_histogram_percentile(void)
+{
+        Histogram h;
+        for (auto i = 0; i < 99; ++i)
+                h.add(10);
+        h.add(5000);
+
+        g_assert_cmpuint(h.percentile(0), ==, 16);
+        g_assert_cmpuint(h.percentile(500), ==, 16);
+        g_assert_cmpuint(h.percentile(990), ==, 16);
+
+        /* The upper bound is clamped to the maximum */
+        g_assert_cmpuint(h.percentile(1000), ==, 5000);
+}
+
+static void
+test_stats_reset(void)
+{
+        Stats s;
+        s.add_bytes_parsed(42);
+        s.add_sequence(VTE_CMD_CUP);
+        s.add_sequence(VTE_CMD_CUP);
+        s.add_frame_drawn();
+        s.add_frame_skipped();
+        s.add_stream_written(7);
+        s.add_timing(Stats::Timing::DRAW_ROWS, 1000);
+
+        g_assert_cmpuint(s.bytes_parsed(), ==, 42);
+        g_assert_cmpuint(s.sequences(VTE_CMD_CUP), ==, 2);
+        g_assert_cmpuint(s.frames_drawn(), ==, 1);
+        g_assert_cmpuint(s.frames_skipped(), ==, 1);
+        g_assert_cmpuint(s.stream_bytes_written(), ==, 7);
+        g_assert_cmpuint(s.timing(Stats::Timing::DRAW_ROWS).count(), ==, 1);
+
+        s.reset();
+        g_assert_cmpuint(s.bytes_parsed(), ==, 0);
+        g_assert_cmpuint(s.sequences(VTE_CMD_CUP), ==, 0);
+        g_assert_cmpuint(s.frames_drawn(), ==, 0);
+        g_assert_cmpuint(s.timing(Stats::Timing::DRAW_ROWS).count(), ==, 0);
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/stats/histogram/bucket", test_histogram_bucket);
+        g_test_add_func("/vte/stats/histogram/add", test_histogram_add);
+        g_test_add_func("/vte/stats/histogram/percentile", test_histogram_percentile);
+        g_test_add_func("/vte/stats/reset", test_stats_reset);
+
+        return g_test_run();
+}
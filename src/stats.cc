@@ -0,0 +1,123 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include "stats.hh"
+
+#include <iterator>
+#include <string_view>
+
+#include <fmt/format.h>
+
+using namespace std::literals;
+
+namespace vte::base {
+
+static std::string_view
+cmd_to_sv(unsigned cmd) noexcept
+{
+        switch (cmd) {
+#define _VTE_CMD(cmd) case VTE_CMD_##cmd: return #cmd##sv;
+#define _VTE_NOP(cmd) _VTE_CMD(cmd)
+#include "parser-cmd.hh"
+#undef _VTE_CMD
+#undef _VTE_NOP
+        default:
+                return "?"sv;
+        }
+}
+
+static std::string_view
+timing_to_sv(Stats::Timing timing) noexcept
+{
+        switch (timing) {
+        case Stats::Timing::PROCESS_INCOMING: return "process_incoming"sv;
+        case Stats::Timing::DRAW_ROWS: return "draw_rows"sv;
+        case Stats::Timing::RINGVIEW_UPDATE: return "ringview_update"sv;
+        case Stats::Timing::FREEZE_ROW: return "freeze_row"sv;
+        default: return "?"sv;
+        }
+}
+
+static void
+format_histogram(std::string& str,
+                 std::string_view name,
+                 Histogram const& histogram)
+{
+        auto it = std::back_inserter(str);
+
+        fmt::format_to(it,
+                       "  {:<18} {:>10} calls, total {:>10}µs, mean {:>8}ns, "
+                       "p50 <{}ns, p99 <{}ns, max {}ns\n",
+                       name,
+                       histogram.count(),
+                       histogram.total() / 1000,
+                       histogram.mean(),
+                       histogram.percentile(500),
+                       histogram.percentile(990),
+                       histogram.max());
+
+        if (histogram.count() == 0)
+                return;
+
+        /* Print the non-empty range of buckets */
+        auto first = size_t{0}, last = Histogram::n_buckets();
+        while (histogram.bucket_count(first) == 0)
+                ++first;
+        while (histogram.bucket_count(last - 1) == 0)
+                --last;
+
+        for (auto i = first; i < last; ++i) {
+                fmt::format_to(it,
+                               "    <{:>12}ns {:>10}\n",
+                               Histogram::duration_t(2) << i,
+                               histogram.bucket_count(i));
+        }
+}
+
+std::string
+Stats::to_string() const
+{
+        auto str = std::string{};
+        auto it = std::back_inserter(str);
+
+        fmt::format_to(it, "Input:\n");
+        fmt::format_to(it, "  bytes parsed       {:>10}\n", m_bytes_parsed);
+
+        fmt::format_to(it, "Sequences:\n");
+        for (auto cmd = 0u; cmd < m_sequences.size(); ++cmd) {
+                if (m_sequences[cmd] == 0)
+                        continue;
+
+                fmt::format_to(it, "  {:<18} {:>10}\n", cmd_to_sv(cmd), m_sequences[cmd]);
+        }
+
+        fmt::format_to(it, "Frames:\n");
+        fmt::format_to(it, "  drawn              {:>10}\n", m_frames_drawn);
+        fmt::format_to(it, "  skipped            {:>10}\n", m_frames_skipped);
+
+        fmt::format_to(it, "Stream I/O:\n");
+        fmt::format_to(it, "  bytes written      {:>10}\n", m_stream_bytes_written);
+        fmt::format_to(it, "  bytes read         {:>10}\n", m_stream_bytes_read);
+
+        fmt::format_to(it, "Timings:\n");
+        for (auto i = size_t{0}; i < m_timings.size(); ++i)
+                format_histogram(str, timing_to_sv(Timing(i)), m_timings[i]);
+
+        return str;
+}
+
+} // namespace vte::base
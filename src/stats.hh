@@ -0,0 +1,191 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "parser.hh"
+
+namespace vte {
+
+namespace base {
+
+/*
+ * Histogram:
+ *
+ * Counts durations in buckets of powers of two nanoseconds: bucket i
+ * holds the durations d with 2^i <= d < 2^(i+1) (bucket 0 also holds 0).
+ */
+class Histogram {
+public:
+        using duration_t = uint64_t; /* in ns */
+
+        static constexpr const size_t k_n_buckets = 40u;
+
+        static inline constexpr size_t n_buckets() noexcept { return k_n_buckets; }
+
+        static inline constexpr size_t bucket(duration_t ns) noexcept
+        {
+                return ns == 0 ? 0 : std::min(size_t(std::bit_width(ns)) - 1, n_buckets() - 1);
+        }
+
+        inline constexpr void add(duration_t ns) noexcept
+        {
+                ++m_buckets[bucket(ns)];
+                ++m_count;
+                m_total += ns;
+                m_max = std::max(m_max, ns);
+        }
+
+        inline constexpr void reset() noexcept { *this = {}; }
+
+        inline constexpr auto count() const noexcept { return m_count; }
+        inline constexpr auto total() const noexcept { return m_total; }
+        inline constexpr auto max() const noexcept { return m_max; }
+        inline constexpr auto bucket_count(size_t i) const noexcept { return m_buckets[i]; }
+
+        inline constexpr duration_t mean() const noexcept
+        {
+                return m_count ? m_total / m_count : 0;
+        }
+
+        /* Returns the upper bound of the bucket containing the
+         * @permille'th duration, e.g. 500 for the median.
+         */
+        constexpr duration_t percentile(unsigned permille) const noexcept
+        {
+                if (m_count == 0)
+                        return 0;
+
+                auto const target = std::max((m_count * std::min(permille, 1000u) + 999) / 1000,
+                                             uint64_t{1});
+                auto seen = uint64_t{0};
+                for (auto i = size_t{0}; i < n_buckets(); ++i) {
+                        seen += m_buckets[i];
+                        if (seen >= target)
+                                return std::min(duration_t(2) << i, m_max);
+                }
+
+                return m_max;
+        }
+
+private:
+        std::array<uint64_t, k_n_buckets> m_buckets{};
+        uint64_t m_count{0};
+        duration_t m_total{0};
+        duration_t m_max{0};
+
+}; // class Histogram
+
+/*
+ * Stats:
+ *
+ * Cheap, always-on counters and timings of a terminal's processing and
+ * drawing pipeline, to be dumped on request (see vte_terminal_dup_statistics()).
+ * Unlike the VTE_DEBUG logging, updating them costs a few increments and
+ * clock reads, so they are kept in production builds too.
+ */
+class Stats {
+public:
+        enum class Timing {
+                PROCESS_INCOMING,
+                DRAW_ROWS,
+                RINGVIEW_UPDATE,
+                FREEZE_ROW,
+                N
+        };
+
+        /* Adds the time from its construction to its destruction to a timing */
+        class ScopedTimer {
+        public:
+                ScopedTimer(Stats& stats,
+                            Timing timing) noexcept
+                        : m_stats{stats},
+                          m_timing{timing},
+                          m_start{clock::now()}
+                {
+                }
+
+                ~ScopedTimer()
+                {
+                        auto const elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_start);
+                        m_stats.add_timing(m_timing, elapsed.count());
+                }
+
+                ScopedTimer(ScopedTimer const&) = delete;
+                ScopedTimer(ScopedTimer&&) = delete;
+                ScopedTimer& operator=(ScopedTimer const&) = delete;
+                ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+        private:
+                using clock = std::chrono::steady_clock;
+
+                Stats& m_stats;
+                Timing m_timing;
+                clock::time_point m_start;
+        };
+
+        inline void add_timing(Timing timing,
+                               Histogram::duration_t ns) noexcept
+        {
+                m_timings[size_t(timing)].add(ns);
+        }
+
+        inline auto const& timing(Timing timing) const noexcept { return m_timings[size_t(timing)]; }
+
+        inline void add_bytes_parsed(size_t n) noexcept { m_bytes_parsed += n; }
+        inline void add_sequence(unsigned cmd) noexcept
+        {
+                if (cmd < m_sequences.size()) [[likely]]
+                        ++m_sequences[cmd];
+        }
+        inline void add_frame_drawn() noexcept { ++m_frames_drawn; }
+        inline void add_frame_skipped() noexcept { ++m_frames_skipped; }
+        inline void add_stream_read(size_t n) noexcept { m_stream_bytes_read += n; }
+        inline void add_stream_written(size_t n) noexcept { m_stream_bytes_written += n; }
+
+        inline auto bytes_parsed() const noexcept { return m_bytes_parsed; }
+        inline auto sequences(unsigned cmd) const noexcept { return m_sequences[cmd]; }
+        inline auto frames_drawn() const noexcept { return m_frames_drawn; }
+        inline auto frames_skipped() const noexcept { return m_frames_skipped; }
+        inline auto stream_bytes_read() const noexcept { return m_stream_bytes_read; }
+        inline auto stream_bytes_written() const noexcept { return m_stream_bytes_written; }
+
+        void reset() noexcept { *this = {}; }
+
+        /* Returns a human readable description of all counters */
+        std::string to_string() const;
+
+private:
+        uint64_t m_bytes_parsed{0};
+        uint64_t m_frames_drawn{0};
+        uint64_t m_frames_skipped{0};
+        uint64_t m_stream_bytes_read{0};
+        uint64_t m_stream_bytes_written{0};
+        std::array<uint64_t, VTE_CMD_N> m_sequences{};
+        std::array<Histogram, size_t(Timing::N)> m_timings{};
+
+}; // class Stats
+
+} // namespace base
+
+} // namespace vte
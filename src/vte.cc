@@ -135,8 +135,9 @@ static vte::Freeable<cairo_region_t> vte_cairo_get_clip_region(cairo_t* cr);
 
 class Terminal::ProcessingContext {
 public:
-        vte::grid::row_t m_bbox_top{-G_MAXINT};
-        vte::grid::row_t m_bbox_bottom{G_MAXINT};
+        vte::grid::row_t m_bbox_top{G_MAXINT};
+        vte::grid::row_t m_bbox_bottom{-G_MAXINT};
+        vte::grid::row_t m_saved_insert_delta{0};
         bool m_modified{false};
         bool m_bottom{false};
         bool m_invalidated_text{false};
@@ -155,6 +156,7 @@ public:
 
                 // FIXMEchpe make this a method on VteScreen
                 m_bottom = screen->insert_delta == long(screen->scroll_delta);
+                m_saved_insert_delta = screen->insert_delta;
 
                 /* Save the current cursor position. */
                 m_saved_cursor = screen->cursor;
@@ -164,12 +166,6 @@ public:
                 m_in_scroll_region = terminal.m_scrolling_region.is_restricted()
                         && (screen->cursor.row >= (screen->insert_delta + terminal.m_scrolling_region.top()))
                         && (screen->cursor.row <= (screen->insert_delta + terminal.m_scrolling_region.bottom()));
-
-                //context.modified = false;
-                //context.invalidated_text = false;
-
-                //context.bbox_bottom = -G_MAXINT;
-                //context.bbox_top = G_MAXINT;
         }
 
         ~ProcessingContext() = default;
@@ -336,6 +332,8 @@ void
 Terminal::invalidate_rows(vte::grid::row_t row_start,
                           vte::grid::row_t row_end /* inclusive */)
 {
+        m_contents_damage.record_rows(row_start, row_end + 1);
+
 #if VTE_GTK == 3
 	if (G_UNLIKELY (!widget_realized()))
                 return;
@@ -403,7 +401,22 @@ Terminal::invalidate_rows(vte::grid::row_t row_start,
 	}
 
 #elif VTE_GTK == 4
-        invalidate_all();
+        if (G_UNLIKELY (row_end < row_start))
+                return;
+
+	_vte_debug_print (vte::debug::category::UPDATES,
+                          "Invalidating rows {}..{}",
+                          row_start, row_end);
+
+        /* Only the render nodes of these rows need to be rebuilt. */
+        mark_rows_dirty(row_start, row_end);
+
+        /* Offscreen, visible parts didn't change. */
+        if (row_start > last_displayed_row() ||
+            row_end < first_displayed_row())
+                return;
+
+        queue_redraw();
 #endif
 }
 
@@ -420,11 +433,15 @@ void
 Terminal::invalidate_rows_and_context(vte::grid::row_t row_start,
                                       vte::grid::row_t row_end /* inclusive */)
 {
+        m_contents_damage.record_rows(row_start, row_end + 1);
+
         if (G_UNLIKELY (!widget_realized()))
                 return;
 
+#if VTE_GTK == 3
         if (m_invalidated_all)
                 return;
+#endif
 
         if (G_UNLIKELY (row_end < row_start))
                 return;
@@ -519,6 +536,35 @@ Terminal::invalidate_symmetrical_difference(vte::grid::span const& a, vte::grid:
 
 void
 Terminal::invalidate_all()
+{
+        m_contents_damage.record_all();
+
+#if VTE_GTK == 4
+        /* Drop all cached render nodes */
+        ++m_row_nodes_generation;
+#endif
+
+        queue_redraw();
+}
+
+/* Invalidates the view after it scrolled, without the buffer contents
+ * having changed. This is not recorded as a change of the contents.
+ */
+void
+Terminal::invalidate_scrolled()
+{
+        /* On gtk4, the cached render nodes are kept per buffer row, so
+         * draw_rows() only needs to translate them to their new position
+         * and build the nodes of the rows that were scrolled into view.
+         */
+        queue_redraw();
+}
+
+/* Schedules a redraw of the whole widget, without invalidating the
+ * cached rendering of any rows.
+ */
+void
+Terminal::queue_redraw()
 {
 	if (G_UNLIKELY (!widget_realized()))
                 return;
@@ -527,7 +573,7 @@ Terminal::invalidate_all()
 		return;
 	}
 
-	_vte_debug_print (vte::debug::category::UPDATES, "Invalidating all");
+	_vte_debug_print (vte::debug::category::UPDATES, "Queueing redraw");
 
 	reset_update_rects();
 	m_invalidated_all = TRUE;
@@ -764,7 +810,16 @@ Terminal::invalidate_cursor_once(bool periodic)
 		_vte_debug_print(vte::debug::category::UPDATES,
                                  "Invalidating cursor in row {}",
                                  row);
+#if VTE_GTK == 3
                 invalidate_row(row);
+#elif VTE_GTK == 4
+                /* The cursor is painted on top of the rows, so the
+                 * rows' cached rendering stays valid.
+                 */
+                if (row >= first_displayed_row() &&
+                    row <= last_displayed_row())
+                        queue_redraw();
+#endif
 	}
 }
 
@@ -1149,15 +1204,53 @@ Terminal::match_rowcol_to_offset(vte::grid::column_t column,
         return true;
 }
 
-/* creates a pcre match context with appropriate limits */
-vte::Freeable<pcre2_match_context_8>
-Terminal::create_match_context()
+/* Returns the pcre match context, creating it with the current limits
+ * on first use. It is kept for the lifetime of the terminal, so that
+ * hovering and searching do not allocate.
+ */
+pcre2_match_context_8*
+Terminal::match_context()
+{
+        if (!m_match_context) {
+                m_match_context = vte::take_freeable(pcre2_match_context_create_8(nullptr /* general context */));
+                pcre2_set_match_limit_8(m_match_context.get(), m_match_limit);
+                pcre2_set_recursion_limit_8(m_match_context.get(), m_match_depth_limit);
+        }
+
+        return m_match_context.get();
+}
+
+/* Returns the pcre match data, creating it on first use. */
+pcre2_match_data_8*
+Terminal::match_data()
+{
+        if (!m_match_data)
+                m_match_data = vte::take_freeable(pcre2_match_data_create_8(VTE_REGEX_OVECTOR_PAIRS,
+                                                                            nullptr /* general context */));
+
+        return m_match_data.get();
+}
+
+bool
+Terminal::set_match_limits(uint32_t match_limit,
+                           uint32_t depth_limit)
 {
-        auto context = vte::take_freeable(pcre2_match_context_create_8(nullptr /* general context */));
-        pcre2_set_match_limit_8(context.get(), 65536); /* should be plenty */
-        pcre2_set_recursion_limit_8(context.get(), 64); /* should be plenty */
+        if (match_limit == m_match_limit &&
+            depth_limit == m_match_depth_limit)
+                return false;
+
+        m_match_limit = match_limit;
+        m_match_depth_limit = depth_limit;
+
+        if (m_match_context) {
+                pcre2_set_match_limit_8(m_match_context.get(), m_match_limit);
+                pcre2_set_recursion_limit_8(m_match_context.get(), m_match_depth_limit);
+        }
+
+        /* The limits may change the outcome of the match check */
+        match_hilite_clear();
 
-        return context;
+        return true;
 }
 
 bool
@@ -1182,9 +1275,10 @@ Terminal::match_check_pcre(pcre2_match_data_8 *match_data,
         const char *line;
         int r = 0;
 
-        if (regex->jited())
+        if (regex->jited()) {
                 match_fn = pcre2_jit_match_8;
-        else
+                pcre2_jit_stack_assign_8(match_context, nullptr, regex->jit_stack());
+        } else
                 match_fn = pcre2_match_8;
 
         line = m_match_contents->str;
@@ -1297,16 +1391,15 @@ Terminal::match_check_internal_pcre(vte::grid::column_t column,
 	start_blank = sattr;
 	end_blank = eattr;
 
-        auto match_context = create_match_context();
-        auto match_data = vte::take_freeable(pcre2_match_data_create_8(256 /* should be plenty */,
-                                                                       nullptr /* general context */));
+        auto const match_context = this->match_context();
+        auto const match_data = this->match_data();
 
 	/* Now iterate over each regex we need to match against. */
         char* dingu_match{nullptr};
         for (auto const& rem : m_match_regexes) {
                 gsize sblank, eblank;
 
-                if (match_check_pcre(match_data.get(), match_context.get(),
+                if (match_check_pcre(match_data, match_context,
                                      rem.regex(),
                                      rem.match_flags(),
                                      sattr, eattr, offset,
@@ -1871,9 +1964,8 @@ Terminal::regex_match_check_extra(vte::grid::column_t col,
                                     &offset, &sattr, &eattr))
                 return false;
 
-        auto match_context = create_match_context();
-        auto match_data = vte::take_freeable(pcre2_match_data_create_8(256 /* should be plenty */,
-                                                                       nullptr /* general context */));
+        auto const match_context = this->match_context();
+        auto const match_data = this->match_data();
 
         for (i = 0; i < n_regexes; i++) {
                 gsize start, end, sblank, eblank;
@@ -1881,7 +1973,7 @@ Terminal::regex_match_check_extra(vte::grid::column_t col,
 
                 g_return_val_if_fail(regexes[i] != nullptr, false);
 
-                if (match_check_pcre(match_data.get(), match_context.get(),
+                if (match_check_pcre(match_data, match_context,
                                      regexes[i], match_flags,
                                      sattr, eattr, offset,
                                      &match_string,
@@ -1956,7 +2048,7 @@ Terminal::queue_adjustment_value_changed(double v)
                          dy);
 
         m_ringview.invalidate();
-        invalidate_all();
+        invalidate_scrolled();
         match_contents_clear();
         emit_text_scrolled(dy);
         queue_contents_changed();
@@ -2886,7 +2978,7 @@ Terminal::scroll_text_up(scrolling_region const& scrolling_region,
                 for (row = top; row <= bottom - amount; row++) {
                         VteRowData *dst = m_screen->row_data->index_writable(row);
                         VteRowData *src = m_screen->row_data->index_writable(row + amount);
-                        memcpy(dst->cells + left, src->cells + left, (right - left + 1) * sizeof(VteCell));
+                        _vte_row_data_copy_cells(src, dst, left, right - left + 1);
                 }
                 /* Erase the cells we scrolled away from. */
                 const VteCell *cell = fill ? &m_color_defaults : &basic_cell;
@@ -2965,7 +3057,7 @@ Terminal::scroll_text_down(scrolling_region const& scrolling_region,
                 for (row = bottom; row >= top + amount; row--) {
                         VteRowData *dst = m_screen->row_data->index_writable(row);
                         VteRowData *src = m_screen->row_data->index_writable(row - amount);
-                        memcpy(dst->cells + left, src->cells + left, (right - left + 1) * sizeof(VteCell));
+                        _vte_row_data_copy_cells(src, dst, left, right - left + 1);
                 }
                 /* Erase the cells we scrolled away from. */
                 const VteCell *cell = fill ? &m_color_defaults : &basic_cell;
@@ -3481,6 +3573,7 @@ Terminal::insert_char(gunichar c,
 			goto not_inserted;
 
 		/* Combine the new character on top of the cell string */
+                _vte_row_data_note_char (row, c);
 		c = _vte_unistr_append_unichar (cell->c, c);
 
 		/* And set it */
@@ -3522,6 +3615,7 @@ Terminal::insert_char(gunichar c,
 		pcell->attr = attr;
 		col++;
 	}
+        _vte_row_data_note_char (row, c);
 
 	/* insert wide-char fragments */
 	attr.set_fragment(true);
@@ -3639,6 +3733,7 @@ Terminal::insert_single_width_chars(gunichar const *p, int len)
                         VteCell *pcell = _vte_row_data_get_writable (row, col);
                         pcell->c = *p;
                         pcell->attr = m_defaults.attr;
+                        _vte_row_data_note_char (row, *p);
                         p++;
                         col++;
                 }
@@ -3664,8 +3759,8 @@ Terminal::insert_single_width_chars(gunichar const *p, int len)
 #if WITH_SIXEL
 
 void
-Terminal::insert_image(ProcessingContext& context,
-                       vte::Freeable<cairo_surface_t> image_surface) /* throws */
+Terminal::insert_image(vte::Freeable<cairo_surface_t> image_surface,
+                       std::optional<vte::image::ContentKey> const& key) /* throws */
 {
         if (!image_surface)
                 return;
@@ -3681,6 +3776,7 @@ Terminal::insert_image(ProcessingContext& context,
         auto const height = (image_height_px + m_cell_height_unscaled - 1) / m_cell_height_unscaled;
 
         m_screen->row_data->append_image(std::move(image_surface),
+                                         key,
                                          image_width_px,
                                          image_height_px,
                                          left,
@@ -3688,14 +3784,79 @@ Terminal::insert_image(ProcessingContext& context,
                                          m_cell_width_unscaled,
                                          m_cell_height_unscaled);
 
-        /* Erase characters under the image. Since this inserts content, we need
-         * to update the processing context's bbox.
+        /* Erase characters under the image */
+        erase_image_rect(height, width);
+}
+
+void
+Terminal::insert_image(ProcessingContext& context,
+                       vte::Freeable<cairo_surface_t> image_surface,
+                       std::optional<vte::image::ContentKey> const& key) /* throws */
+{
+        /* Since this inserts content, we need to update the processing
+         * context's bbox.
          */
         context.pre_GRAPHIC();
-        erase_image_rect(height, width);
+        insert_image(std::move(image_surface), key);
         context.post_GRAPHIC();
 }
 
+/*
+ * Terminal::update_progressive_image:
+ *
+ * While a SIXEL image is being received, sets the part of it that has
+ * been completed so far as the ring's provisional image, for a painter to
+ * show before the image has been received completely. This is rate
+ * limited, since each update converts the whole partial image.
+ */
+void
+Terminal::update_progressive_image() /* throws */
+{
+        if (m_sixel_context->id() == vte::sixel::Context::k_termprop_icon_image_id)
+                return;
+
+        auto const shown_height = m_sixel_progress.height();
+        auto const height = m_sixel_context->complete_height();
+        if (!m_sixel_progress.update(height, g_get_monotonic_time()))
+                return;
+
+        auto surface = m_sixel_context->image_cairo(height);
+        if (!surface)
+                return;
+
+        m_screen->row_data->set_provisional_image(std::move(surface),
+                                                  m_sixel_context->image_width(),
+                                                  height,
+                                                  m_screen->cursor.col,
+                                                  m_screen->cursor.row,
+                                                  m_cell_width_unscaled,
+                                                  m_cell_height_unscaled);
+
+        /* Only the rows of the newly completed scanlines need to be redrawn */
+        auto const top = m_screen->cursor.row;
+        invalidate_rows(top + shown_height / m_cell_height_unscaled,
+                        top + (height + m_cell_height_unscaled - 1) / m_cell_height_unscaled - 1);
+}
+
+/*
+ * Terminal::drop_progressive_image:
+ *
+ * Removes the provisional image set by update_progressive_image().
+ */
+void
+Terminal::drop_progressive_image() noexcept
+{
+        auto const height = m_sixel_progress.finish();
+        if (height == 0)
+                return;
+
+        m_screen->row_data->drop_provisional_image();
+
+        auto const top = m_screen->cursor.row;
+        invalidate_rows(top,
+                        top + (height + m_cell_height_unscaled - 1) / m_cell_height_unscaled - 1);
+}
+
 #endif /* WITH_SIXEL */
 
 guint8
@@ -4018,10 +4179,15 @@ Terminal::process_incoming()
         /* We should only be called when there's data to process. */
         g_assert(!m_incoming_queue.empty());
 
+        auto const timer = vte::base::Stats::ScopedTimer{m_stats, vte::base::Stats::Timing::PROCESS_INCOMING};
+
         auto bytes_processed = ssize_t{0};
 
         auto context = ProcessingContext{*this};
 
+        /* Invalidations from here on describe changes to the contents */
+        m_contents_damage.set_recording(true);
+
         while (!m_incoming_queue.empty()) {
                 auto& chunk = m_incoming_queue.front();
 
@@ -4113,6 +4279,24 @@ Terminal::process_incoming()
                 queue_contents_changed();
         }
 
+        /* Complete the description of the changes before it is handed
+         * out with contents-changed; the invalidations below only
+         * concern the rendering.
+         */
+        m_contents_damage.set_recording(false);
+        if (m_screen != context.m_saved_screen) {
+                m_contents_damage.add_all();
+        } else {
+                if (context.m_invalidated_text)
+                        m_contents_damage.add_rows(context.m_bbox_top, context.m_bbox_bottom + 1);
+
+                m_contents_damage.add_scrolled(context.m_saved_insert_delta,
+                                               m_screen->insert_delta,
+                                               m_row_count);
+        }
+        m_contents_damage.move_cursor(context.m_saved_cursor.row, context.m_saved_cursor.col,
+                                      m_screen->cursor.row, m_screen->cursor.col);
+
         emit_pending_signals();
 
         if (context.m_invalidated_text) {
@@ -4140,6 +4324,8 @@ Terminal::process_incoming()
         /* After processing some data, do a hyperlink GC. The multiplier is totally arbitrary, feel free to fine tune. */
         m_screen->row_data->hyperlink_maybe_gc(bytes_processed * 8);
 
+        m_stats.add_bytes_parsed(bytes_processed);
+
         _vte_debug_print (vte::debug::category::IO,
                           "{} bytes in {} chunks left to process",
                           m_input_bytes,
@@ -4285,6 +4471,8 @@ Terminal::process_incoming_utf8(ProcessingContext& context,
                                 break;
 
                         default: {
+                                m_stats.add_sequence(seq.command());
+
                                 switch (seq.command()) {
 #define _VTE_CMD_HANDLER(cmd)   \
                                 case VTE_CMD_##cmd: cmd(seq); break;
@@ -4405,6 +4593,8 @@ Terminal::process_incoming_pcterm(ProcessingContext& context,
                                 break;
 
                         default: {
+                                m_stats.add_sequence(seq.command());
+
                                 switch (seq.command()) {
 #define _VTE_CMD_HANDLER(cmd)   \
                                 case VTE_CMD_##cmd: cmd(seq); break;
@@ -4481,10 +4671,15 @@ Terminal::process_incoming_decsixel(ProcessingContext& context,
         chunk.set_begin_reading(ip);
 
         switch (status) {
-        case vte::sixel::Parser::ParseStatus::CONTINUE:
+        case vte::sixel::Parser::ParseStatus::CONTINUE: try {
+                update_progressive_image();
+                } catch (...) {
+                }
                 break;
 
         case vte::sixel::Parser::ParseStatus::COMPLETE: try {
+                drop_progressive_image();
+
                 /* Like the main parser, the sequence only takes effect
                  * if introducer and terminator match (both C0 or both C1).
                  */
@@ -4504,7 +4699,17 @@ Terminal::process_incoming_decsixel(ProcessingContext& context,
 
                                 m_pending_changes |= std::to_underlying(PendingChanges::TERMPROPS);
                         } else {
-                                insert_image(context, m_sixel_context->image_cairo());
+                                /* Many applications redraw the same image over and over;
+                                 * reuse the surface of an identical image if there is one.
+                                 */
+                                auto const key = vte::image::ContentKey{m_sixel_context->image_hash(),
+                                                                        int(m_sixel_context->image_width()),
+                                                                        int(m_sixel_context->image_height())};
+                                auto surface = m_screen->row_data->lookup_image_surface(key);
+                                if (!surface)
+                                        surface = m_sixel_context->image_cairo();
+
+                                insert_image(context, std::move(surface), key);
                         }
                 }
                 } catch (...) {
@@ -4514,6 +4719,8 @@ Terminal::process_incoming_decsixel(ProcessingContext& context,
                 break;
 
         case vte::sixel::Parser::ParseStatus::ABORT: try {
+                drop_progressive_image();
+
                 if (m_sixel_context->id() == vte::sixel::Context::k_termprop_icon_image_id) {
                         auto const info = m_termprops.registry().lookup(VTE_PROPERTY_ID_ICON_IMAGE);
                         assert(info);
@@ -6929,6 +7136,127 @@ Terminal::get_selected_text(GString *string,
 }
 
 #if VTE_DEBUG
+
+static inline unsigned int
+checksum_cell_attr(VteCellAttr const& attr) noexcept
+{
+        auto checksum = 0u;
+        if (attr.invisible())
+                checksum += 0x08;
+        if (attr.underline())
+                checksum += 0x10;
+        if (attr.reverse())
+                checksum += 0x20;
+        if (attr.blink())
+                checksum += 0x40;
+        if (attr.bold())
+                checksum += 0x80;
+        return checksum;
+}
+
+/* Whether the row contains any character that may need BiDi treatment.
+ * This errs on the safe side, see _vte_row_data_note_char().
+ */
+static bool
+row_maybe_rtl(VteRowData const* row_data) noexcept
+{
+        if (row_data->attr.bidi_flags & VTE_BIDI_FLAG_RTL)
+                return true;
+        if (!(row_data->attr.bidi_flags & VTE_BIDI_FLAG_IMPLICIT))
+                return false;
+
+        return row_data->attr.maybe_rtl;
+}
+
+/* Returns the (not yet negated) checksum of the cells of @row_data that
+ * are visually in the columns [@start_col, @end_col), with @bidirow mapping
+ * logical to visual columns, or the identity mapping if it is nullptr.
+ *
+ * This walks the cells like get_text() does in block mode with @preserve_empty,
+ * so the result is the same as adding up its output would be; in particular,
+ * empty cells at the end of the row don't count.
+ */
+unsigned int
+Terminal::checksum_row(VteRowData const* row_data,
+                       vte::grid::column_t start_col,
+                       vte::grid::column_t end_col,
+                       vte::base::BidiRow const* bidirow) const noexcept
+{
+        auto const len = vte::grid::column_t(_vte_row_data_length(row_data));
+        auto const first_col = bidirow ? 0 : start_col;
+        auto const last_col = std::min(len, bidirow ? m_column_count : end_col);
+
+        auto checksum = 0u;
+        auto pending_empty = 0u;
+        auto last_empty_col = vte::grid::column_t{-1};
+
+        for (auto lcol = first_col; lcol < last_col; ++lcol) {
+                if (bidirow) {
+                        auto const vcol = bidirow->log2vis(lcol);
+                        if (vcol < start_col || vcol >= end_col)
+                                continue;
+                }
+
+                auto const& cell = row_data->cells[lcol];
+                if (cell.attr.fragment())
+                        continue;
+
+                if (cell.c == 0) {
+                        pending_empty += checksum_cell_attr(cell.attr);
+                        last_empty_col = lcol;
+                } else {
+                        checksum += pending_empty +
+                                _vte_unistr_sum(cell.c) +
+                                _vte_unistr_strlen(cell.c) * checksum_cell_attr(cell.attr);
+                        pending_empty = 0;
+                        last_empty_col = -1;
+                }
+        }
+
+        /* Empty cells are only stripped if nothing but empty cells follow them
+         * in the row, even outside of the area.
+         */
+        if (last_empty_col != -1) {
+                for (auto lcol = last_empty_col + 1; lcol < len; ++lcol) {
+                        auto const& cell = row_data->cells[lcol];
+                        if (!cell.attr.fragment() && cell.c != 0) {
+                                checksum += pending_empty;
+                                break;
+                        }
+                }
+        }
+
+        return checksum;
+}
+
+/* Returns the cache entry for @row, reset if it doesn't match @row_data's
+ * current contents anymore.
+ */
+Terminal::ChecksumCacheEntry&
+Terminal::checksum_cache_lookup(vte::grid::row_t row,
+                                VteRowData const* row_data)
+{
+        if (m_checksum_cache.size() != size_t(m_row_count))
+                m_checksum_cache.assign(m_row_count, {});
+
+        auto const ring = m_screen->row_data;
+        auto const serial = ring->row_serial(row);
+        auto& entry = m_checksum_cache[row % m_checksum_cache.size()];
+        if (serial == 0 ||
+            entry.ring != ring ||
+            entry.row != row ||
+            entry.serial != serial) {
+                entry = ChecksumCacheEntry{ring, row, serial, -1, -1, 0, row_maybe_rtl(row_data)};
+        }
+
+        return entry;
+}
+
+/* Computes the DECRQCRA checksum directly from the cells, without extracting
+ * the text. The per-row results are cached as long as the row isn't modified,
+ * unless BiDi treatment is needed, where the mapping of a row depends on the
+ * other rows of its paragraph.
+ */
 unsigned int
 Terminal::checksum_area(vte::grid_rect rect)
 {
@@ -6937,48 +7265,70 @@ Terminal::checksum_area(vte::grid_rect rect)
         vte::grid::column_t const start_col = rect.left();
         vte::grid::column_t const end_col = rect.right() + 1;
 
+        auto const ring = m_screen->row_data;
+
+        /* Find out whether any row of the paragraphs involved needs BiDi */
+        auto need_bidi = false;
+        if (m_enable_bidi) {
+                auto first_row = std::max(start_row, vte::grid::row_t(ring->delta()));
+                auto last_row = std::min(end_row, vte::grid::row_t(ring->next()) - 1);
+                for (auto i = 0;
+                     i < VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX &&
+                             first_row > vte::grid::row_t(ring->delta()) &&
+                             ring->is_soft_wrapped(first_row - 1);
+                     ++i)
+                        --first_row;
+                for (auto i = 0;
+                     i < VTE_RINGVIEW_PARAGRAPH_LENGTH_MAX &&
+                             last_row < vte::grid::row_t(ring->next()) - 1 &&
+                             ring->is_soft_wrapped(last_row);
+                     ++i)
+                        ++last_row;
+
+                for (auto row = first_row; row <= last_row && !need_bidi; ++row) {
+                        auto const row_data = find_row_data(row);
+                        if (row_data == nullptr)
+                                continue;
+                        need_bidi = checksum_cache_lookup(row, row_data).maybe_rtl;
+                }
+        }
+
         unsigned int checksum = 0;
-        VteCharAttrList attributes;
-        const VteCellAttr *attr;
 
-        vte_char_attr_list_init(&attributes);
-        auto text = g_string_new(nullptr);
-        get_text(start_row, start_col, end_row, end_col,
-                             true /* block */,
-                             true /* preserve_empty */,
-                             text,
-                             &attributes);
-        if (text == nullptr) {
-                vte_char_attr_list_clear(&attributes);
-                return checksum;
-        }
+        if (need_bidi) {
+                vte::base::RingView ringview;
+                ringview.set_ring(ring);
+                ringview.set_rows(start_row, end_row - start_row + 1);
+                ringview.set_width(m_column_count);
+                ringview.update();
 
-        vte_assert_cmpuint(text->len, ==, vte_char_attr_list_get_size(&attributes));
-        char const* end = (char const*)text->str + text->len;
-        for (char const *p = text->str; p < end; p = g_utf8_next_char(p)) {
-                auto const c = g_utf8_get_char(p);
-                if (c == '\n')
-                        continue;
-                checksum += c;
-                attr = char_to_cell_attr(vte_char_attr_list_get(&attributes, p - text->str));
-
-                if (attr->invisible())
-                        checksum += 0x08;
-                if (attr->underline())
-                        checksum += 0x10;
-                if (attr->reverse())
-                        checksum += 0x20;
-                if (attr->blink())
-                        checksum += 0x40;
-                if (attr->bold())
-                        checksum += 0x80;
+                for (auto row = start_row; row <= end_row; ++row) {
+                        auto const row_data = find_row_data(row);
+                        if (row_data == nullptr)
+                                continue;
+                        checksum += checksum_row(row_data, start_col, end_col,
+                                                 ringview.get_bidirow(row));
+                }
+        } else {
+                for (auto row = start_row; row <= end_row; ++row) {
+                        auto const row_data = find_row_data(row);
+                        if (row_data == nullptr)
+                                continue;
+
+                        auto& entry = checksum_cache_lookup(row, row_data);
+                        if (entry.start_col != start_col || entry.end_col != end_col) {
+                                entry.checksum = checksum_row(row_data, start_col, end_col, nullptr);
+                                entry.start_col = start_col;
+                                entry.end_col = end_col;
+                        }
+                        checksum += entry.checksum;
+                }
         }
-        vte_char_attr_list_clear(&attributes);
-        g_string_free(text, true);
 
         checksum = -checksum;
         return checksum & 0xffff;
 }
+
 #endif /* VTE_DEBUG */
 
 /*
@@ -7899,6 +8249,11 @@ Terminal::apply_font_metrics(int cell_width_unscaled,
 	}
 	/* Emit a signal that the font changed. */
 	if (cresize) {
+#if WITH_SIXEL
+                m_normal_screen.row_data->drop_scaled_images();
+                m_alternate_screen.row_data->drop_scaled_images();
+#endif
+
                 if (pty()) {
                         /* Update pixel size of PTY. */
                         pty()->set_size(m_row_count,
@@ -8361,6 +8716,7 @@ Terminal::set_size(long columns,
 		/* Resize the alternate screen if it's the current one, but never rewrap it: bug 336238 comment 60 */
 		if (m_screen == &m_alternate_screen)
 			screen_set_size(&m_alternate_screen, old_columns, old_rows, false);
+                m_contents_damage.add_all();
 
                 /* Ensure scrollback buffers cover the screen. */
                 set_scrollback_lines(m_scrollback_lines);
@@ -8413,7 +8769,7 @@ Terminal::set_scroll_value(double value)
                 _vte_debug_print(vte::debug::category::ADJ,
                                  "Scrolling by {:f}", dy);
 
-                invalidate_all();
+                invalidate_scrolled();
                 match_contents_clear();
                 emit_text_scrolled(dy);
                 queue_contents_changed();
@@ -8432,6 +8788,9 @@ Terminal::Terminal(vte::platform::Widget* w,
         m_screen(&m_normal_screen),
         m_termprops{termprops_registry()}
 {
+        m_normal_screen.m_ring.set_stats(&m_stats);
+        m_alternate_screen.m_ring.set_stats(&m_stats);
+
         /* Inits allocation to 1x1 @ -1,-1 */
         cairo_rectangle_int_t allocation;
         gtk_widget_get_allocation(m_widget, &allocation);
@@ -8709,6 +9068,11 @@ Terminal::widget_unrealize()
         m_draw.clear_font_cache();
 	m_fontdirty = true;
 
+#if VTE_GTK == 4
+        /* Drop the cached render nodes */
+        m_row_nodes.clear();
+#endif
+
         /* Remove the cursor blink timeout function. */
 	remove_cursor_timeout();
 
@@ -8955,7 +9319,14 @@ Terminal::resolve_normal_colors(VteCell const* cell,
 bool
 Terminal::text_blink_timer_callback()
 {
+#if VTE_GTK == 3
         invalidate_all();
+#elif VTE_GTK == 4
+        /* Only the rows containing blinking text need to be rebuilt,
+         * which row_nodes() recognises by the changed blink state.
+         */
+        queue_redraw();
+#endif
         return false; /* don't run again */
 }
 
@@ -8975,7 +9346,6 @@ Terminal::draw_cells(vte::view::DrawingContext::TextRequest* items,
                                int row_height)
 {
         int i, xl, xr, y;
-	gint columns = 0;
         vte::color::rgb fg, bg, dc;
 
 	g_assert(n > 0);
@@ -9033,6 +9403,31 @@ Terminal::draw_cells(vte::view::DrawingContext::TextRequest* items,
          * so that if the descent of a letter crosses an underline of a different color,
          * it's the letter's color that wins. Other kinds of decorations always have the
          * same color as the text, so the order is irrelevant there. */
+        draw_decorations(items, n, fg, dc, attr, hyperlink, hilite,
+                         column_width, row_height);
+
+        m_draw.draw_text(
+                       items, n,
+                       attr,
+                       &fg);
+}
+
+/* Draw the decorations (underline, strikethrough, overline, box, and
+ * hyperlink and match underlining) of a string of characters. */
+void
+Terminal::draw_decorations(vte::view::DrawingContext::TextRequest* items,
+                           gssize n,
+                           vte::color::rgb const& fg,
+                           vte::color::rgb const& dc,
+                           uint32_t attr,
+                           bool hyperlink,
+                           bool hilite,
+                           int column_width,
+                           int row_height)
+{
+        int i, xl, xr, y;
+	gint columns = 0;
+
         if ((attr & (VTE_ATTR_UNDERLINE_MASK |
                      VTE_ATTR_STRIKETHROUGH_MASK |
                      VTE_ATTR_OVERLINE_MASK |
@@ -9172,11 +9567,6 @@ Terminal::draw_cells(vte::view::DrawingContext::TextRequest* items,
 			}
                 }
 	}
-
-        m_draw.draw_text(
-                       items, n,
-                       attr,
-                       &fg);
 }
 
 /* FIXME: we don't have a way to tell GTK+ what the default text attributes
@@ -9443,6 +9833,8 @@ Terminal::draw_cells_with_attributes(vte::view::DrawingContext::TextRequest* ite
 void
 Terminal::ringview_update()
 {
+        auto const timer = vte::base::Stats::ScopedTimer{m_stats, vte::base::Stats::Timing::RINGVIEW_UPDATE};
+
         auto first_row = first_displayed_row();
         auto last_row = last_displayed_row();
         if (cursor_is_onscreen())
@@ -9456,9 +9848,429 @@ Terminal::ringview_update()
         m_ringview.update ();
 }
 
-/* Paint the contents of a given row at the given location.  Take advantage
- * of multiple-draw APIs by finding runs of characters with identical
- * attributes and bundling them together. */
+/* Paint the background of a row, as row @row_index of the background
+ * started with begin_background(). @y is only used for debugging output.
+ */
+void
+Terminal::draw_row_background(VteRowData const* row_data,
+                              vte::base::BidiRow const* bidirow,
+                              vte::grid::row_t row,
+                              size_t row_index,
+                              int y,
+                              int column_width,
+                              int row_height,
+                              int rect_width)
+{
+        vte::grid::column_t i, j;
+        guint fore, nfore, back, nback, deco, ndeco;
+        gboolean selected;
+        gboolean nrtl = FALSE, rtl;  /* for debugging */
+	const VteCell *cell;
+
+        auto const column_count = m_column_count;
+
+#if VTE_GTK == 3
+        _VTE_DEBUG_IF (vte::debug::category::BIDI) {
+                /* Debug: Highlight the paddings of RTL rows with a slightly different background. */
+                if (bidirow->base_is_rtl()) {
+                        vte::color::rgb bg;
+                        rgb_from_index<8, 8, 8>(VTE_DEFAULT_BG, bg);
+                        /* Go halfway towards #C0C0C0. */
+                        bg.red   = (bg.red   + 0xC000) / 2;
+                        bg.green = (bg.green + 0xC000) / 2;
+                        bg.blue  = (bg.blue  + 0xC000) / 2;
+                        m_draw.fill_rectangle(
+                                                  -m_border.left,
+                                                  y,
+                                                  m_border.left,
+                                                  row_height,
+                                                  &bg);
+                        m_draw.fill_rectangle(
+                                                  column_count * column_width,
+                                                  y,
+                                                  rect_width - m_border.left - column_count * column_width,
+                                                  row_height,
+                                                  &bg);
+                }
+        }
+#endif // VTE_GTK == 3
+
+        i = j = 0;
+        /* Walk the line.
+         * Locate runs of identical bg colors within a row, and paint each run as a single rectangle. */
+        do {
+                /* Get the first cell's contents. */
+                cell = row_data ? _vte_row_data_get (row_data, bidirow->vis2log(i)) : nullptr;
+                /* Find the colors for this cell. */
+                selected = cell_is_selected_vis(i, row);
+                determine_colors(cell, selected, &fore, &back, &deco);
+                rtl = bidirow->vis_is_rtl(i);
+
+                while (++j < column_count) {
+                        /* Retrieve the next cell. */
+                        cell = row_data ? _vte_row_data_get (row_data, bidirow->vis2log(j)) : nullptr;
+                        /* Resolve attributes to colors where possible and
+                         * compare visual attributes to the first character
+                         * in this chunk. */
+                        selected = cell_is_selected_vis(j, row);
+                        determine_colors(cell, selected, &nfore, &nback, &ndeco);
+                        nrtl = bidirow->vis_is_rtl(j);
+                        if (nback != back || (vte::debug::check_categories(vte::debug::category::BIDI) && nrtl != rtl)) {
+                                break;
+                        }
+                }
+                if (back != VTE_DEFAULT_BG) {
+                        vte::color::rgb bg;
+                        rgb_from_index<8, 8, 8>(back, bg);
+                        m_draw.fill_cell_background(i, row_index, (j - i), &bg);
+                }
+
+#if VTE_GTK == 3
+                _VTE_DEBUG_IF (vte::debug::category::BIDI) {
+                        /* Debug: Highlight RTL letters and RTL rows with a slightly different background. */
+                        vte::color::rgb bg;
+                        rgb_from_index<8, 8, 8>(back, bg);
+                        /* Go halfway towards #C0C0C0. */
+                        bg.red   = (bg.red   + 0xC000) / 2;
+                        bg.green = (bg.green + 0xC000) / 2;
+                        bg.blue  = (bg.blue  + 0xC000) / 2;
+                        int y1 = y + round(row_height / 8.);
+                        int y2 = y + row_height - round(row_height / 8.);
+                        /* Paint the top and bottom eighth of the cell with this more gray background
+                         * if the paragraph has a resolved RTL base direction. */
+                        if (bidirow->base_is_rtl()) {
+                                m_draw.fill_rectangle(
+                                                          i * column_width,
+                                                          y,
+                                                          (j - i) * column_width,
+                                                          y1 - y,
+                                                          &bg);
+                                m_draw.fill_rectangle(
+                                                          i * column_width,
+                                                          y2,
+                                                          (j - i) * column_width,
+                                                          y + row_height - y2,
+                                                          &bg);
+                        }
+                        /* Paint the middle three quarters of the cell with this more gray background
+                         * if the current character has a resolved RTL direction. */
+                        if (rtl) {
+                                m_draw.fill_rectangle(
+                                                          i * column_width,
+                                                          y1,
+                                                          (j - i) * column_width,
+                                                          y2 - y1,
+                                                          &bg);
+                        }
+                }
+#endif // VTE_GTK == 3
+
+                /* We'll need to continue at the first cell which didn't
+                 * match the first one in this set. */
+                i = j;
+        } while (i < column_count);
+}
+
+/* Paint the text of a row at the given location.  Take advantage
+ * of multiple-draw APIs by bundling together all the characters of the
+ * row that share the same font style and colour, and separately, the
+ * runs of characters that share the same decorations. */
+void
+Terminal::draw_row_text(VteRowData const* row_data,
+                        vte::base::BidiRow const* bidirow,
+                        vte::grid::row_t row,
+                        int y,
+                        vte::view::DrawingContext::TextRequest* items,
+                        int column_width,
+                        int row_height)
+{
+        vte::grid::column_t j, lcol, vcol;
+        guint fore, back, deco;
+        gboolean hyperlink;  /* non-hovered explicit hyperlink, needs dashed underlining */
+        gboolean hilite;     /* hovered explicit hyperlink or regex match, needs continuous underlining */
+        gboolean selected;
+	guint item_count, i, k;
+	const VteCell *cell;
+
+        /* What determines how an item is painted */
+        struct ItemStyle {
+                uint32_t fore;
+                uint32_t deco;
+                uint32_t attr;
+                bool hyperlink;
+                bool hilite;
+        };
+
+        auto const column_count = m_column_count;
+        uint32_t const attr_mask = m_allow_bold ? ~0 : ~VTE_ATTR_BOLD_MASK;
+
+        auto styles = g_newa(ItemStyle, column_count);
+
+        /* Walk the line in logical order, and collect the cells to paint. */
+        item_count = 0;
+        // FIXME No need for the "< column_count" safety cap once bug 135 is addressed.
+        for (lcol = 0; lcol < row_data->len && lcol < column_count; ) {
+                vcol = bidirow->log2vis(lcol);
+
+                /* Get the character cell's contents. */
+                cell = _vte_row_data_get (row_data, lcol);
+                g_assert(cell != nullptr);
+
+                hyperlink = (m_allow_hyperlink && cell->attr.hyperlink_idx != 0);
+                hilite = (hyperlink && cell->attr.hyperlink_idx == m_hyperlink_hover_idx) ||
+                         (!hyperlink && regex_match_has_current() && m_match_span.contains(row, lcol));
+                if (cell->c == 0 ||
+                    ((cell->c == ' ' || cell->c == '\t') &&  // FIXME '\t' is newly added now, double check
+                     cell->attr.has_none(VTE_ATTR_UNDERLINE_MASK |
+                                         VTE_ATTR_STRIKETHROUGH_MASK |
+                                         VTE_ATTR_OVERLINE_MASK) &&
+                     !hyperlink &&
+                     !hilite) ||
+                    cell->attr.fragment() ||
+                    cell->attr.invisible()) {
+                        /* Skip empty or fragment cell, but erase on ' ' and '\t', since
+                         * it may be overwriting an image. */
+                        lcol++;
+                        continue;
+                }
+
+                /* Find the colors for this cell. */
+                selected = cell_is_selected_log(lcol, row);
+                determine_colors(cell, selected, &fore, &back, &deco);
+
+                styles[item_count] = ItemStyle{fore, deco, cell->attr.attr & attr_mask,
+                                               bool(hyperlink), bool(hilite)};
+
+                /* Combine with subsequent spacing marks. */
+                vteunistr c = cell->c;
+                j = lcol + cell->attr.columns();
+                if (G_UNLIKELY (lcol == 0 && g_unichar_ismark (_vte_unistr_get_base (cell->c)))) {
+                        /* A rare special case: the first cell contains a spacing mark.
+                         * Place on top of a NBSP, along with additional spacing marks if any,
+                         * and display beginning at offscreen column -1.
+                         * Additional spacing marks, if any, will be combined by the loop below. */
+                        c = _vte_unistr_append_unistr (0x00A0, cell->c);
+                        lcol = -1;
+                }
+                // FIXME No need for the "< column_count" safety cap once bug 135 is addressed.
+                while (j < row_data->len && j < column_count) {
+                        /* Combine with subsequent spacing marks. */
+                        cell = _vte_row_data_get (row_data, j);
+                        if (cell && !cell->attr.fragment() && g_unichar_ismark (_vte_unistr_get_base (cell->c))) {
+                                c = _vte_unistr_append_unistr (c, cell->c);
+                                j += cell->attr.columns();
+                        } else {
+                                break;
+                        }
+                }
+
+                vte_assert_cmpint (item_count, <, column_count);
+                items[item_count].c = bidirow->vis_get_shaped_char(vcol, c);
+                items[item_count].columns = j - lcol;
+                items[item_count].x = (vcol - (bidirow->vis_is_rtl(vcol) ? items[item_count].columns - 1 : 0)) * column_width;
+                items[item_count].y = y;
+                items[item_count].mirror = bidirow->vis_is_rtl(vcol);
+                items[item_count].box_mirror = !!(row_data->attr.bidi_flags & VTE_BIDI_FLAG_BOX_MIRROR);
+                item_count++;
+
+                vte_assert_cmpint (j, >, lcol);
+                lcol = j;
+        }
+
+        if (item_count == 0)
+                return;
+
+        /* Items with the "blink" attribute are skipped entirely in the "off" state of blinking text.
+         * Notify the caller that they were encountered, so that it can set up a timer. */
+        auto const is_hidden = [&](ItemStyle const& style) noexcept -> bool {
+                if (!(style.attr & VTE_ATTR_BLINK))
+                        return false;
+
+                m_text_to_blink = true;
+                return !m_text_blink_state;
+        };
+
+        /* Draw the decorations of runs of cells that share them. Do this before drawing the
+         * letters, so that if the descent of a letter crosses an underline of a different
+         * color, it's the letter's color that wins. */
+        uint32_t const deco_mask = VTE_ATTR_UNDERLINE_MASK |
+                VTE_ATTR_STRIKETHROUGH_MASK |
+                VTE_ATTR_OVERLINE_MASK |
+                VTE_ATTR_BOXED_MASK |
+                VTE_ATTR_BLINK_MASK;
+        auto const same_decoration = [&](ItemStyle const& a,
+                                         ItemStyle const& b) noexcept -> bool {
+                return ((a.attr ^ b.attr) & deco_mask) == 0 &&
+                        a.fore == b.fore &&
+                        a.deco == b.deco &&
+                        a.hyperlink == b.hyperlink &&
+                        a.hilite == b.hilite;
+        };
+
+        for (i = 0; i < item_count; i = k) {
+                auto const& style = styles[i];
+                for (k = i + 1; k < item_count && same_decoration(styles[k], style); k++)
+                        ;
+
+                if (!(style.attr & (deco_mask & ~VTE_ATTR_BLINK_MASK)) &&
+                    !style.hyperlink &&
+                    !style.hilite)
+                        continue;
+                if (is_hidden(style))
+                        continue;
+
+                vte::color::rgb fg, dc;
+                rgb_from_index<8, 8, 8>(style.fore, fg);
+                if (style.deco == VTE_DEFAULT_FG)
+                        dc = fg;
+                else
+                        rgb_from_index<4, 5, 4>(style.deco, dc);
+
+                draw_decorations(items + i, k - i,
+                                 fg, dc,
+                                 style.attr,
+                                 style.hyperlink, style.hilite,
+                                 column_width, row_height);
+        }
+
+        /* Draw the letters, all the ones of the row with the same font style
+         * and colour at once, no matter whether they're adjacent. */
+        uint32_t const text_mask = VTE_ATTR_BOLD_MASK |
+                VTE_ATTR_ITALIC_MASK |
+                VTE_ATTR_BLINK_MASK;
+        auto const text_key = [&](ItemStyle const& style) noexcept -> uint64_t {
+                return (uint64_t(style.fore) << 32) | (style.attr & text_mask);
+        };
+
+        auto order = g_newa(guint, item_count);
+        for (i = 0; i < item_count; i++)
+                order[i] = i;
+        std::stable_sort(order, order + item_count,
+                         [&](guint a, guint b) -> bool {
+                                 return text_key(styles[a]) < text_key(styles[b]);
+                         });
+
+        auto batch = g_newa(vte::view::DrawingContext::TextRequest, item_count);
+        for (i = 0; i < item_count; i = k) {
+                auto const& style = styles[order[i]];
+                auto const key = text_key(style);
+                guint n = 0;
+                for (k = i; k < item_count && text_key(styles[order[k]]) == key; k++)
+                        batch[n++] = items[order[k]];
+
+                if (is_hidden(style))
+                        continue;
+
+                vte::color::rgb fg;
+                rgb_from_index<8, 8, 8>(style.fore, fg);
+                m_draw.draw_text(batch, n, style.attr, &fg);
+        }
+}
+
+#if VTE_GTK == 4
+
+/* Marks the cached render nodes of the rows from @row_start to @row_end
+ * (inclusive) as dirty, so that the next snapshot rebuilds them.
+ * Rows without cached nodes will be built anyway when they are drawn.
+ */
+void
+Terminal::mark_rows_dirty(vte::grid::row_t row_start,
+                          vte::grid::row_t row_end) noexcept
+{
+        row_start = std::max(row_start, vte::grid::row_t(0));
+        if (m_row_nodes.empty() || row_end < row_start)
+                return;
+
+        auto const n_entries = vte::grid::row_t(m_row_nodes.size());
+        if (row_end - row_start + 1 >= n_entries) {
+                for (auto& entry : m_row_nodes) {
+                        if (entry.row >= row_start && entry.row <= row_end)
+                                entry.dirty = true;
+                }
+        } else {
+                for (auto row = row_start; row <= row_end; ++row) {
+                        auto& entry = m_row_nodes[row % n_entries];
+                        if (entry.row == row)
+                                entry.dirty = true;
+                }
+        }
+}
+
+/* Returns the render nodes for @row, building them if there aren't
+ * any cached ones that are still valid.
+ */
+Terminal::RowNodes const&
+Terminal::row_nodes(vte::grid::row_t row,
+                    vte::view::DrawingContext::TextRequest* items,
+                    int column_width,
+                    int row_height)
+{
+        auto const n_entries = m_row_nodes.size();
+        auto const ring = m_screen->row_data;
+        auto const serial = ring->row_serial(row);
+        auto& entry = m_row_nodes[row % n_entries];
+        if (!entry.dirty &&
+            entry.ring == ring &&
+            entry.row == row &&
+            entry.serial == serial &&
+            entry.generation == m_row_nodes_generation &&
+            (!entry.blinks || entry.blink_state == m_text_blink_state)) {
+                m_text_to_blink |= entry.blinks;
+                return entry;
+        }
+
+        _vte_debug_print(vte::debug::category::DRAW,
+                         "Building render nodes for row {}", row);
+
+        auto const row_data = find_row_data(row);
+        auto const bidirow = m_ringview.get_bidirow(row);
+
+        entry = {};
+        entry.ring = ring;
+        entry.row = row;
+        entry.serial = serial;
+        entry.generation = m_row_nodes_generation;
+
+        m_draw.begin_node();
+        auto const bg_rect = vte::view::Rectangle{0, 0,
+                                                  int(m_column_count * column_width),
+                                                  row_height};
+        m_draw.begin_background(bg_rect, m_column_count, 1);
+        draw_row_background(row_data, bidirow, row, 0, 0,
+                            column_width, row_height, 0);
+        m_draw.flush_background(bg_rect);
+        entry.background = m_draw.end_node();
+
+        if (row_data != nullptr) {
+                auto const text_to_blink = m_text_to_blink;
+                m_text_to_blink = false;
+
+                /* Restrict the text to the row plus the overdraw area, as on
+                 * gtk3, so that tall glyphs don't paint over the other rows.
+                 */
+                auto const clip_rect = vte::view::Rectangle{-m_border.left,
+                                                            -cell_overflow_top(),
+                                                            get_allocated_width(),
+                                                            row_height + cell_overflow_top() + cell_overflow_bottom()};
+
+                m_draw.begin_node();
+                m_draw.clip_border(&clip_rect);
+                draw_row_text(row_data, bidirow, row, 0, items,
+                              column_width, row_height);
+                m_draw.unclip_border();
+                entry.text = m_draw.end_node();
+
+                entry.blinks = m_text_to_blink;
+                entry.blink_state = m_text_blink_state;
+                m_text_to_blink |= text_to_blink;
+        }
+
+        return entry;
+}
+
+#endif /* VTE_GTK == 4 */
+
+/* Paint the contents of the given rows at the given location. */
 void
 Terminal::draw_rows(VteScreen *screen_,
                     cairo_region_t const* region,
@@ -9468,39 +10280,28 @@ Terminal::draw_rows(VteScreen *screen_,
                     gint column_width,
                     gint row_height)
 {
+        auto const timer = vte::base::Stats::ScopedTimer{m_stats, vte::base::Stats::Timing::DRAW_ROWS};
+
         vte::grid::row_t row;
-        vte::grid::column_t i, j, lcol, vcol;
-        guint fore = VTE_DEFAULT_FG, nfore, back = VTE_DEFAULT_BG, nback, deco = VTE_DEFAULT_FG, ndeco;
-        gboolean hyperlink = FALSE, nhyperlink;  /* non-hovered explicit hyperlink, needs dashed underlining */
-        gboolean hilite = FALSE, nhilite;        /* hovered explicit hyperlink or regex match, needs continuous underlining */
-        gboolean selected;
-        gboolean nrtl = FALSE, rtl;  /* for debugging */
-        uint32_t attr = 0, nattr;
-	guint item_count;
-	const VteCell *cell;
 	VteRowData const* row_data;
         vte::base::BidiRow const* bidirow;
 
         auto const column_count = m_column_count;
-        uint32_t const attr_mask = m_allow_bold ? ~0 : ~VTE_ATTR_BOLD_MASK;
 
         /* Need to ensure the ringview is updated. */
         ringview_update();
 
         auto items = g_newa(vte::view::DrawingContext::TextRequest, column_count);
 
+#if VTE_GTK == 3
+        int const rect_width = get_allocated_width();
+
         /* Paint the background.
          * Do it first for all the cells we're about to paint, before drawing the glyphs,
          * so that overflowing bits of a glyph (to the right or downwards) won't be
          * chopped off by another cell's background, not even across changes of the
          * background or any other attribute.
          * Process each row independently. */
-#if VTE_GTK == 3
-        int const rect_width = get_allocated_width();
-#elif VTE_GTK == 4
-        int const rect_width = get_allocated_width() + m_style_border.left + m_style_border.right;
-#endif
-
         auto bg_rect = vte::view::Rectangle{0,
                                             start_y,
                                             int(column_count * column_width),
@@ -9508,127 +10309,19 @@ Terminal::draw_rows(VteScreen *screen_,
         m_draw.begin_background(bg_rect, column_count, end_row - start_row);
 
         /* The rect contains the area of the row, and is moved row-wise in the loop. */
-#if VTE_GTK == 3
         auto crect = vte::view::Rectangle{-m_border.left, start_y, rect_width, row_height};
-#endif
         for (row = start_row;
              row < end_row;
-             row++
-#if VTE_GTK == 3
-                     , crect.advance_y(row_height)
-#endif
-             ) {
-#if VTE_GTK == 3
+             row++, crect.advance_y(row_height)) {
                 /* Check whether we need to draw this row at all */
                 if (cairo_region_contains_rectangle(region, crect.cairo()) == CAIRO_REGION_OVERLAP_OUT)
                         continue;
 
-                auto const y = crect.cairo()->y;
-#endif
-
 		row_data = find_row_data(row);
                 bidirow = m_ringview.get_bidirow(row);
 
-#if VTE_GTK == 3
-                _VTE_DEBUG_IF (vte::debug::category::BIDI) {
-                        /* Debug: Highlight the paddings of RTL rows with a slightly different background. */
-                        if (bidirow->base_is_rtl()) {
-                                vte::color::rgb bg;
-                                rgb_from_index<8, 8, 8>(VTE_DEFAULT_BG, bg);
-                                /* Go halfway towards #C0C0C0. */
-                                bg.red   = (bg.red   + 0xC000) / 2;
-                                bg.green = (bg.green + 0xC000) / 2;
-                                bg.blue  = (bg.blue  + 0xC000) / 2;
-                                m_draw.fill_rectangle(
-                                                          -m_border.left,
-                                                          y,
-                                                          m_border.left,
-                                                          row_height,
-                                                          &bg);
-                                m_draw.fill_rectangle(
-                                                          column_count * column_width,
-                                                          y,
-                                                          rect_width - m_border.left - column_count * column_width,
-                                                          row_height,
-                                                          &bg);
-                        }
-                }
-#endif // VTE_GTK == 3
-
-                i = j = 0;
-                /* Walk the line.
-                 * Locate runs of identical bg colors within a row, and paint each run as a single rectangle. */
-                do {
-                        /* Get the first cell's contents. */
-                        cell = row_data ? _vte_row_data_get (row_data, bidirow->vis2log(i)) : nullptr;
-                        /* Find the colors for this cell. */
-                        selected = cell_is_selected_vis(i, row);
-                        determine_colors(cell, selected, &fore, &back, &deco);
-                        rtl = bidirow->vis_is_rtl(i);
-
-                        while (++j < column_count) {
-                                /* Retrieve the next cell. */
-                                cell = row_data ? _vte_row_data_get (row_data, bidirow->vis2log(j)) : nullptr;
-                                /* Resolve attributes to colors where possible and
-                                 * compare visual attributes to the first character
-                                 * in this chunk. */
-                                selected = cell_is_selected_vis(j, row);
-                                determine_colors(cell, selected, &nfore, &nback, &ndeco);
-                                nrtl = bidirow->vis_is_rtl(j);
-                                if (nback != back || (vte::debug::check_categories(vte::debug::category::BIDI) && nrtl != rtl)) {
-                                        break;
-                                }
-                        }
-                        if (back != VTE_DEFAULT_BG) {
-                                vte::color::rgb bg;
-                                rgb_from_index<8, 8, 8>(back, bg);
-                                m_draw.fill_cell_background(i, row - start_row, (j - i), &bg);
-                        }
-
-#if VTE_GTK == 3
-                        _VTE_DEBUG_IF (vte::debug::category::BIDI) {
-                                /* Debug: Highlight RTL letters and RTL rows with a slightly different background. */
-                                vte::color::rgb bg;
-                                rgb_from_index<8, 8, 8>(back, bg);
-                                /* Go halfway towards #C0C0C0. */
-                                bg.red   = (bg.red   + 0xC000) / 2;
-                                bg.green = (bg.green + 0xC000) / 2;
-                                bg.blue  = (bg.blue  + 0xC000) / 2;
-                                int y1 = y + round(row_height / 8.);
-                                int y2 = y + row_height - round(row_height / 8.);
-                                /* Paint the top and bottom eighth of the cell with this more gray background
-                                 * if the paragraph has a resolved RTL base direction. */
-                                if (bidirow->base_is_rtl()) {
-                                        m_draw.fill_rectangle(
-                                                                  i * column_width,
-                                                                  y,
-                                                                  (j - i) * column_width,
-                                                                  y1 - y,
-                                                                  &bg);
-                                        m_draw.fill_rectangle(
-                                                                  i * column_width,
-                                                                  y2,
-                                                                  (j - i) * column_width,
-                                                                  y + row_height - y2,
-                                                                  &bg);
-                                }
-                                /* Paint the middle three quarters of the cell with this more gray background
-                                 * if the current character has a resolved RTL direction. */
-                                if (rtl) {
-                                        m_draw.fill_rectangle(
-                                                                  i * column_width,
-                                                                  y1,
-                                                                  (j - i) * column_width,
-                                                                  y2 - y1,
-                                                                  &bg);
-                                }
-                        }
-#endif // VTE_GTK == 3
-
-                        /* We'll need to continue at the first cell which didn't
-                         * match the first one in this set. */
-                        i = j;
-                } while (i < column_count);
+                draw_row_background(row_data, bidirow, row, row - start_row, crect.cairo()->y,
+                                    column_width, row_height, rect_width);
         }
 
         m_draw.flush_background(bg_rect);
@@ -9646,11 +10339,9 @@ Terminal::draw_rows(VteScreen *screen_,
         for (row = start_row, y = start_y;
              row < end_row;
              row++, y += row_height, rect.advance_y(row_height)) {
-#if VTE_GTK == 3
                 /* Check whether we need to draw this row at all */
                 if (cairo_region_contains_rectangle(region, rect.cairo()) == CAIRO_REGION_OVERLAP_OUT)
                         continue;
-#endif
 
                 row_data = find_row_data(row);
                 if (row_data == NULL)
@@ -9661,115 +10352,41 @@ Terminal::draw_rows(VteScreen *screen_,
 
                 bidirow = m_ringview.get_bidirow(row);
 
-                /* Walk the line in logical order.
-                 * Locate runs of identical attributes within a row, and draw each run using a single draw_cells() call. */
-                item_count = 0;
-                // FIXME No need for the "< column_count" safety cap once bug 135 is addressed.
-                for (lcol = 0; lcol < row_data->len && lcol < column_count; ) {
-                        vcol = bidirow->log2vis(lcol);
-
-                        /* Get the character cell's contents. */
-                        cell = _vte_row_data_get (row_data, lcol);
-                        g_assert(cell != nullptr);
-
-                        nhyperlink = (m_allow_hyperlink && cell->attr.hyperlink_idx != 0);
-                        nhilite = (nhyperlink && cell->attr.hyperlink_idx == m_hyperlink_hover_idx) ||
-                                  (!nhyperlink && regex_match_has_current() && m_match_span.contains(row, lcol));
-                        if (cell->c == 0 ||
-                            ((cell->c == ' ' || cell->c == '\t') &&  // FIXME '\t' is newly added now, double check
-                             cell->attr.has_none(VTE_ATTR_UNDERLINE_MASK |
-                                                 VTE_ATTR_STRIKETHROUGH_MASK |
-                                                 VTE_ATTR_OVERLINE_MASK) &&
-                             !nhyperlink &&
-                             !nhilite) ||
-                            cell->attr.fragment() ||
-                            cell->attr.invisible()) {
-                                /* Skip empty or fragment cell, but erase on ' ' and '\t', since
-                                 * it may be overwriting an image. */
-                                lcol++;
-                                continue;
-                        }
-
-                        /* Find the colors for this cell. */
-                        nattr = cell->attr.attr;
-                        selected = cell_is_selected_log(lcol, row);
-                        determine_colors(cell, selected, &nfore, &nback, &ndeco);
+                draw_row_text(row_data, bidirow, row, y, items, column_width, row_height);
+        }
 
-                        /* See if it no longer fits the run. */
-                        if (item_count > 0 &&
-                                   (((attr ^ nattr) & (VTE_ATTR_BOLD_MASK |
-                                                       VTE_ATTR_ITALIC_MASK |
-                                                       VTE_ATTR_UNDERLINE_MASK |
-                                                       VTE_ATTR_STRIKETHROUGH_MASK |
-                                                       VTE_ATTR_OVERLINE_MASK |
-                                                       VTE_ATTR_BLINK_MASK |
-                                                       VTE_ATTR_INVISIBLE_MASK)) ||  // FIXME or just simply "attr != nattr"?
-                                    fore != nfore ||
-                                    back != nback ||
-                                    deco != ndeco ||
-                                    hyperlink != nhyperlink ||
-                                    hilite != nhilite)) {
-                                /* Draw the completed run of cells and start a new one. */
-                                draw_cells(items, item_count,
-                                           fore, back, deco, FALSE, FALSE,
-                                           attr & attr_mask,
-                                           hyperlink, hilite,
-                                           column_width, row_height);
-                                item_count = 0;
-                        }
+#elif VTE_GTK == 4
 
-                        /* Combine with subsequent spacing marks. */
-                        vteunistr c = cell->c;
-                        j = lcol + cell->attr.columns();
-                        if (G_UNLIKELY (lcol == 0 && g_unichar_ismark (_vte_unistr_get_base (cell->c)))) {
-                                /* A rare special case: the first cell contains a spacing mark.
-                                 * Place on top of a NBSP, along with additional spacing marks if any,
-                                 * and display beginning at offscreen column -1.
-                                 * Additional spacing marks, if any, will be combined by the loop below. */
-                                c = _vte_unistr_append_unistr (0x00A0, cell->c);
-                                lcol = -1;
-                        }
-                        // FIXME No need for the "< column_count" safety cap once bug 135 is addressed.
-                        while (j < row_data->len && j < column_count) {
-                                /* Combine with subsequent spacing marks. */
-                                cell = _vte_row_data_get (row_data, j);
-                                if (cell && !cell->attr.fragment() && g_unichar_ismark (_vte_unistr_get_base (cell->c))) {
-                                        c = _vte_unistr_append_unistr (c, cell->c);
-                                        j += cell->attr.columns();
-                                } else {
-                                        break;
-                                }
-                        }
+        /* The render nodes of each row are cached, and only rebuilt when the row
+         * was marked dirty or its contents changed; see invalidate_rows().
+         *
+         * Paint all the backgrounds first, before drawing the glyphs, so that
+         * overflowing bits of a glyph (to the right or downwards) won't be
+         * chopped off by another row's background.
+         */
+        auto const n_rows = size_t(end_row - start_row);
 
-                        attr = nattr;
-                        fore = nfore;
-                        back = nback;
-                        deco = ndeco;
-                        hyperlink = nhyperlink;
-                        hilite = nhilite;
+        /* Keep a few more entries than rows, for the partially visible rows
+         * while smooth scrolling. There must be at least one entry per drawn
+         * row, since the entries are only kept alive by the cache.
+         */
+        auto const n_entries = std::max(size_t(m_row_count + 2), n_rows);
+        if (m_row_nodes.size() != n_entries) {
+                m_row_nodes.clear();
+                m_row_nodes.resize(n_entries);
+        }
 
-                        vte_assert_cmpint (item_count, <, column_count);
-                        items[item_count].c = bidirow->vis_get_shaped_char(vcol, c);
-                        items[item_count].columns = j - lcol;
-                        items[item_count].x = (vcol - (bidirow->vis_is_rtl(vcol) ? items[item_count].columns - 1 : 0)) * column_width;
-                        items[item_count].y = y;
-                        items[item_count].mirror = bidirow->vis_is_rtl(vcol);
-                        items[item_count].box_mirror = !!(row_data->attr.bidi_flags & VTE_BIDI_FLAG_BOX_MIRROR);
-                        item_count++;
+        auto nodes = g_newa(RowNodes const*, n_rows);
+        for (row = start_row; row < end_row; ++row)
+                nodes[row - start_row] = &row_nodes(row, items, column_width, row_height);
 
-                        vte_assert_cmpint (j, >, lcol);
-                        lcol = j;
-                }
+        int y;
+        for (row = start_row, y = start_y; row < end_row; ++row, y += row_height)
+                m_draw.append_node(nodes[row - start_row]->background.get(), 0, y);
+        for (row = start_row, y = start_y; row < end_row; ++row, y += row_height)
+                m_draw.append_node(nodes[row - start_row]->text.get(), 0, y);
 
-                /* Draw the last run of cells in the row. */
-                if (item_count > 0) {
-                        draw_cells(items, item_count,
-                                   fore, back, deco, FALSE, FALSE,
-                                   attr & attr_mask,
-                                   hyperlink, hilite,
-                                   column_width, row_height);
-                }
-        }
+#endif /* VTE_GTK */
 }
 
 // Returns the rectangle the cursor would be drawn if a block cursor,
@@ -10149,6 +10766,9 @@ Terminal::draw(cairo_region_t const* region) noexcept
         bool text_blink_enabled_now;
         auto now_ms = int64_t{0};
 
+        m_stats.add_frame_drawn();
+        m_frame_pending = false;
+
         allocated_width = get_allocated_width();
         allocated_height = get_allocated_height();
 
@@ -10937,6 +11557,7 @@ Terminal::reset(bool clear_tabstops,
         m_bidi_rtl = FALSE;
 	/* Cause everything to be redrawn (or cleared). */
 	m_ringview.invalidate();
+        m_contents_damage.add_all();
 	invalidate_all();
 	match_contents_clear();
 
@@ -11189,6 +11810,10 @@ Terminal::emit_pending_signals()
                         match_hilite_update();
 		}
 
+                /* Make the accumulated changes available to the handlers */
+                m_contents_changes = m_contents_damage;
+                m_contents_damage.clear();
+
 		_vte_debug_print(vte::debug::category::SIGNALS,
 				"Emitting `contents-changed'");
 		g_signal_emit(m_terminal, signals[SIGNAL_CONTENTS_CHANGED], 0);
@@ -11285,6 +11910,8 @@ Terminal::invalidate_dirty_rects_and_process_updates()
 	if (G_UNLIKELY (!m_update_rects->len))
 		return false;
 
+        count_frame_queued();
+
         auto region = cairo_region_create();
         auto n_rects = m_update_rects->len;
         for (guint i = 0; i < n_rects; i++) {
@@ -11304,23 +11931,344 @@ Terminal::invalidate_dirty_rects_and_process_updates()
 	cairo_region_destroy (region);
 
 #elif VTE_GTK == 4
+        /* The rows that need rebuilding were already marked dirty
+         * by invalidate_rows(), and will be rebuilt in the next snapshot.
+         */
         if (G_UNLIKELY(!m_invalidated_all))
                 return false;
 
-        invalidate_all();
+        count_frame_queued();
+
         gtk_widget_queue_draw(m_widget);
 #endif
 
 	return true;
 }
 
+/* Counts the frame queued by an update. If the frame queued by the
+ * previous update hasn't been drawn yet, that update is shown only
+ * together with this one, i.e. its frame was skipped.
+ */
+void
+Terminal::count_frame_queued() noexcept
+{
+        if (m_frame_pending)
+                m_stats.add_frame_skipped();
+
+        m_frame_pending = true;
+}
+
 bool
 Terminal::write_contents_sync (GOutputStream *stream,
                                VteWriteFlags flags,
                                GCancellable *cancellable,
                                GError **error)
 {
-        return m_screen->row_data->write_contents(stream, flags, cancellable, error);
+        if (flags == VTE_WRITE_DEFAULT)
+                return m_screen->row_data->write_contents(stream, flags, cancellable, error);
+
+        auto state = write_contents_begin(flags);
+        auto buffer = vte::take_freeable(g_string_sized_new(VTE_WRITE_CONTENTS_CHUNK_SIZE));
+        while (!state.done) {
+                g_string_truncate(buffer.get(), 0);
+                if (!write_contents_chunk(state, buffer.get(), VTE_WRITE_CONTENTS_CHUNK_SIZE, error))
+                        return false;
+
+                auto bytes_written = gsize{0};
+                if (!g_output_stream_write_all(stream, buffer->str, buffer->len,
+                                               &bytes_written, cancellable, error))
+                        return false;
+        }
+
+        return true;
+}
+
+/*
+ * Terminal::write_contents_begin:
+ * @flags: a set of #VteWriteFlags
+ *
+ * Starts writing the contents of the current screen, including the
+ * scrollback, incrementally with write_contents_chunk().
+ *
+ * Returns: the state to pass to write_contents_chunk()
+ */
+Terminal::WriteContentsState
+Terminal::write_contents_begin(VteWriteFlags flags)
+{
+        auto const ring = m_screen->row_data;
+
+        auto state = WriteContentsState{};
+        state.ring = ring;
+        state.ring_generation = ring->generation();
+        state.position = ring->delta();
+        state.end = ring->next();
+        state.flags = flags;
+
+        return state;
+}
+
+/* Appends @value to @buffer in little endian byte order. */
+static inline void
+append_uint32_le(GString* buffer,
+                 uint32_t value)
+{
+        auto const le = GUINT32_TO_LE(value);
+        g_string_append_len(buffer, (char const*)&le, sizeof(le));
+}
+
+/* Stores @value at @offset in @buffer in little endian byte order. */
+static inline void
+set_uint32_le(GString* buffer,
+              size_t offset,
+              uint32_t value)
+{
+        auto const le = GUINT32_TO_LE(value);
+        memcpy(buffer->str + offset, &le, sizeof(le));
+}
+
+/*
+ * Terminal::write_contents_chunk:
+ * @state: the state from write_contents_begin()
+ * @buffer: a #GString to append to
+ * @max_bytes: the size after which to stop appending to @buffer
+ * @error: a #GError location to store the error occuring, or %nullptr to ignore
+ *
+ * Appends the next rows of the contents to @buffer in the format from the
+ * flags passed to write_contents_begin(), until @buffer holds at least
+ * @max_bytes or all rows have been written, which sets @state.done.
+ *
+ * Rows in the scrollback are read directly from the ring's streams, without
+ * thawing them. The contents may change between chunks: rows that dropped off
+ * the scrollback meanwhile are skipped, and the rows on screen are written as
+ * they are at the time. If the contents are rewrapped or reset, the row
+ * positions become meaningless and writing fails.
+ *
+ * Returns: %true on success, %false with @error filled in on failure
+ */
+bool
+Terminal::write_contents_chunk(WriteContentsState& state,
+                               GString* buffer,
+                               size_t max_bytes,
+                               GError** error)
+{
+        auto const ring = state.ring;
+        if (ring->generation() != state.ring_generation) {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                    "Terminal contents were rewrapped or reset");
+                return false;
+        }
+
+        if (!state.started) {
+                state.started = true;
+
+                if (state.flags & VTE_WRITE_HTML) {
+                        g_string_append(buffer, "<pre>");
+                } else if (state.flags & VTE_WRITE_CELLS) {
+                        /* Header: magic, version, number of columns */
+                        g_string_append_len(buffer, "VTECELLS", 8);
+                        append_uint32_le(buffer, 1);
+                        append_uint32_le(buffer, m_column_count);
+                }
+        }
+
+        state.position = std::max(state.position, ring->delta());
+        state.end = std::min(state.end, ring->next());
+
+        while (state.position < state.end && buffer->len < max_bytes) {
+                if (state.flags & (VTE_WRITE_HTML | VTE_WRITE_CELLS)) {
+                        auto const ok = (state.flags & VTE_WRITE_HTML)
+                                ? append_row_html(ring, state.position, buffer)
+                                : append_row_cells(ring, state.position, buffer);
+                        if (!ok) {
+                                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                    "Failed to read the scrollback");
+                                return false;
+                        }
+
+                        ++state.position;
+                } else {
+                        auto const end = std::min(state.end,
+                                                  state.position + VTE_WRITE_CONTENTS_CHUNK_ROWS);
+                        if (!ring->append_text(state.position, end, buffer)) {
+                                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                    "Failed to read the scrollback");
+                                return false;
+                        }
+
+                        state.position = end;
+                }
+        }
+
+        if (state.position >= state.end && !state.done) {
+                state.done = true;
+
+                if (state.flags & VTE_WRITE_HTML)
+                        g_string_append(buffer, "</pre>");
+        }
+
+        return true;
+}
+
+/*
+ * Terminal::append_row_html:
+ * @ring: the #Ring
+ * @position: the row
+ * @buffer: a #GString to append to
+ *
+ * Like attributes_to_html(), but reads the runs of the row at @position
+ * directly from @ring.
+ *
+ * Returns: %true on success, %false if the row could not be read
+ */
+bool
+Terminal::append_row_html(vte::base::Ring* ring,
+                          vte::base::Ring::row_t position,
+                          GString* buffer) const
+{
+        auto text = vte::take_freeable(g_string_new(nullptr));
+        auto run_attr = VteCellAttr{};
+
+        auto flush = [&]() {
+                if (!text->len)
+                        return;
+
+                auto escaped = vte::glib::take_string(g_markup_escape_text(text->str, text->len));
+                auto marked = vte::glib::take_string(cellattr_to_html(&run_attr, escaped.get()));
+                g_string_append(buffer, marked.get());
+                g_string_truncate(text.get(), 0);
+        };
+
+        auto soft_wrapped = false;
+        if (!ring->foreach_run(position, soft_wrapped,
+                               [&](VteCellAttr const& attr,
+                                   std::string_view str) {
+                                       /* Hyperlinks are only known for the writable rows */
+                                       auto next_attr = attr;
+                                       next_attr.hyperlink_idx = 0;
+                                       if (!vte_terminal_cellattr_equal(&run_attr, &next_attr)) {
+                                               flush();
+                                               run_attr = next_attr;
+                                       }
+
+                                       g_string_append_len(text.get(), str.data(), str.size());
+                               }))
+                return false;
+
+        flush();
+
+        if (!soft_wrapped)
+                g_string_append_c(buffer, '\n');
+
+        return true;
+}
+
+/*
+ * cells_color:
+ * @color: a colour as stored in #VteCellAttr
+ * @rb, @gb, @bb: the bits per component of direct colours in @color
+ *
+ * Returns: @color as encoded in the binary cell format
+ */
+static uint32_t
+cells_color(uint32_t color,
+            unsigned rb,
+            unsigned gb,
+            unsigned bb) noexcept
+{
+        if (color & VTE_RGB_COLOR_MASK(rb, gb, bb))
+                return 0x01000000u |
+                        VTE_RGB_COLOR_GET_COMPONENT(color, gb + bb, rb) << 16 |
+                        VTE_RGB_COLOR_GET_COMPONENT(color, bb, gb) << 8 |
+                        VTE_RGB_COLOR_GET_COMPONENT(color, 0, bb);
+        if (color < 256)
+                return color;
+        if (color >= VTE_LEGACY_COLORS_OFFSET &&
+            color < VTE_LEGACY_COLORS_OFFSET + VTE_LEGACY_FULL_COLOR_SET_SIZE)
+                return color - VTE_LEGACY_COLORS_OFFSET;
+
+        return 0xffffffffu;
+}
+
+/*
+ * Terminal::append_row_cells:
+ * @ring: the #Ring
+ * @position: the row
+ * @buffer: a #GString to append to
+ *
+ * Appends the row at @position to @buffer in the binary cell format. All
+ * integers are unsigned and in little endian byte order. The contents start
+ * with the 8 bytes "VTECELLS", followed by the format version (uint32,
+ * currently 1) and the number of columns (uint32). Each row then consists of:
+ *
+ *  - the length of the row's runs in bytes (uint32)
+ *  - the row flags (uint8); 1 means the row is soft wrapped
+ *  - the runs of cells with identical attributes, each consisting of
+ *    - the attributes (uint32): bold (bit 0), italic (1), strikethrough (2),
+ *      overline (3), reverse (4), blink (5), dim (6), invisible (7), and
+ *      the underline style (bits 8 to 10; 0 for none, 1 single, 2 double,
+ *      3 curly, 4 dotted, 5 dashed)
+ *    - the foreground, background and decoration colours (uint32 each),
+ *      either a palette index from 0 to 255, 0x01RRGGBB for a direct
+ *      colour, or 0xffffffff for the default colour
+ *    - the length in bytes of the run's text (uint32)
+ *    - the run's text in UTF-8
+ *
+ * Hyperlinks are not included.
+ *
+ * Returns: %true on success, %false if the row could not be read
+ */
+bool
+Terminal::append_row_cells(vte::base::Ring* ring,
+                           vte::base::Ring::row_t position,
+                           GString* buffer) const
+{
+        auto const header_offset = buffer->len;
+        append_uint32_le(buffer, 0);
+        g_string_append_c(buffer, 0);
+
+        auto const runs_offset = buffer->len;
+        auto text_length_offset = size_t{0};
+        uint32_t run[4]{};
+
+        auto soft_wrapped = false;
+        if (!ring->foreach_run(position, soft_wrapped,
+                               [&](VteCellAttr const& attr,
+                                   std::string_view str) {
+                                       uint32_t const next_run[4] = {
+                                               uint32_t(attr.bold()) |
+                                               uint32_t(attr.italic()) << 1 |
+                                               uint32_t(attr.strikethrough()) << 2 |
+                                               uint32_t(attr.overline()) << 3 |
+                                               uint32_t(attr.reverse()) << 4 |
+                                               uint32_t(attr.blink()) << 5 |
+                                               uint32_t(attr.dim()) << 6 |
+                                               uint32_t(attr.invisible()) << 7 |
+                                               attr.underline() << 8,
+                                               cells_color(attr.fore(), 8, 8, 8),
+                                               cells_color(attr.back(), 8, 8, 8),
+                                               cells_color(attr.deco(), 4, 5, 4),
+                                       };
+
+                                       if (text_length_offset == 0 ||
+                                           memcmp(run, next_run, sizeof(run)) != 0) {
+                                               memcpy(run, next_run, sizeof(run));
+                                               for (auto const value : run)
+                                                       append_uint32_le(buffer, value);
+
+                                               text_length_offset = buffer->len;
+                                               append_uint32_le(buffer, 0);
+                                       }
+
+                                       g_string_append_len(buffer, str.data(), str.size());
+                                       set_uint32_le(buffer, text_length_offset,
+                                                     buffer->len - text_length_offset - sizeof(uint32_t));
+                               }))
+                return false;
+
+        set_uint32_le(buffer, header_offset, buffer->len - runs_offset);
+        buffer->str[runs_offset - 1] = soft_wrapped ? 1 : 0;
+
+        return true;
 }
 
 /*
@@ -11388,9 +12336,10 @@ Terminal::search_rows(pcre2_match_context_8 *match_context,
         gsize *ovector, so, eo;
         int r;
 
-        if (m_search_regex->jited())
+        if (m_search_regex->jited()) {
                 match_fn = pcre2_jit_match_8;
-        else
+                pcre2_jit_stack_assign_8(match_context, nullptr, m_search_regex->jit_stack());
+        } else
                 match_fn = pcre2_match_8;
 
         r = match_fn(m_search_regex->code(),
@@ -11511,9 +12460,8 @@ Terminal::search_find (bool backward)
 	 * Moreover, the whole search thing is implemented very inefficiently.
 	 */
 
-        auto match_context = create_match_context();
-        auto match_data = vte::take_freeable(pcre2_match_data_create_8(256 /* should be plenty */,
-                                                                       nullptr /* general context */));
+        auto const match_context = this->match_context();
+        auto const match_data = this->match_data();
 
 	buffer_start_row = m_screen->row_data->delta();
 	buffer_end_row = m_screen->row_data->next();
@@ -11531,11 +12479,11 @@ Terminal::search_find (bool backward)
 	/* If search fails, we make an empty selection at the last searched
 	 * position... */
 	if (backward) {
-		if (search_rows_iter(match_context.get(), match_data.get(),
+		if (search_rows_iter(match_context, match_data,
                                       buffer_start_row, last_start_row, backward))
 			goto found;
 		if (m_search_wrap_around &&
-		    search_rows_iter(match_context.get(), match_data.get(),
+		    search_rows_iter(match_context, match_data,
                                       last_end_row, buffer_end_row, backward))
 			goto found;
                 if (!m_selection_resolved.empty()) {
@@ -11546,11 +12494,11 @@ Terminal::search_find (bool backward)
 		}
                 match_found = false;
 	} else {
-		if (search_rows_iter(match_context.get(), match_data.get(),
+		if (search_rows_iter(match_context, match_data,
                                       last_end_row, buffer_end_row, backward))
 			goto found;
 		if (m_search_wrap_around &&
-		    search_rows_iter(match_context.get(), match_data.get(),
+		    search_rows_iter(match_context, match_data,
                                       buffer_start_row, last_start_row, backward))
 			goto found;
                 if (!m_selection_resolved.empty()) {
@@ -134,12 +134,19 @@ typedef enum _VTE_GNUC_FLAG_ENUM {
 /**
  * VteWriteFlags:
  * @VTE_WRITE_DEFAULT: Write contents as UTF-8 text.  This is the default.
+ * @VTE_WRITE_HTML: Write contents as HTML, marking up runs of text with
+ *   the same attributes. Since: 0.86
+ * @VTE_WRITE_CELLS: Write contents in VTE's binary cell format, which
+ *   keeps the attributes and colours of every cell. Since: 0.86
  *
  * A flag type to determine how terminal contents should be written
- * to an output stream.
+ * to an output stream. At most one of %VTE_WRITE_HTML and
+ * %VTE_WRITE_CELLS may be used.
  */
 typedef enum _VTE_GNUC_FLAG_ENUM {
-  VTE_WRITE_DEFAULT = 0
+  VTE_WRITE_DEFAULT = 0,
+  VTE_WRITE_HTML    = 1 << 0,
+  VTE_WRITE_CELLS   = 1 << 1
 } VteWriteFlags;
 
 /**
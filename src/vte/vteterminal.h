@@ -455,6 +455,19 @@ void vte_terminal_get_cursor_position(VteTerminal *terminal,
 				      glong *column,
                                       glong *row) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
 
+_VTE_PUBLIC
+gboolean vte_terminal_get_changed_rows(VteTerminal* terminal,
+                                       glong** ranges,
+                                       gsize* n_elements) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+glong vte_terminal_get_changed_scroll(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+gboolean vte_terminal_get_changed_cursor(VteTerminal* terminal,
+                                         glong* old_column,
+                                         glong* old_row,
+                                         glong* column,
+                                         glong* row) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
 #if _VTE_GTK == 3
 
 _VTE_PUBLIC
@@ -556,6 +569,15 @@ gboolean  vte_terminal_search_find_previous   (VteTerminal *terminal) _VTE_CXX_N
 _VTE_PUBLIC
 gboolean  vte_terminal_search_find_next       (VteTerminal *terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
 
+_VTE_PUBLIC
+void vte_terminal_set_regex_match_limits(VteTerminal* terminal,
+                                         guint32 match_limit,
+                                         guint32 depth_limit) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+void vte_terminal_get_regex_match_limits(VteTerminal* terminal,
+                                         guint32* match_limit,
+                                         guint32* depth_limit) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
 
 /* CJK compatibility setting */
 _VTE_PUBLIC
@@ -606,6 +628,20 @@ gboolean vte_terminal_write_contents_sync (VteTerminal *terminal,
                                            VteWriteFlags flags,
                                            GCancellable *cancellable,
                                            GError **error) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1, 2);
+_VTE_PUBLIC
+void vte_terminal_write_contents_async(VteTerminal* terminal,
+                                       GOutputStream* stream,
+                                       VteWriteFlags flags,
+                                       int io_priority,
+                                       GCancellable* cancellable,
+                                       GFileProgressCallback progress_callback,
+                                       gpointer progress_callback_data,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1, 2);
+_VTE_PUBLIC
+gboolean vte_terminal_write_contents_finish(VteTerminal* terminal,
+                                            GAsyncResult* result,
+                                            GError** error) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1, 2);
 
 /* Images */
 
@@ -617,6 +653,14 @@ void vte_terminal_set_enable_sixel(VteTerminal *terminal,
 _VTE_PUBLIC
 gboolean vte_terminal_get_enable_sixel(VteTerminal *terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
 
+/* Set or get whether local clients may transfer images by file */
+_VTE_PUBLIC
+void vte_terminal_set_enable_image_files(VteTerminal* terminal,
+                                         gboolean enabled) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+gboolean vte_terminal_get_enable_image_files(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
 _VTE_PUBLIC
 void vte_terminal_set_xalign(VteTerminal* terminal,
                              VteAlign align) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
@@ -872,6 +916,12 @@ void vte_terminal_reset_termprop_by_id(VteTerminal* terminal,
 _VTE_PUBLIC
 VteProperties const* vte_terminal_get_termprops(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
 
+_VTE_PUBLIC
+char* vte_terminal_dup_statistics(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_reset_statistics(VteTerminal* terminal) _VTE_CXX_NOEXCEPT _VTE_GNUC_NONNULL(1);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(VteTerminal, g_object_unref)
 
 G_END_DECLS
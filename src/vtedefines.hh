@@ -84,6 +84,11 @@
 #define VTE_MAX_PROCESS_TIME		100
 #define VTE_CELL_BBOX_SLACK		1
 #define VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH 1
+#define VTE_REGEX_MATCH_LIMIT_DEFAULT   65536 /* should be plenty */
+#define VTE_REGEX_DEPTH_LIMIT_DEFAULT   64 /* should be plenty */
+#define VTE_REGEX_OVECTOR_PAIRS         256 /* should be plenty */
+#define VTE_WRITE_CONTENTS_CHUNK_SIZE   (64 * 1024) /* bytes written per step when writing the contents */
+#define VTE_WRITE_CONTENTS_CHUNK_ROWS   256 /* rows of plain text copied per step when writing the contents */
 
 #define VTE_UTF8_BPC                    (4) /* Maximum number of bytes used per UTF-8 character */
 
@@ -138,6 +143,12 @@
 #define VTE_SIXEL_MAX_WIDTH (2048)
 #define VTE_SIXEL_MAX_HEIGHT (2052)
 #define VTE_SIXEL_NUM_COLOR_REGISTERS (1024)
+#define VTE_SIXEL_PROGRESSIVE_INTERVAL (100 /* ms */)
+
+/* Maximum size of an image transferred by file. It is read synchronously, so this
+ * is kept well below an RGBA image of the maximum dimensions; larger images need PNG.
+ */
+#define VTE_IMAGE_FILE_MAX_SIZE (4 * 1024 * 1024)
 
 #define VTE_MIN_CURSOR_BLINK_CYCLE (50 /* ms */)
 #define VTE_MIN_CURSOR_BLINK_TIMEOUT (50 /* ms */)
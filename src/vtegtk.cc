@@ -1004,6 +1004,9 @@ try
                 case PROP_ENABLE_FALLBACK_SCROLLING:
                         g_value_set_boolean (value, vte_terminal_get_enable_fallback_scrolling(terminal));
                         break;
+                case PROP_ENABLE_IMAGE_FILES:
+                        g_value_set_boolean(value, vte_terminal_get_enable_image_files(terminal));
+                        break;
                 case PROP_ENABLE_LEGACY_OSC777:
                         g_value_set_boolean(value, vte_terminal_get_enable_legacy_osc777(terminal));
                         break;
@@ -1167,6 +1170,9 @@ try
                 case PROP_ENABLE_FALLBACK_SCROLLING:
                         vte_terminal_set_enable_fallback_scrolling (terminal, g_value_get_boolean (value));
                         break;
+                case PROP_ENABLE_IMAGE_FILES:
+                        vte_terminal_set_enable_image_files(terminal, g_value_get_boolean(value));
+                        break;
                 case PROP_ENABLE_LEGACY_OSC777:
                         vte_terminal_set_enable_legacy_osc777(terminal, g_value_get_boolean(value));
                         break;
@@ -1627,6 +1633,10 @@ vte_terminal_class_init(VteTerminalClass *klass)
          *
          * Emitted whenever the visible appearance of the terminal has changed.
          * Used primarily by #VteTerminalAccessible.
+         *
+         * Handlers can use vte_terminal_get_changed_rows(),
+         * vte_terminal_get_changed_scroll() and vte_terminal_get_changed_cursor()
+         * to find out what changed.
          */
         signals[SIGNAL_CONTENTS_CHANGED] =
                 g_signal_new(I_("contents-changed"),
@@ -2354,6 +2364,22 @@ vte_terminal_class_init(VteTerminalClass *klass)
 #endif
                                       (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:enable-image-files:
+         *
+         * Whether clients may transfer images by referencing a file or
+         * shared memory object in an OSC 667 sequence, instead of sending
+         * the image data through the PTY. Only has an effect when image
+         * support is enabled, see #VteTerminal:enable-sixel.
+         * See vte_terminal_set_enable_image_files() for the implications.
+         *
+         * Since: 0.86
+         */
+        pspecs[PROP_ENABLE_IMAGE_FILES] =
+                g_param_spec_boolean("enable-image-files", nullptr, nullptr,
+                                     false,
+                                     GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
 
         /**
          * VteTerminal:font-options:
@@ -4283,6 +4309,64 @@ catch (...)
         return false;
 }
 
+/**
+ * vte_terminal_set_regex_match_limits:
+ * @terminal: a #VteTerminal
+ * @match_limit: the PCRE2 match limit, or 0 to use the default
+ * @depth_limit: the PCRE2 depth limit, or 0 to use the default
+ *
+ * Sets the limits that are applied when matching the regexes added with
+ * vte_terminal_match_add_regex(), and when searching with the regex set
+ * with vte_terminal_search_set_regex(). See man:pcre2_set_match_limit(3)
+ * and man:pcre2_set_depth_limit(3) for more information.
+ *
+ * Since: 0.86
+ */
+void
+vte_terminal_set_regex_match_limits(VteTerminal* terminal,
+                                    guint32 match_limit,
+                                    guint32 depth_limit) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        IMPL(terminal)->set_match_limits(match_limit ? match_limit : VTE_REGEX_MATCH_LIMIT_DEFAULT,
+                                         depth_limit ? depth_limit : VTE_REGEX_DEPTH_LIMIT_DEFAULT);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_regex_match_limits:
+ * @terminal: a #VteTerminal
+ * @match_limit: (out) (optional): a location to store the match limit, or %NULL
+ * @depth_limit: (out) (optional): a location to store the depth limit, or %NULL
+ *
+ * Gets the limits set with vte_terminal_set_regex_match_limits().
+ *
+ * Since: 0.86
+ */
+void
+vte_terminal_get_regex_match_limits(VteTerminal* terminal,
+                                    guint32* match_limit,
+                                    guint32* depth_limit) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        auto const impl = IMPL(terminal);
+        if (match_limit)
+                *match_limit = impl->match_limit();
+        if (depth_limit)
+                *depth_limit = impl->match_depth_limit();
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
 /**
  * vte_terminal_select_all:
  * @terminal: a #VteTerminal
@@ -4353,6 +4437,148 @@ catch (...)
         vte::log_exception();
 }
 
+/**
+ * vte_terminal_get_changed_rows:
+ * @terminal: a #VteTerminal
+ * @ranges: (out) (array length=n_elements) (transfer full) (optional) (nullable):
+ *   a location to store the changed row ranges, or %NULL
+ * @n_elements: (out) (optional): a location to store the number of elements in @ranges, or %NULL
+ *
+ * Describes which rows changed in the batch of changes announced by the
+ * most recent emission of the #VteTerminal::contents-changed signal.
+ * This may be called from a #VteTerminal::contents-changed handler to
+ * only re-read the parts of the contents that actually changed.
+ *
+ * @ranges is filled with pairs of start (inclusive) and end (exclusive)
+ * rows, sorted and disjoint; @n_elements is twice the number of ranges.
+ * The rows are absolute, like the ones returned by
+ * vte_terminal_get_cursor_position(). The ranges may cover more rows
+ * than actually changed, but never fewer.
+ *
+ * If the changes cannot be described as row ranges (e.g. because the
+ * terminal was reset or resized, or switched screens), returns %FALSE
+ * and the whole contents need to be considered changed.
+ *
+ * Returns: %TRUE if @ranges describes the changes, %FALSE if everything changed
+ *
+ * Since: 0.86
+ */
+gboolean
+vte_terminal_get_changed_rows(VteTerminal* terminal,
+                              glong** ranges,
+                              gsize* n_elements) noexcept
+try
+{
+        if (ranges)
+                *ranges = nullptr;
+        if (n_elements)
+                *n_elements = 0;
+
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
+
+        auto const& changes = IMPL(terminal)->contents_changes();
+        if (changes.all())
+                return false;
+
+        auto const& rows = changes.ranges();
+        if (ranges && !rows.empty()) {
+                auto v = g_new(glong, 2 * rows.size());
+                auto i = size_t{0};
+                for (auto const& range : rows) {
+                        v[i++] = range.start;
+                        v[i++] = range.end;
+                }
+                *ranges = v;
+        }
+        if (n_elements)
+                *n_elements = 2 * rows.size();
+
+        return true;
+}
+catch (...)
+{
+        vte::log_exception();
+        return false;
+}
+
+/**
+ * vte_terminal_get_changed_scroll:
+ * @terminal: a #VteTerminal
+ *
+ * Returns by how many rows the screen moved down into the buffer
+ * in the batch of changes announced by the most recent emission of the
+ * #VteTerminal::contents-changed signal; i.e. how many rows were
+ * scrolled into the scrollback. The rows that appeared at the bottom
+ * of the screen are included in the ranges returned by
+ * vte_terminal_get_changed_rows().
+ *
+ * Returns: the number of rows scrolled
+ *
+ * Since: 0.86
+ */
+glong
+vte_terminal_get_changed_scroll(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+
+        return IMPL(terminal)->contents_changes().scroll();
+}
+catch (...)
+{
+        vte::log_exception();
+        return 0;
+}
+
+/**
+ * vte_terminal_get_changed_cursor:
+ * @terminal: a #VteTerminal
+ * @old_column: (out) (optional): a location to store the previous cursor column, or %NULL
+ * @old_row: (out) (optional): a location to store the previous cursor row, or %NULL
+ * @column: (out) (optional): a location to store the new cursor column, or %NULL
+ * @row: (out) (optional): a location to store the new cursor row, or %NULL
+ *
+ * Returns whether the cursor moved in the batch of changes announced by
+ * the most recent emission of the #VteTerminal::contents-changed signal,
+ * and if so, from where to where. The coordinates are like the ones
+ * returned by vte_terminal_get_cursor_position(). If the cursor did not
+ * move, the locations are not modified.
+ *
+ * Returns: %TRUE if the cursor moved
+ *
+ * Since: 0.86
+ */
+gboolean
+vte_terminal_get_changed_cursor(VteTerminal* terminal,
+                                glong* old_column,
+                                glong* old_row,
+                                glong* column,
+                                glong* row) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
+
+        auto const& changes = IMPL(terminal)->contents_changes();
+        if (!changes.cursor_moved())
+                return false;
+
+        if (old_column)
+                *old_column = changes.old_cursor_column();
+        if (old_row)
+                *old_row = changes.old_cursor_row();
+        if (column)
+                *column = changes.cursor_column();
+        if (row)
+                *row = changes.cursor_row();
+
+        return true;
+}
+catch (...)
+{
+        vte::log_exception();
+        return false;
+}
+
 /**
  * vte_terminal_pty_new_sync:
  * @terminal: a #VteTerminal
@@ -7319,6 +7545,7 @@ try
 {
         g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
         g_return_val_if_fail(G_IS_OUTPUT_STREAM(stream), false);
+        g_return_val_if_fail((flags & (VTE_WRITE_HTML | VTE_WRITE_CELLS)) != (VTE_WRITE_HTML | VTE_WRITE_CELLS), false);
 
         return IMPL(terminal)->write_contents_sync(stream, flags, cancellable, error);
 }
@@ -7327,6 +7554,183 @@ catch (...)
         return vte::glib::set_error_from_exception(error);
 }
 
+typedef struct {
+        vte::glib::RefPtr<GOutputStream> stream;
+        vte::terminal::Terminal::WriteContentsState state;
+        vte::Freeable<GString> buffer;
+        GFileProgressCallback progress_callback;
+        gpointer progress_callback_data;
+        goffset total_rows;
+} WriteContentsAsyncData;
+
+static void
+write_contents_async_data_free(gpointer data) noexcept
+{
+        delete reinterpret_cast<WriteContentsAsyncData*>(data);
+}
+
+static void write_contents_async_write_cb(GObject* source,
+                                          GAsyncResult* result,
+                                          gpointer user_data) noexcept;
+
+/* Writes the next chunk of the contents, or completes @task when all are written */
+static void
+write_contents_async_next(vte::glib::RefPtr<GTask> task) noexcept
+try
+{
+        auto const data = reinterpret_cast<WriteContentsAsyncData*>(g_task_get_task_data(task.get()));
+
+        if (g_task_return_error_if_cancelled(task.get()))
+                return;
+
+        if (data->state.done)
+                return g_task_return_boolean(task.get(), true);
+
+        /* Throws if the terminal has been disposed of meanwhile */
+        auto const impl = IMPL(VTE_TERMINAL(g_task_get_source_object(task.get())));
+
+        auto error = vte::glib::Error{};
+        g_string_truncate(data->buffer.get(), 0);
+        if (!impl->write_contents_chunk(data->state,
+                                        data->buffer.get(),
+                                        VTE_WRITE_CONTENTS_CHUNK_SIZE,
+                                        error))
+                return g_task_return_error(task.get(), error.release());
+
+        if (data->progress_callback) {
+                auto const remaining = data->state.done ? 0 : goffset(data->state.end - data->state.position);
+                data->progress_callback(std::max(data->total_rows - remaining, goffset{0}),
+                                        data->total_rows,
+                                        data->progress_callback_data);
+        }
+
+        g_output_stream_write_all_async(data->stream.get(),
+                                        data->buffer->str,
+                                        data->buffer->len,
+                                        g_task_get_priority(task.get()),
+                                        g_task_get_cancellable(task.get()),
+                                        write_contents_async_write_cb,
+                                        task.release()); // transfer
+}
+catch (...)
+{
+        auto error = vte::glib::Error{};
+        vte::glib::set_error_from_exception(error);
+        g_task_return_error(task.get(), error.release());
+}
+
+static void
+write_contents_async_write_cb(GObject* source,
+                              GAsyncResult* result,
+                              gpointer user_data) noexcept
+{
+        auto task = vte::glib::take_ref(reinterpret_cast<GTask*>(user_data)); // ref added on write_contents_async_next
+
+        auto error = vte::glib::Error{};
+        auto bytes_written = gsize{0};
+        if (!g_output_stream_write_all_finish(G_OUTPUT_STREAM(source), result, &bytes_written, error))
+                return g_task_return_error(task.get(), error.release());
+
+        write_contents_async_next(std::move(task));
+}
+
+/**
+ * vte_terminal_write_contents_async:
+ * @terminal: a #VteTerminal
+ * @stream: a #GOutputStream to write to
+ * @flags: a set of #VteWriteFlags
+ * @io_priority: the I/O priority of the request
+ * @cancellable: (allow-none): a #GCancellable object, or %NULL
+ * @progress_callback: (allow-none) (scope forever) (closure progress_callback_data): a
+ *   #GFileProgressCallback, or %NULL
+ * @progress_callback_data: user data for @progress_callback
+ * @callback: (allow-none) (scope async): a #GAsyncReadyCallback, or %NULL
+ * @user_data: user data for @callback
+ *
+ * Like vte_terminal_write_contents_sync(), but writes the contents
+ * asynchronously in chunks, so that neither the widget nor input
+ * processing is blocked, and only one chunk needs to be held in memory
+ * at a time.
+ *
+ * If @progress_callback is not %NULL, it is called after each chunk with
+ * the number of rows written so far, and the total number of rows.
+ *
+ * The rows on screen are written as they are at the time their chunk is
+ * written, and rows that drop off the scrollback before they are written
+ * are skipped. If the contents are rewrapped (for example, because the
+ * terminal was resized) or reset, the operation fails with
+ * %G_IO_ERROR_FAILED.
+ *
+ * When the operation is finished, @callback will be called. You can then
+ * call vte_terminal_write_contents_finish() to get the result of the
+ * operation.
+ *
+ * Since: 0.86
+ */
+void
+vte_terminal_write_contents_async(VteTerminal* terminal,
+                                  GOutputStream* stream,
+                                  VteWriteFlags flags,
+                                  int io_priority,
+                                  GCancellable* cancellable,
+                                  GFileProgressCallback progress_callback,
+                                  gpointer progress_callback_data,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(G_IS_OUTPUT_STREAM(stream));
+        g_return_if_fail(cancellable == nullptr || G_IS_CANCELLABLE(cancellable));
+        g_return_if_fail((flags & (VTE_WRITE_HTML | VTE_WRITE_CELLS)) != (VTE_WRITE_HTML | VTE_WRITE_CELLS));
+
+        auto task = vte::glib::take_ref(g_task_new(terminal, cancellable, callback, user_data));
+        g_task_set_priority(task.get(), io_priority);
+        g_task_set_source_tag(task.get(), (void*)vte_terminal_write_contents_async);
+#if GLIB_CHECK_VERSION(2, 60, 0)
+        g_task_set_name(task.get(), "vte-terminal-write-contents-async");
+#endif
+
+        auto data = new WriteContentsAsyncData{};
+        data->stream = vte::glib::make_ref(stream);
+        data->state = IMPL(terminal)->write_contents_begin(flags);
+        data->buffer = vte::take_freeable(g_string_sized_new(VTE_WRITE_CONTENTS_CHUNK_SIZE));
+        data->progress_callback = progress_callback;
+        data->progress_callback_data = progress_callback_data;
+        data->total_rows = goffset(data->state.end - data->state.position);
+        g_task_set_task_data(task.get(), data, write_contents_async_data_free);
+
+        write_contents_async_next(std::move(task));
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_write_contents_finish:
+ * @terminal: a #VteTerminal
+ * @result: a #GAsyncResult
+ * @error: (allow-none): a #GError location to store the error occuring, or %NULL
+ *
+ * Finishes an operation started with vte_terminal_write_contents_async().
+ *
+ * Returns: %TRUE on success, %FALSE if there was an error
+ *
+ * Since: 0.86
+ */
+gboolean
+vte_terminal_write_contents_finish(VteTerminal* terminal,
+                                   GAsyncResult* result,
+                                   GError** error) noexcept
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
+        g_return_val_if_fail(g_task_is_valid(result, terminal), false);
+        g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) == vte_terminal_write_contents_async, false);
+
+        return g_task_propagate_boolean(G_TASK(result), error);
+}
+
 /**
  * vte_terminal_set_clear_background:
  * @terminal: a #VteTerminal
@@ -7466,6 +7870,67 @@ catch (...)
         return false;
 }
 
+/**
+ * vte_terminal_set_enable_image_files:
+ * @terminal: a #VteTerminal
+ * @enabled: whether to enable image transfer by file
+ *
+ * Sets whether clients may transfer images by referencing a file or
+ * shared memory object, instead of sending the image data through the PTY.
+ *
+ * Note that this lets anything written to the terminal make it read any
+ * regular file that the user owns, and delete those in the temporary
+ * directory and the shared memory objects whose names contain
+ * "tty-graphics-protocol". The terminal cannot tell whether the data
+ * comes from a local program or, for example, from a remote host over
+ * ssh, so this applies to all of them; only enable it when that is
+ * acceptable.
+ *
+ * Since: 0.86
+ */
+void
+vte_terminal_set_enable_image_files(VteTerminal* terminal,
+                                    gboolean enabled) noexcept
+try
+{
+#if WITH_SIXEL
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        if (WIDGET(terminal)->set_image_files_enabled(enabled != false))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_ENABLE_IMAGE_FILES]);
+#endif
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+/**
+ * vte_terminal_get_enable_image_files:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: %TRUE if image transfer by file is enabled, %FALSE otherwise
+ *
+ * Since: 0.86
+ */
+gboolean
+vte_terminal_get_enable_image_files(VteTerminal* terminal) noexcept
+try
+{
+#if WITH_SIXEL
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), false);
+
+        return WIDGET(terminal)->image_files_enabled();
+#else
+        return false;
+#endif
+}
+catch (...)
+{
+        vte::log_exception();
+        return false;
+}
+
 template<>
 constexpr bool check_enum_value<VteAlign>(VteAlign value) noexcept
 {
@@ -8956,6 +9421,59 @@ catch (...)
         return nullptr;
 }
 
+/**
+ * vte_terminal_dup_statistics:
+ * @terminal: a #VteTerminal
+ *
+ * Returns a human readable description of the counters and timings
+ * that @terminal keeps about its processing and drawing, e.g. the
+ * number of bytes and control sequences parsed, frames drawn and
+ * skipped, bytes written to and read from the scrollback streams,
+ * and the distribution of the time spent in processing and drawing.
+ *
+ * The format of the returned string is not stable, and is meant
+ * for diagnostics only.
+ *
+ * Returns: (transfer full): a newly allocated string
+ *
+ * Since: 0.86
+ */
+char*
+vte_terminal_dup_statistics(VteTerminal* terminal) noexcept
+try
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), nullptr);
+
+        return g_strdup(IMPL(terminal)->stats().to_string().c_str());
+}
+catch (...)
+{
+        vte::log_exception();
+        return nullptr;
+}
+
+/**
+ * vte_terminal_reset_statistics:
+ * @terminal: a #VteTerminal
+ *
+ * Resets all counters and timings of @terminal to zero.
+ * See vte_terminal_dup_statistics().
+ *
+ * Since: 0.86
+ */
+void
+vte_terminal_reset_statistics(VteTerminal* terminal) noexcept
+try
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        IMPL(terminal)->reset_stats();
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
 /*
  * _vte_terminal_get_termprops:
  * @terminal: a #VteTerminal
@@ -80,6 +80,7 @@ enum {
         PROP_ENABLE_A11Y,
         PROP_ENABLE_BIDI,
         PROP_ENABLE_FALLBACK_SCROLLING,
+        PROP_ENABLE_IMAGE_FILES,
         PROP_ENABLE_LEGACY_OSC777,
         PROP_ENABLE_SHAPING,
         PROP_ENABLE_SIXEL,
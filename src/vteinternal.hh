@@ -53,7 +53,9 @@ static_assert(CHAR_BIT == 8, "Weird");
 #include "parser-glue.hh"
 #include "modes.hh"
 #include "tabstops.hh"
+#include "damage.hh"
 #include "properties.hh"
+#include "stats.hh"
 #include "refptr.hh"
 #include "fwd.hh"
 #include "color-palette.hh"
@@ -430,7 +432,7 @@ public:
 #if VTE_GTK == 3
         GArray *m_update_rects;
 #endif
-        bool m_invalidated_all{false};       /* pending refresh of entire terminal */
+        bool m_invalidated_all{false};       /* pending refresh of entire terminal; on gtk4, pending snapshot */
         bool m_is_processing{false};
         // FIXMEchpe should these two be g[s]size ?
         size_t m_input_bytes;
@@ -461,6 +463,9 @@ public:
 
 #if WITH_SIXEL
         std::unique_ptr<vte::sixel::Context> m_sixel_context{};
+
+        /* Progressive display of the SIXEL image being received */
+        vte::sixel::Progress m_sixel_progress{VTE_SIXEL_PROGRESSIVE_INTERVAL * 1000};
 #endif
 
 	/* Screen data.  We support the normal screen, and an alternate
@@ -562,6 +567,23 @@ public:
                                             "text-blink-timer"};
         bool m_text_blink_state{false};  /* whether blinking text should be visible at this very moment */
         bool m_text_to_blink{false};     /* drawing signals here if it encounters any cell with blink attribute */
+
+#if VTE_GTK == 4
+        /* Cached render nodes of the displayed rows, see row_nodes() */
+        struct RowNodes {
+                vte::base::Ring const* ring{nullptr};
+                vte::grid::row_t row{-1};
+                uint32_t serial{0};
+                uint64_t generation{0};
+                vte::Freeable<GskRenderNode> background{};
+                vte::Freeable<GskRenderNode> text{};
+                bool dirty{false};        /* whether the row needs to be rebuilt */
+                bool blinks{false};       /* whether the row contains blinking text */
+                bool blink_state{false};  /* m_text_blink_state when the nodes were built */
+        };
+        std::vector<RowNodes> m_row_nodes{};
+        uint64_t m_row_nodes_generation{1}; /* bumped to drop all cached nodes */
+#endif
         TextBlinkMode m_text_blink_mode{TextBlinkMode::eALWAYS};
         int m_text_blink_cycle_ms;  /* gtk-cursor-blink-time / 2 */
 
@@ -604,6 +626,20 @@ public:
 
         constexpr bool sixel_enabled() const noexcept { return m_sixel_enabled; }
 
+        /* Whether clients may transfer images by file, see vte_image_file() */
+        bool m_image_files_enabled{false};
+
+        bool set_image_files_enabled(bool enabled) noexcept
+        {
+                if (enabled == m_image_files_enabled)
+                        return false;
+
+                m_image_files_enabled = enabled;
+                return true;
+        }
+
+        constexpr bool image_files_enabled() const noexcept { return m_image_files_enabled; }
+
 	/* State variables for handling match checks. */
         int m_match_regex_next_tag{0};
         auto regex_match_next_tag() noexcept { return m_match_regex_next_tag++; }
@@ -687,6 +723,12 @@ public:
          */
         vte::grid::span m_match_span;
 
+        /* PCRE2 match state shared by match checks and search; see match_context() */
+        vte::Freeable<pcre2_match_context_8> m_match_context{};
+        vte::Freeable<pcre2_match_data_8> m_match_data{};
+        uint32_t m_match_limit{VTE_REGEX_MATCH_LIMIT_DEFAULT};
+        uint32_t m_match_depth_limit{VTE_REGEX_DEPTH_LIMIT_DEFAULT};
+
 	/* Search data. */
         vte::base::RefPtr<vte::base::Regex> m_search_regex{};
         uint32_t m_search_regex_match_flags{0};
@@ -773,6 +815,17 @@ public:
         gboolean m_cursor_moved_pending;
         gboolean m_contents_changed_pending;
 
+        /* Changes to the contents accumulated since the last contents-changed
+         * emission, and the ones that were handed out with it.
+         */
+        vte::terminal::Damage m_contents_damage{};
+        vte::terminal::Damage m_contents_changes{};
+
+        /* Counters and timings of the processing and drawing pipeline */
+        vte::base::Stats m_stats{};
+        /* Whether a frame was queued by an update and not drawn yet */
+        bool m_frame_pending{false};
+
         std::vector<std::string> m_window_title_stack{};
 
         enum class PendingChanges {
@@ -1017,8 +1070,13 @@ public:
                                        int len);
 
         #if WITH_SIXEL
+        void insert_image(vte::Freeable<cairo_surface_t> image_surface,
+                          std::optional<vte::image::ContentKey> const& key) /* throws */;
         void insert_image(ProcessingContext& context,
-                          vte::Freeable<cairo_surface_t> image_surface) /* throws */;
+                          vte::Freeable<cairo_surface_t> image_surface,
+                          std::optional<vte::image::ContentKey> const& key = std::nullopt) /* throws */;
+        void update_progressive_image() /* throws */;
+        void drop_progressive_image() noexcept;
         #endif
 
         void invalidate_row(vte::grid::row_t row);
@@ -1031,6 +1089,12 @@ public:
         void invalidate_symmetrical_difference(vte::grid::span const& a, vte::grid::span const& b, bool block);
         void invalidate_match_span();
         void invalidate_all();
+        void queue_redraw();
+        void invalidate_scrolled();
+#if VTE_GTK == 4
+        void mark_rows_dirty(vte::grid::row_t row_start,
+                             vte::grid::row_t row_end /* inclusive */) noexcept;
+#endif
 
         guint8 get_bidi_flags() const noexcept;
         void apply_bidi_attributes(vte::grid::row_t start, guint8 bidi_flags, guint8 bidi_flags_mask);
@@ -1038,6 +1102,7 @@ public:
 
         void reset_update_rects();
         bool invalidate_dirty_rects_and_process_updates();
+        void count_frame_queued() noexcept;
         void time_process_incoming();
         void process_incoming();
         void process_incoming_utf8(ProcessingContext& context,
@@ -1188,6 +1253,15 @@ public:
                         bool hilite,
                         int column_width,
                         int row_height);
+        void draw_decorations(vte::view::DrawingContext::TextRequest* items,
+                              gssize n,
+                              vte::color::rgb const& fg,
+                              vte::color::rgb const& dc,
+                              uint32_t attr,
+                              bool hyperlink,
+                              bool hilite,
+                              int column_width,
+                              int row_height);
         void fudge_pango_colors(GSList *attributes,
                                 VteCell *cells,
                                 gsize n);
@@ -1203,6 +1277,27 @@ public:
                                         bool draw_default_bg,
                                         int column_width,
                                         int height);
+        void draw_row_background(VteRowData const* row_data,
+                                 vte::base::BidiRow const* bidirow,
+                                 vte::grid::row_t row,
+                                 size_t row_index,
+                                 int y,
+                                 int column_width,
+                                 int row_height,
+                                 int rect_width);
+        void draw_row_text(VteRowData const* row_data,
+                           vte::base::BidiRow const* bidirow,
+                           vte::grid::row_t row,
+                           int y,
+                           vte::view::DrawingContext::TextRequest* items,
+                           int column_width,
+                           int row_height);
+#if VTE_GTK == 4
+        RowNodes const& row_nodes(vte::grid::row_t row,
+                                  vte::view::DrawingContext::TextRequest* items,
+                                  int column_width,
+                                  int row_height);
+#endif
         void draw_rows(VteScreen *screen,
                        cairo_region_t const* region,
                        vte::grid::row_t start_row,
@@ -1394,6 +1489,10 @@ public:
 
         void queue_cursor_moved();
         void queue_contents_changed();
+        auto const& contents_changes() const noexcept { return m_contents_changes; }
+
+        auto const& stats() const noexcept { return m_stats; }
+        void reset_stats() noexcept { m_stats.reset(); }
         void queue_child_exited();
         void queue_eof();
 
@@ -1538,7 +1637,12 @@ public:
                                     gsize *sattr_ptr,
                                     gsize *eattr_ptr);
 
-        vte::Freeable<pcre2_match_context_8> create_match_context();
+        pcre2_match_context_8* match_context();
+        pcre2_match_data_8* match_data();
+        bool set_match_limits(uint32_t match_limit,
+                              uint32_t depth_limit);
+        auto match_limit() const noexcept { return m_match_limit; }
+        auto match_depth_limit() const noexcept { return m_match_depth_limit; }
         bool match_check_pcre(pcre2_match_data_8 *match_data,
                               pcre2_match_context_8 *match_context,
                               vte::base::Regex const* regex,
@@ -1699,6 +1803,29 @@ public:
                                   GCancellable *cancellable,
                                   GError **error);
 
+        /* State of an incremental write of the contents, see write_contents_chunk() */
+        struct WriteContentsState {
+                vte::base::Ring* ring{nullptr};
+                uint64_t ring_generation{0};
+                vte::base::Ring::row_t position{0};
+                vte::base::Ring::row_t end{0};
+                VteWriteFlags flags{VTE_WRITE_DEFAULT};
+                bool started{false};
+                bool done{false};
+        };
+
+        WriteContentsState write_contents_begin(VteWriteFlags flags);
+        bool write_contents_chunk(WriteContentsState& state,
+                                  GString* buffer,
+                                  size_t max_bytes,
+                                  GError** error);
+        bool append_row_html(vte::base::Ring* ring,
+                             vte::base::Ring::row_t position,
+                             GString* buffer) const;
+        bool append_row_cells(vte::base::Ring* ring,
+                              vte::base::Ring::row_t position,
+                              GString* buffer) const;
+
         inline void maybe_retreat_cursor();
         inline void home_cursor();
         inline void clear_screen();
@@ -1767,6 +1894,26 @@ public:
         inline void erase_in_line(vte::parser::Sequence const& seq);
 
         unsigned int checksum_area(grid_rect rect);
+        #if VTE_DEBUG
+        /* Per-row results of checksum_area(), valid while the row's serial is unchanged */
+        struct ChecksumCacheEntry {
+                vte::base::Ring const* ring{nullptr};
+                vte::grid::row_t row{-1};
+                uint32_t serial{0};
+                vte::grid::column_t start_col{0};
+                vte::grid::column_t end_col{0};
+                unsigned int checksum{0};
+                bool maybe_rtl{false};
+        };
+        std::vector<ChecksumCacheEntry> m_checksum_cache{};
+
+        ChecksumCacheEntry& checksum_cache_lookup(vte::grid::row_t row,
+                                                  VteRowData const* row_data);
+        unsigned int checksum_row(VteRowData const* row_data,
+                                  vte::grid::column_t start_col,
+                                  vte::grid::column_t end_col,
+                                  vte::base::BidiRow const* bidirow) const noexcept;
+        #endif
 
         void select_text(vte::grid::column_t start_col,
                          vte::grid::row_t start_row,
@@ -1828,6 +1975,11 @@ public:
         void vte_termprop(vte::parser::Sequence const& seq,
                           vte::parser::StringTokeniser::const_iterator& token,
                           vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
+#if WITH_SIXEL
+        void vte_image_file(vte::parser::Sequence const& seq,
+                            vte::parser::StringTokeniser::const_iterator& token,
+                            vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept;
+#endif
 
         void urxvt_extension(vte::parser::Sequence const& seq,
                              vte::parser::StringTokeniser::const_iterator& token,
@@ -0,0 +1,97 @@
+// Copyright © 2026 The VTE contributors
+//
+// This library is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "vterowdata.hh"
+
+static void
+fill_row(VteRowData* row,
+         gunichar const* text,
+         gulong len)
+{
+        auto cell = VteCell{};
+        _vte_row_data_init(row);
+        _vte_row_data_fill(row, &cell, 10);
+        for (auto col = gulong{0}; col < len; ++col) {
+                _vte_row_data_get_writable(row, col)->c = text[col];
+                _vte_row_data_note_char(row, text[col]);
+        }
+}
+
+static void
+test_note_char(void)
+{
+        gunichar const latin[] = {'a', 'b', 'c'};
+        gunichar const hebrew[] = {'a', 0x05d0, 'c'};
+
+        VteRowData row;
+        fill_row(&row, latin, G_N_ELEMENTS(latin));
+        g_assert_false(row.attr.maybe_rtl);
+        _vte_row_data_fini(&row);
+
+        fill_row(&row, hebrew, G_N_ELEMENTS(hebrew));
+        g_assert_true(row.attr.maybe_rtl);
+
+        _vte_row_data_clear(&row);
+        g_assert_false(row.attr.maybe_rtl);
+        _vte_row_data_fini(&row);
+}
+
+/* Scrolls up the rows by one inside the left and right margins, the way
+ * Terminal::scroll_text_up() does with DECSLRM, and checks that the RTL
+ * text takes its row's maybe_rtl flag with it.
+ */
+static void
+test_copy_cells_margins(void)
+{
+        gunichar const latin[] = {'a', 'b', 'c', 'd', 'e', 'f'};
+        gunichar const hebrew[] = {'a', 'b', 0x05d0, 0x05d1, 'e', 'f'};
+
+        VteRowData rows[3];
+        fill_row(&rows[0], latin, G_N_ELEMENTS(latin));
+        fill_row(&rows[1], hebrew, G_N_ELEMENTS(hebrew));
+        fill_row(&rows[2], latin, G_N_ELEMENTS(latin));
+
+        auto const left = gulong{2}, right = gulong{4};
+        for (auto row = 0; row < 2; ++row)
+                _vte_row_data_copy_cells(&rows[row + 1], &rows[row], left, right - left + 1);
+
+        g_assert_cmpuint(_vte_row_data_get(&rows[0], 2)->c, ==, 0x05d0);
+        g_assert_cmpuint(_vte_row_data_get(&rows[0], 1)->c, ==, 'b');
+        g_assert_true(rows[0].attr.maybe_rtl);
+        g_assert_cmpuint(_vte_row_data_get(&rows[1], 2)->c, ==, 'c');
+
+        /* The flag errs on the safe side, and is not cleared by the copy */
+        g_assert_true(rows[1].attr.maybe_rtl);
+        g_assert_false(rows[2].attr.maybe_rtl);
+
+        for (auto& row : rows)
+                _vte_row_data_fini(&row);
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+        g_test_init(&argc, &argv, nullptr);
+
+        g_test_add_func("/vte/rowdata/note-char", test_note_char);
+        g_test_add_func("/vte/rowdata/copy-cells/margins", test_copy_cells_margins);
+
+        return g_test_run();
+}
@@ -199,6 +199,16 @@ void _vte_row_data_copy (const VteRowData *src, VteRowData *dst)
         memcpy(dst->cells, src->cells, src->len * sizeof (src->cells[0]));
 }
 
+/* Copies the cells from @start to @start + @len - 1 of @src to the same
+ * columns of @dst; both rows must already be that long. Since the cells
+ * may contain RTL characters, @dst's maybe_rtl flag takes on @src's.
+ */
+void _vte_row_data_copy_cells (const VteRowData *src, VteRowData *dst, gulong start, gulong len)
+{
+        memcpy(dst->cells + start, src->cells + start, len * sizeof (src->cells[0]));
+        dst->attr.maybe_rtl |= src->attr.maybe_rtl;
+}
+
 void _vte_row_data_fill_cells(VteRowData* row,
                               gulong start_idx,
                               VteCell const* fill_cell,
@@ -213,6 +223,8 @@ void _vte_row_data_fill_cells(VteRowData* row,
         _vte_row_data_fill(row, fill_cell, start_idx);
         // ... then copy the cells over ...
         std::copy_n(cells, len, &row->cells[start_idx]);
+        for (auto i = gulong{0}; i < len; ++i)
+                _vte_row_data_note_char(row, _vte_unistr_get_base(cells[i].c));
         // ... and adjust the row length
         if (row->len < needlen)
                 row->len = needlen;
@@ -37,6 +37,7 @@ G_BEGIN_DECLS
 typedef struct _VteRowAttr {
         guint8 soft_wrapped  : 1;
         guint8 bidi_flags    : 4;
+        guint8 maybe_rtl     : 1; /* see _vte_row_data_note_char() */
 } VteRowAttr;
 static_assert(sizeof (VteRowAttr) == 1, "VteRowAttr has wrong size");
 
@@ -48,11 +49,45 @@ typedef struct _VteRowData {
 	VteCell *cells;
 	guint16 len;
 	VteRowAttr attr;
+        guint32 serial; /* modification stamp, see Ring::row_serial() */
 } VteRowData;
 
 
 #define _vte_row_data_length(__row)			((__row)->len + 0)
 
+/* Whether @c may need BiDi treatment: a strong RTL character, an Arabic
+ * character that may need shaping, or an explicit directional formatting
+ * character. This errs on the safe side, and is meant to be cheap for the
+ * common case of characters below U+0590.
+ */
+static inline bool
+_vte_char_maybe_rtl (gunichar c)
+{
+        if (G_LIKELY (c < 0x0590))
+                return false;
+
+        return c <= 0x08ff ||                     /* Hebrew, Arabic, Syriac, Thaana, NKo, ... */
+               (c >= 0x200e && c <= 0x200f) ||    /* LRM, RLM */
+               (c >= 0x202a && c <= 0x202e) ||    /* LRE, RLE, PDF, LRO, RLO */
+               (c >= 0x2066 && c <= 0x2069) ||    /* LRI, RLI, FSI, PDI */
+               (c >= 0xfb1d && c <= 0xfdff) ||    /* Hebrew and Arabic presentation forms */
+               (c >= 0xfe70 && c <= 0xfeff) ||    /* Arabic presentation forms-B */
+               (c >= 0x10800 && c <= 0x10fff) ||  /* RTL scripts of the SMP */
+               (c >= 0x1e800 && c <= 0x1efff);    /* Mende Kikakui, Adlam, Arabic mathematical symbols */
+}
+
+/* Records that @c is (being) written to @row. The row's maybe_rtl flag is
+ * only cleared when the row is cleared, so it may be stale in the safe
+ * direction, but a row without it certainly needs no BiDi treatment
+ * unless its paragraph is RTL.
+ */
+static inline void
+_vte_row_data_note_char (VteRowData *row, gunichar c)
+{
+        if (G_UNLIKELY (_vte_char_maybe_rtl (c)))
+                row->attr.maybe_rtl = 1;
+}
+
 static inline const VteCell *
 _vte_row_data_get (const VteRowData *row, gulong col)
 {
@@ -81,6 +116,7 @@ void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len);
 void _vte_row_data_expand (VteRowData *row, gulong len);
 void _vte_row_data_shrink (VteRowData *row, gulong max_len);
 void _vte_row_data_copy (const VteRowData *src, VteRowData *dst);
+void _vte_row_data_copy_cells (const VteRowData *src, VteRowData *dst, gulong start, gulong len);
 void _vte_row_data_fill_cells(VteRowData* row,
                               gulong start_idx,
                               VteCell const* fill_cell, // for filling
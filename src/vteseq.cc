@@ -40,6 +40,10 @@
 #include "xtermcap.hh"
 #include "systemdcontext.hh"
 
+#if WITH_SIXEL
+#include "image-file.hh"
+#endif
+
 #define BEL_C0 "\007"
 #define ST_C0 _VTE_CAP_ST
 
@@ -2030,6 +2034,52 @@ catch (...)
         // nothing to do here
 }
 
+#if WITH_SIXEL
+
+// vte_image_file:
+//
+// Parse an OSC 667 sequence, which transfers an image by reference to
+// a file or shared memory object instead of sending its pixels through
+// the PTY; see vte::image::FileRequest for the format. Since this makes
+// the terminal read (and for temporary files and shared memory objects,
+// delete) files, it is only available when the embedder enabled it.
+void
+Terminal::vte_image_file(vte::parser::Sequence const& seq,
+                         vte::parser::StringTokeniser::const_iterator& token,
+                         vte::parser::StringTokeniser::const_iterator const& endtoken) noexcept
+try
+{
+        // This is a new and vte-only feature, so reject BEL-terminated OSC.
+        if (seq.is_st_bel())
+                return;
+
+        if (!m_images_enabled || !m_image_files_enabled)
+                return;
+
+        if (token == endtoken)
+                return;
+
+        auto const control = *token;
+        if (++token == endtoken)
+                return;
+
+        auto const request = vte::image::parse_file_request(control, *token);
+        if (!request)
+                return;
+
+        auto surface = vte::image::load_file_image(*request);
+        if (!surface)
+                return;
+
+        insert_image(std::move(surface), std::nullopt);
+}
+catch (...)
+{
+        vte::log_exception();
+}
+
+#endif /* WITH_SIXEL */
+
 void
 Terminal::urxvt_extension(vte::parser::Sequence const& seq,
                           vte::parser::StringTokeniser::const_iterator& token,
@@ -5635,6 +5685,8 @@ try
 
         m_sixel_context->set_mode(mode);
 
+        m_sixel_progress.begin(g_get_monotonic_time());
+
         // We need to reset the main parser, so that when it is in the ground state
         // when processing returns to the primary data syntax from DECSIXEL.
         m_parser.reset();
@@ -8011,6 +8063,12 @@ try
                 vte_termprop(seq, it, cend);
                 break;
 
+#if WITH_SIXEL
+        case VTE_OSC_VTE_IMAGE_FILE:
+                vte_image_file(seq, it, cend);
+                break;
+#endif
+
         case VTE_OSC_URXVT_EXTENSION:
                 urxvt_extension(seq, it, cend);
                 break;
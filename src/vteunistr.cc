@@ -220,3 +220,15 @@ int
 	}
 	return len;
 }
+
+guint32
+(_vte_unistr_sum) (vteunistr s)
+{
+	guint32 sum = 0;
+	g_return_val_if_fail (s < unistr_next, sum);
+	while (s >= VTE_UNISTR_START) {
+		sum += DECOMP_FROM_UNISTR (s).suffix;
+		s = DECOMP_FROM_UNISTR (s).prefix;
+	}
+	return sum + (guint32) s;
+}
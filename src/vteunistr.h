@@ -171,6 +171,19 @@ _vte_unistr_strlen (vteunistr s);
 #define _vte_unistr_strlen(s) \
         ((s) < VTE_UNISTR_START ? 1 : (_vte_unistr_strlen)(s))
 
+/**
+ * _vte_unistr_sum:
+ * @s: a #vteunistr
+ *
+ * Adds up the code points of the characters in @s, e.g. for checksumming.
+ *
+ * Returns: the sum of the characters of @s.
+ **/
+guint32
+_vte_unistr_sum (vteunistr s);
+#define _vte_unistr_sum(s) \
+        ((s) < VTE_UNISTR_START ? (guint32)(s) : (_vte_unistr_sum)(s))
+
 G_END_DECLS
 
 #endif
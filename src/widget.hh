@@ -617,6 +617,8 @@ public:
 
         bool set_sixel_enabled(bool enabled) noexcept { return m_terminal->set_sixel_enabled(enabled); }
         bool sixel_enabled() const noexcept { return m_terminal->sixel_enabled(); }
+        bool set_image_files_enabled(bool enabled) noexcept { return m_terminal->set_image_files_enabled(enabled); }
+        bool image_files_enabled() const noexcept { return m_terminal->image_files_enabled(); }
 
         constexpr auto xalign() const noexcept { return m_xalign; }
         constexpr auto yalign() const noexcept { return m_yalign; }